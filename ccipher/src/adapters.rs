@@ -0,0 +1,253 @@
+//! [`io::Read`] and [`io::Write`] adapters that apply a cipher to the data flowing through.
+//!
+//! Both adapters transform bytes as [`ShiftCipher::apply_cipher_bytes`] does, so they work
+//! on any byte stream and map valid UTF-8 to valid UTF-8. They take a [`crate::CaesarCipher`]
+//! or a [`ShiftCipher`], and default to the [`Ascii128`] alphabet.
+use crate::{Alphabet, Ascii128, ShiftCipher};
+use std::io::{self, Read, Write};
+
+/// Size of the scratch buffer a [`CipherWriter`] transforms borrowed data into.
+const SCRATCH_LEN: usize = 8 * 1024;
+
+/// A reader that applies a cipher to everything read from the inner reader.
+///
+/// Data is transformed in place in the caller's buffer right after the inner reader filled
+/// it, so reading allocates nothing.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{CaesarCipher, CipherReader};
+/// use std::io::Read;
+///
+/// let mut reader = CipherReader::new(&b"Hello!"[..], CaesarCipher::new(3));
+/// let mut encrypted = String::new();
+/// reader.read_to_string(&mut encrypted)?;
+///
+/// assert_eq!(encrypted, "Khoor$");
+/// # Ok::<(), std::io::Error>(())
+/// ```
+#[derive(Debug)]
+pub struct CipherReader<R, A: Alphabet = Ascii128> {
+    inner: R,
+    cipher: ShiftCipher<A>,
+}
+
+impl<R: Read, A: Alphabet> CipherReader<R, A> {
+    /// Creates a reader that applies `cipher` to the data read from `inner`.
+    pub fn new(inner: R, cipher: impl Into<ShiftCipher<A>>) -> Self {
+        CipherReader {
+            inner,
+            cipher: cipher.into(),
+        }
+    }
+
+    /// Returns a reference to the inner reader.
+    pub fn get_ref(&self) -> &R {
+        &self.inner
+    }
+
+    /// Returns a mutable reference to the inner reader. Data read from it directly bypasses
+    /// the cipher.
+    pub fn get_mut(&mut self) -> &mut R {
+        &mut self.inner
+    }
+
+    /// Returns the inner reader.
+    pub fn into_inner(self) -> R {
+        self.inner
+    }
+}
+
+impl<R: Read, A: Alphabet> Read for CipherReader<R, A> {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let len = self.inner.read(buf)?;
+        self.cipher.apply_cipher_in_place(&mut buf[..len]);
+        Ok(len)
+    }
+}
+
+/// A writer that applies a cipher to everything written to the inner writer.
+///
+/// [`Write::write`] borrows its data immutably, so it transforms the data into a fixed
+/// scratch buffer that is allocated once, when the writer is created. Callers that own a
+/// mutable buffer can avoid the copy with [`CipherWriter::write_all_in_place`], which
+/// transforms the buffer itself.
+///
+/// `CipherWriter` does not buffer: every write reaches the inner writer before it returns.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{CaesarCipher, CipherWriter};
+/// use std::io::Write;
+///
+/// let mut writer = CipherWriter::new(Vec::new(), CaesarCipher::new(3));
+/// writer.write_all(b"Hello!")?;
+///
+/// assert_eq!(writer.into_inner(), b"Khoor$");
+/// # Ok::<(), std::io::Error>(())
+/// ```
+#[derive(Debug)]
+pub struct CipherWriter<W, A: Alphabet = Ascii128> {
+    inner: W,
+    cipher: ShiftCipher<A>,
+    scratch: Box<[u8]>,
+}
+
+impl<W: Write, A: Alphabet> CipherWriter<W, A> {
+    /// Creates a writer that applies `cipher` to the data written to `inner`.
+    pub fn new(inner: W, cipher: impl Into<ShiftCipher<A>>) -> Self {
+        CipherWriter {
+            inner,
+            cipher: cipher.into(),
+            scratch: vec![0; SCRATCH_LEN].into_boxed_slice(),
+        }
+    }
+
+    /// Transforms `buf` in place and writes all of it to the inner writer, without copying.
+    ///
+    /// On return `buf` holds the transformed data, also when an error occurred.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use ccipher::{CaesarCipher, CipherWriter};
+    ///
+    /// let mut writer = CipherWriter::new(Vec::new(), CaesarCipher::new(3));
+    /// let mut buf = *b"ABC";
+    /// writer.write_all_in_place(&mut buf)?;
+    ///
+    /// assert_eq!(&buf, b"DEF");
+    /// assert_eq!(writer.get_ref(), b"DEF");
+    /// # Ok::<(), std::io::Error>(())
+    /// ```
+    pub fn write_all_in_place(&mut self, buf: &mut [u8]) -> io::Result<()> {
+        self.cipher.apply_cipher_in_place(buf);
+        self.inner.write_all(buf)
+    }
+
+    /// Returns a reference to the inner writer.
+    pub fn get_ref(&self) -> &W {
+        &self.inner
+    }
+
+    /// Returns a mutable reference to the inner writer. Data written to it directly
+    /// bypasses the cipher.
+    pub fn get_mut(&mut self) -> &mut W {
+        &mut self.inner
+    }
+
+    /// Returns the inner writer.
+    pub fn into_inner(self) -> W {
+        self.inner
+    }
+}
+
+impl<W: Write, A: Alphabet> Write for CipherWriter<W, A> {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        // The cipher maps bytes one to one, so a short write of the transformed bytes is a
+        // short write of the same number of input bytes.
+        let len = buf.len().min(self.scratch.len());
+        let scratch = &mut self.scratch[..len];
+        self.cipher.apply_cipher_bytes(&buf[..len], scratch);
+        self.inner.write(scratch)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.inner.flush()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{CaesarCipher, Latin26};
+
+    /// Reads or writes at most `limit` bytes per call, to exercise short reads and writes.
+    struct Trickle<T> {
+        inner: T,
+        limit: usize,
+    }
+
+    impl<R: Read> Read for Trickle<R> {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            let len = buf.len().min(self.limit);
+            self.inner.read(&mut buf[..len])
+        }
+    }
+
+    impl<W: Write> Write for Trickle<W> {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            let len = buf.len().min(self.limit);
+            self.inner.write(&buf[..len])
+        }
+
+        fn flush(&mut self) -> io::Result<()> {
+            self.inner.flush()
+        }
+    }
+
+    fn sample() -> Vec<u8> {
+        (0..3 * SCRATCH_LEN + 5).map(|i| (i % 256) as u8).collect()
+    }
+
+    fn encrypted(content: &[u8], shift: i32) -> Vec<u8> {
+        let mut expected = vec![0; content.len()];
+        CaesarCipher::new(shift).apply_cipher_bytes(content, &mut expected);
+        expected
+    }
+
+    #[test]
+    fn cipher_reader_transforms_short_reads() -> io::Result<()> {
+        let content = sample();
+        let inner = Trickle {
+            inner: &content[..],
+            limit: 7,
+        };
+        let mut output = Vec::new();
+        CipherReader::new(inner, CaesarCipher::new(11)).read_to_end(&mut output)?;
+
+        assert_eq!(output, encrypted(&content, 11));
+        Ok(())
+    }
+
+    #[test]
+    fn cipher_writer_transforms_short_writes() -> io::Result<()> {
+        let content = sample();
+        let inner = Trickle {
+            inner: Vec::new(),
+            limit: 1000,
+        };
+        let mut writer = CipherWriter::new(inner, CaesarCipher::new(-3));
+        writer.write_all(&content)?;
+        writer.flush()?;
+
+        assert_eq!(writer.into_inner().inner, encrypted(&content, -3));
+        Ok(())
+    }
+
+    #[test]
+    fn adapters_use_the_cipher_alphabet() -> io::Result<()> {
+        let mut reader = CipherReader::new(&b"Hello, World!"[..], ShiftCipher::new(3, Latin26));
+        let mut encrypted = Vec::new();
+        reader.read_to_end(&mut encrypted)?;
+        assert_eq!(encrypted, b"Khoor, Zruog!");
+
+        let mut writer = CipherWriter::new(Vec::new(), ShiftCipher::new(-3, Latin26));
+        writer.write_all(&encrypted)?;
+        assert_eq!(writer.into_inner(), b"Hello, World!");
+        Ok(())
+    }
+
+    #[test]
+    fn reader_and_writer_round_trip() -> io::Result<()> {
+        let content = sample();
+        let mut reader = CipherReader::new(&content[..], CaesarCipher::new(42));
+        let mut writer = CipherWriter::new(Vec::new(), CaesarCipher::new(-42));
+        io::copy(&mut reader, &mut writer)?;
+
+        assert_eq!(writer.into_inner(), content);
+        Ok(())
+    }
+}
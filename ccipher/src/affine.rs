@@ -0,0 +1,161 @@
+//! The affine cipher `a·x + b mod 128` over the ASCII range.
+use crate::{ByteMap, ByteTransform, Transform};
+
+/// An affine cipher that maps each ASCII byte `x` to `a·x + b mod 128`.
+///
+/// The multiplier `a` must be odd, so that the cipher can be undone: there are 64 such
+/// multipliers and 128 shifts `b`, 8192 keys in all. With a multiplier of 1 the cipher is a
+/// Caesar shift by `b`. Like [`crate::CaesarCipher`], it leaves non-ASCII bytes unchanged
+/// and maps valid UTF-8 to valid UTF-8.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::AffineCipher;
+///
+/// let cipher = AffineCipher::new(5, 8);
+/// let encrypted = cipher.apply_cipher("Hello!");
+/// assert_eq!(cipher.inverse().apply_cipher(&encrypted), "Hello!");
+/// ```
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct AffineCipher {
+    multiplier: u8,
+    shift: u8,
+    transform: Transform,
+}
+
+impl AffineCipher {
+    /// Creates the cipher `multiplier·x + shift mod 128`. Both values are reduced modulo
+    /// 128.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `multiplier` is even.
+    pub fn new(multiplier: i32, shift: i32) -> Self {
+        assert!(multiplier % 2 != 0, "the multiplier must be odd");
+        let (multiplier, shift) = (multiplier.rem_euclid(128), shift.rem_euclid(128));
+        AffineCipher {
+            multiplier: multiplier as u8,
+            shift: shift as u8,
+            transform: Transform::identity().then(ByteMap::Affine(multiplier, shift)),
+        }
+    }
+
+    /// Returns the multiplier `a`, in `1..128`.
+    pub fn multiplier(&self) -> u8 {
+        self.multiplier
+    }
+
+    /// Returns the shift `b`, in `0..128`.
+    pub fn shift(&self) -> u8 {
+        self.shift
+    }
+
+    /// Returns the cipher that undoes this one: `a⁻¹·x - a⁻¹·b mod 128`.
+    pub fn inverse(&self) -> Self {
+        let inverse = inverse_mod_128(self.multiplier);
+        let shift = -i32::from(inverse) * i32::from(self.shift);
+        AffineCipher::new(i32::from(inverse), shift)
+    }
+
+    /// Applies the cipher to the input text.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use ccipher::AffineCipher;
+    ///
+    /// assert_eq!(AffineCipher::new(3, 1).apply_cipher("AB"), "DG");
+    /// ```
+    pub fn apply_cipher(&self, text: &str) -> String {
+        crate::transform_text(text, |bytes| self.apply_cipher_in_place(bytes))
+    }
+
+    /// Applies the cipher to a byte slice, writing the result to `output`.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `input` and `output` differ in length.
+    pub fn apply_cipher_bytes(&self, input: &[u8], output: &mut [u8]) {
+        assert_eq!(input.len(), output.len(), "input and output lengths differ");
+        output.copy_from_slice(input);
+        self.apply_cipher_in_place(output);
+    }
+
+    /// Applies the cipher to a byte slice in place.
+    pub fn apply_cipher_in_place(&self, bytes: &mut [u8]) {
+        self.transform.apply_in_place(bytes);
+    }
+}
+
+impl From<AffineCipher> for Transform {
+    fn from(cipher: AffineCipher) -> Self {
+        cipher.transform
+    }
+}
+
+impl ByteTransform for AffineCipher {
+    fn transform_in_place(&self, bytes: &mut [u8]) {
+        self.apply_cipher_in_place(bytes);
+    }
+}
+
+/// Returns the inverse of an odd number modulo 128.
+///
+/// Every odd `a` is its own inverse modulo 8, and each Newton step `x·(2 - a·x)` doubles the
+/// number of correct low bits, so two steps reach the 7 bits needed.
+fn inverse_mod_128(a: u8) -> u8 {
+    debug_assert!(a % 2 == 1);
+    let mut inverse = a;
+    for _ in 0..2 {
+        inverse = inverse.wrapping_mul(2u8.wrapping_sub(a.wrapping_mul(inverse)));
+    }
+    inverse & 0x7f
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::CaesarCipher;
+
+    #[test]
+    fn inverse_mod_128_inverts_every_odd_number() {
+        for a in (1..128u8).step_by(2) {
+            let inverse = inverse_mod_128(a);
+            assert_eq!(u32::from(a) * u32::from(inverse) % 128, 1, "a = {a}");
+        }
+    }
+
+    #[test]
+    fn inverse_undoes_every_key() {
+        let bytes: Vec<u8> = (0..=255).collect();
+        for multiplier in (1..128).step_by(2) {
+            for shift in [0, 1, 77, 127] {
+                let cipher = AffineCipher::new(multiplier, shift);
+                let mut output = vec![0; bytes.len()];
+                cipher.apply_cipher_bytes(&bytes, &mut output);
+                cipher.inverse().apply_cipher_in_place(&mut output);
+                assert_eq!(output, bytes, "key ({multiplier}, {shift})");
+            }
+        }
+    }
+
+    #[test]
+    fn multiplier_one_is_a_caesar_shift() {
+        let text = "Hello, 世界! ~\x00\x7f";
+        for shift in [-129, -1, 0, 5, 300] {
+            assert_eq!(
+                AffineCipher::new(1, shift).apply_cipher(text),
+                CaesarCipher::new(shift).apply_cipher(text)
+            );
+        }
+        assert_eq!(AffineCipher::new(-1, 260).multiplier(), 127);
+        assert_eq!(AffineCipher::new(-1, 260).shift(), 4);
+    }
+
+    #[test]
+    #[should_panic(expected = "the multiplier must be odd")]
+    fn new_rejects_even_multipliers() {
+        AffineCipher::new(4, 1);
+    }
+}
@@ -0,0 +1,154 @@
+//! The alphabets a [`ShiftCipher`](crate::ShiftCipher) shifts bytes within.
+//!
+//! An alphabet is a type rather than a value, so every cipher kernel is compiled separately
+//! for each alphabet, with the alphabet length as a constant.
+use clap::ValueEnum;
+use std::fmt::Debug;
+
+/// A set of bytes that a Caesar shift rotates, leaving every other byte unchanged.
+///
+/// Alphabets are zero-sized marker types. Implementations must map the bytes of the alphabet
+/// to bytes of the alphabet and nothing else, so that every shift is undone by its negation.
+///
+/// # Safety
+///
+/// An alphabet may only hold ASCII bytes, and [`Alphabet::shift_byte`] must leave every
+/// other byte unchanged. The ciphers rely on this to return text without validating it as
+/// UTF-8 again.
+pub unsafe trait Alphabet:
+    Clone + Copy + Debug + Default + PartialEq + Eq + Send + Sync + 'static
+{
+    /// Number of symbols in the alphabet, which is also the number of distinct keys.
+    const LEN: u8;
+
+    /// Returns the position of `byte` in the alphabet, in `0..LEN`, or `None` if shifts
+    /// leave it unchanged.
+    fn index(byte: u8) -> Option<u8>;
+
+    /// Shifts `byte` forward by `shift` positions, where `shift` is in `0..LEN`.
+    fn shift_byte(byte: u8, shift: u8) -> u8;
+}
+
+/// The full ASCII range `0..128`. Every ASCII byte is shifted, wrapping from 127 to 0.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{Alphabet, Ascii128};
+///
+/// assert_eq!(Ascii128::shift_byte(b'~', 5), 3);
+/// assert_eq!(Ascii128::shift_byte(0xe9, 5), 0xe9);
+/// ```
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct Ascii128;
+
+// SAFETY: the alphabet is the ASCII range, and other bytes are returned unchanged.
+unsafe impl Alphabet for Ascii128 {
+    const LEN: u8 = 128;
+
+    #[inline]
+    fn index(byte: u8) -> Option<u8> {
+        byte.is_ascii().then_some(byte)
+    }
+
+    #[inline]
+    fn shift_byte(byte: u8, shift: u8) -> u8 {
+        if byte.is_ascii() {
+            byte.wrapping_add(shift) & 0x7f
+        } else {
+            byte
+        }
+    }
+}
+
+/// The 26 letters of the classic Caesar cipher. Upper and lower case letters are shifted
+/// within their own case, and all other bytes are left unchanged.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{Alphabet, Latin26};
+///
+/// assert_eq!(Latin26::shift_byte(b'y', 3), b'b');
+/// assert_eq!(Latin26::shift_byte(b'Y', 3), b'B');
+/// assert_eq!(Latin26::shift_byte(b'!', 3), b'!');
+/// assert_eq!(Latin26::index(b'C'), Some(2));
+/// ```
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct Latin26;
+
+// SAFETY: the alphabet is the ASCII letters, and other bytes are returned unchanged.
+unsafe impl Alphabet for Latin26 {
+    const LEN: u8 = 26;
+
+    #[inline]
+    fn index(byte: u8) -> Option<u8> {
+        let index = (byte | 0x20).wrapping_sub(b'a');
+        (index < 26).then_some(index)
+    }
+
+    #[inline]
+    fn shift_byte(byte: u8, shift: u8) -> u8 {
+        // Setting bit 5 folds upper case onto lower case, so one range check finds both cases
+        // and `byte - index` is the `A` or `a` of the letter's case. The kernel is free of
+        // branches, so loops over it vectorize.
+        let index = (byte | 0x20).wrapping_sub(b'a');
+        let shifted = index.wrapping_add(shift);
+        let shifted = if shifted >= 26 { shifted - 26 } else { shifted };
+        if index < 26 {
+            byte - index + shifted
+        } else {
+            byte
+        }
+    }
+}
+
+/// Selects an [`Alphabet`] at run time, for instance from a command-line flag. Each variant
+/// is named after the alphabet type it selects.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq, ValueEnum)]
+pub enum AlphabetKind {
+    /// Every ASCII byte is shifted (128 keys).
+    #[default]
+    Ascii128,
+    /// Only the letters A-Z and a-z are shifted, preserving case (26 keys).
+    Latin26,
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn check_alphabet<A: Alphabet>() {
+        let members: Vec<u8> = (0..=255).filter(|&byte| A::index(byte).is_some()).collect();
+        for shift in 0..A::LEN {
+            for byte in 0..=255 {
+                let shifted = A::shift_byte(byte, shift);
+                match A::index(byte) {
+                    Some(index) => {
+                        assert!(members.contains(&shifted), "{byte} + {shift}");
+                        assert_eq!(A::index(shifted), Some((index + shift) % A::LEN));
+                    }
+                    None => assert_eq!(shifted, byte),
+                }
+                let back = A::shift_byte(shifted, (A::LEN - shift) % A::LEN);
+                assert_eq!(back, byte, "{byte} + {shift}");
+            }
+        }
+    }
+
+    #[test]
+    fn shifts_stay_within_the_alphabet_and_are_undone() {
+        check_alphabet::<Ascii128>();
+        check_alphabet::<Latin26>();
+    }
+
+    #[test]
+    fn latin26_preserves_case_and_skips_other_bytes() {
+        let shifted: Vec<u8> = b"Zebra@[`{ 9"
+            .iter()
+            .map(|&byte| Latin26::shift_byte(byte, 1))
+            .collect();
+        assert_eq!(shifted, b"Afcsb@[`{ 9");
+        assert!((128..=255).all(|byte| Latin26::index(byte).is_none()));
+    }
+}
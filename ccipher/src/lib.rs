@@ -28,19 +28,59 @@
 //! * Performs wrapping within the ASCII range
 //! * Preserves the original character properties
 //! * Applies consistent shifting across the entire ASCII range
+//!
+//! The classic letters-only cipher, which shifts `A-Z` and `a-z` within their case and
+//! leaves everything else alone, is `ShiftCipher<Latin26>`; see [`ShiftCipher`] and
+//! [`Alphabet`].
+//!
+//! The affine cipher `a·x + b mod 128`, which generalizes the shift, is implemented by
+//! [`AffineCipher`]. Chains of byte-wise maps (shifts, ROT13, case folding and affine maps)
+//! can be composed into a single table pass with [`Transform`].
+//!
+//! Polyalphabetic ciphers with a repeating key of shifts are implemented by
+//! [`VigenereCipher`].
+//!
+//! Whole directory trees can be transformed in parallel with [`mirror_tree`], and streams
+//! of any size can be transformed as they are read or written with [`CipherReader`] and
+//! [`CipherWriter`]. [`run`] can also encrypt one input under many keys at once, reading it
+//! only once; see [`Config::keys`].
+
+mod adapters;
+mod affine;
+mod alphabet;
+mod pipeline;
+mod shift;
+mod transform;
+mod tree;
+mod vigenere;
+
+pub use adapters::{CipherReader, CipherWriter};
+pub use affine::AffineCipher;
+pub use alphabet::{Alphabet, AlphabetKind, Ascii128, Latin26};
+pub use shift::ShiftCipher;
+pub use transform::{ByteMap, ByteTransform, Transform};
+pub use tree::{mirror_tree, TreeStats, CHUNK_LEN};
+pub use vigenere::VigenereCipher;
 
 /// Configuration structure for the Caesar cipher program.
 ///
 /// # Examples
 ///
 /// ```
-/// use ccipher::{Config, CaesarCipher};
+/// use ccipher::{AlphabetKind, Config, CaesarCipher};
 /// use std::path::PathBuf;
 ///
 /// let config = Config {
 ///     input_file: Some(PathBuf::from("input.txt")),
 ///     output_file: Some(PathBuf::from("output.txt")),
 ///     cipher: CaesarCipher::new(3),
+///     recursive: false,
+///     bytes: false,
+///     multiplier: 1,
+///     maps: Vec::new(),
+///     alphabet: AlphabetKind::Ascii128,
+///     vigenere: Vec::new(),
+///     keys: Vec::new(),
 /// };
 /// ```
 pub struct Config {
@@ -50,8 +90,40 @@ pub struct Config {
     pub output_file: Option<std::path::PathBuf>,
     /// Caesar cipher configuration containing the shift value for character transformation.
     pub cipher: CaesarCipher,
+    /// When set, `input_file` and `output_file` are directories: every file below the input
+    /// directory is transformed into the same relative path below the output directory.
+    pub recursive: bool,
+    /// When set, the input is treated as raw bytes: it is not validated as UTF-8, ASCII bytes
+    /// are shifted and every other byte is passed through unchanged.
+    pub bytes: bool,
+    /// Odd multiplier `a` of the affine cipher `a·x + shift mod 128`. With the default of 1
+    /// the cipher is the plain Caesar shift.
+    pub multiplier: i32,
+    /// Maps applied after the cipher, in order. The cipher and the maps are composed into a
+    /// single [`Transform`], so the data is still transformed in one pass.
+    pub maps: Vec<ByteMap>,
+    /// Alphabet the key shifts within. Affine multipliers other than 1 need
+    /// [`AlphabetKind::Ascii128`].
+    pub alphabet: AlphabetKind,
+    /// When not empty, the input is transformed with a [`VigenereCipher`] with these shifts
+    /// instead of `cipher`. The Vigenère cipher cannot be combined with recursive mode, a
+    /// multiplier or maps.
+    pub vigenere: Vec<i32>,
+    /// When not empty, the input is transformed under each of these keys instead of the key
+    /// of `cipher`, and written to one file per key. `output_file` must then contain
+    /// [`KEY_PLACEHOLDER`], which is replaced by the key to name each file. Several keys
+    /// cannot be combined with recursive mode or the Vigenère cipher.
+    pub keys: Vec<i32>,
 }
 
+/// The placeholder in [`Config::output_file`] that is replaced by the key when the input is
+/// encrypted under several keys.
+pub const KEY_PLACEHOLDER: &str = "{key}";
+
+/// Length of the blocks of input that are transformed under every key in turn. A block and
+/// the output blocks it is written to stay in cache while all the keys are applied.
+const FANOUT_BLOCK_LEN: usize = 16 * 1024;
+
 impl Config {
     pub fn new(
         key: i32,
@@ -62,12 +134,22 @@ impl Config {
             input_file,
             output_file,
             cipher: CaesarCipher::new(key),
+            recursive: false,
+            bytes: false,
+            multiplier: 1,
+            maps: Vec::new(),
+            alphabet: AlphabetKind::Ascii128,
+            vigenere: Vec::new(),
+            keys: Vec::new(),
         }
     }
 }
 
 /// A Caesar cipher implementation for ASCII characters.
 ///
+/// The cipher shifts every ASCII byte within the ASCII range. Shifts within other alphabets,
+/// such as the letters-only [`Latin26`], are implemented by [`ShiftCipher`].
+///
 /// # Examples
 ///
 /// ```
@@ -76,6 +158,7 @@ impl Config {
 /// let cipher = CaesarCipher { shift: 3 };
 /// assert_eq!(cipher.apply_cipher("Hello!"), "Khoor$");
 /// ```
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
 pub struct CaesarCipher {
     /// The number of positions to shift characters in the cipher.
     ///
@@ -102,7 +185,9 @@ impl CaesarCipher {
     /// Applies the Caesar cipher transformation to the input text.
     ///
     /// Takes a string slice and shifts each character by the configured shift value,
-    /// wrapping around within the ASCII range (0-127).
+    /// wrapping around within the ASCII range (0-127). Non-ASCII characters are left
+    /// unchanged. The text is transformed as bytes by [`CaesarCipher::apply_cipher_bytes`]
+    /// in a single pass, without decoding it.
     ///
     /// # Examples
     ///
@@ -113,24 +198,71 @@ impl CaesarCipher {
     /// assert_eq!(cipher.apply_cipher("ABC"), "DEF");
     /// ```
     pub fn apply_cipher(&self, text: &str) -> String {
-        text.chars()
-            .map(|c| self.shift_char(c, self.shift))
-            .collect()
+        ShiftCipher::from(*self).apply_cipher(text)
     }
 
-    fn shift_char(&self, c: char, shift: i32) -> char {
-        if !c.is_ascii() {
-            return c;
-        }
-
-        let ascii_alphabet_len = 128;
-        let pos = c as i32;
-        let shifted = (pos + shift).rem_euclid(ascii_alphabet_len);
+    /// Applies the Caesar cipher transformation to a byte slice, writing the result to
+    /// `output`.
+    ///
+    /// ASCII bytes are shifted exactly like [`CaesarCipher::apply_cipher`] shifts ASCII
+    /// characters. All other bytes are copied unchanged, so valid UTF-8 input produces valid
+    /// UTF-8 output. No memory is allocated.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `input` and `output` differ in length.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use ccipher::CaesarCipher;
+    ///
+    /// let cipher = CaesarCipher::new(3);
+    /// let mut output = [0u8; 3];
+    /// cipher.apply_cipher_bytes(b"ABC", &mut output);
+    /// assert_eq!(&output, b"DEF");
+    /// ```
+    pub fn apply_cipher_bytes(&self, input: &[u8], output: &mut [u8]) {
+        ShiftCipher::from(*self).apply_cipher_bytes(input, output);
+    }
 
-        char::from_u32(shifted as u32).unwrap_or(c)
+    /// Applies the Caesar cipher transformation to a byte slice in place.
+    ///
+    /// Bytes are transformed as by [`CaesarCipher::apply_cipher_bytes`].
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use ccipher::CaesarCipher;
+    ///
+    /// let mut bytes = *b"ABC";
+    /// CaesarCipher::new(3).apply_cipher_in_place(&mut bytes);
+    /// assert_eq!(&bytes, b"DEF");
+    /// ```
+    pub fn apply_cipher_in_place(&self, bytes: &mut [u8]) {
+        ShiftCipher::from(*self).apply_cipher_in_place(bytes);
     }
 }
 
+/// Applies an in-place byte transform to a copy of `text` and returns the result as a
+/// string, without validating it again.
+///
+/// Every cipher of this crate maps ASCII bytes to ASCII bytes and leaves all other bytes
+/// unchanged, as the safety contract of [`Alphabet`] requires of shifts, and `transform` must
+/// do the same. Each UTF-8 sequence of `text` is then either
+/// a single ASCII byte, which stays a single ASCII byte, or a run of non-ASCII bytes, which
+/// stays as it is, so the result is valid UTF-8.
+fn transform_text(text: &str, transform: impl FnOnce(&mut [u8])) -> String {
+    let mut bytes = text.as_bytes().to_vec();
+    transform(&mut bytes);
+    debug_assert!(
+        std::str::from_utf8(&bytes).is_ok(),
+        "the transform broke UTF-8"
+    );
+    // SAFETY: `transform` preserves UTF-8 as explained above.
+    unsafe { String::from_utf8_unchecked(bytes) }
+}
+
 /// Executes the cipher operation based on the provided configuration.
 ///
 /// # Returns
@@ -140,13 +272,154 @@ impl CaesarCipher {
 /// # Errors
 ///
 /// This function will return an error if:
-/// * The input file cannot be read
+/// * The input file cannot be read, or is not valid UTF-8 outside byte mode
 /// * The output file cannot be written
+/// * In recursive mode, either directory is missing from the configuration
+/// * The multiplier is even, or not 1 with the [`Latin26`] alphabet
+/// * A Vigenère key is combined with recursive mode, a multiplier or maps
+/// * Several keys are combined with recursive mode or a Vigenère key, or the output file
+///   does not contain [`KEY_PLACEHOLDER`]
 pub fn run(config: &Config) -> Result<(), Box<dyn std::error::Error>> {
-    let input = ccipher_io::read_input(&config.input_file)?;
-    let output = config.cipher.apply_cipher(&input);
-    ccipher_io::write_output(&config.output_file, &output)?;
+    if config.multiplier % 2 == 0 {
+        return Err("the multiplier must be odd".into());
+    }
+    if !config.keys.is_empty() {
+        if config.recursive || !config.vigenere.is_empty() {
+            return Err(
+                "several keys cannot be combined with recursive mode or the Vigenère cipher".into(),
+            );
+        }
+        return run_keys(config);
+    }
+    if !config.vigenere.is_empty() {
+        if config.recursive || config.multiplier != 1 || !config.maps.is_empty() {
+            return Err(
+                "the Vigenère cipher cannot be combined with recursive mode, a multiplier or maps"
+                    .into(),
+            );
+        }
+        let shifts = &config.vigenere;
+        match config.alphabet {
+            AlphabetKind::Ascii128 => run_vigenere(config, VigenereCipher::new(shifts))?,
+            AlphabetKind::Latin26 => {
+                run_vigenere(config, VigenereCipher::with_alphabet(shifts, Latin26))?
+            }
+        }
+        return Ok(());
+    }
+    let transform = key_transform(config, config.cipher.shift)?;
+    if config.recursive {
+        let (Some(input), Some(output)) = (&config.input_file, &config.output_file) else {
+            return Err("recursive mode needs an input and an output directory".into());
+        };
+        let pool = ccipher_io::WorkStealingPool::with_available_parallelism();
+        let stats = mirror_tree(&transform, input, output, &pool)?;
+        eprintln!(
+            "{} files, {} bytes in {:.3} s ({:.1} MiB/s)",
+            stats.files,
+            stats.bytes,
+            stats.elapsed.as_secs_f64(),
+            stats.throughput() / f64::from(1 << 20)
+        );
+        return Ok(());
+    }
 
+    transform_stream(config, |chunk| transform.apply_in_place(chunk))?;
+    Ok(())
+}
+
+/// Returns the transform of the cipher of `config` with the key `shift`, followed by the
+/// maps of `config`.
+fn key_transform(config: &Config, shift: i32) -> Result<Transform, Box<dyn std::error::Error>> {
+    let cipher = match config.alphabet {
+        AlphabetKind::Ascii128 => Transform::from(AffineCipher::new(config.multiplier, shift)),
+        AlphabetKind::Latin26 if config.multiplier == 1 => {
+            Transform::from(ShiftCipher::new(shift, Latin26))
+        }
+        AlphabetKind::Latin26 => {
+            return Err("affine multipliers need the ascii128 alphabet".into());
+        }
+    };
+    Ok(cipher.then_all(&config.maps))
+}
+
+/// Transforms the input under every key of `config.keys` into one output file per key,
+/// reading and validating the input only once.
+fn run_keys(config: &Config) -> Result<(), Box<dyn std::error::Error>> {
+    let Some(pattern) = config
+        .output_file
+        .as_ref()
+        .and_then(|path| path.to_str())
+        .filter(|path| path.contains(KEY_PLACEHOLDER))
+    else {
+        return Err(
+            format!("several keys need an output file containing {KEY_PLACEHOLDER}").into(),
+        );
+    };
+    let mut seen = std::collections::HashSet::new();
+    let mut keys = config.keys.clone();
+    keys.retain(|&key| seen.insert(key));
+    let transforms = keys
+        .iter()
+        .map(|&key| key_transform(config, key))
+        .collect::<Result<Vec<_>, _>>()?;
+    let outputs: Vec<std::path::PathBuf> = keys
+        .iter()
+        .map(|key| pattern.replace(KEY_PLACEHOLDER, &key.to_string()).into())
+        .collect();
+
+    let start = std::time::Instant::now();
+    let mut utf8 = (!config.bytes).then(pipeline::Utf8Check::default);
+    let bytes = pipeline::run_fanout(&config.input_file, &outputs, |chunk, buffers| {
+        if let Some(utf8) = &mut utf8 {
+            utf8.check(chunk)?;
+        }
+        for (i, block) in chunk.chunks(FANOUT_BLOCK_LEN).enumerate() {
+            let range = i * FANOUT_BLOCK_LEN..i * FANOUT_BLOCK_LEN + block.len();
+            for (transform, buffer) in transforms.iter().zip(buffers.iter_mut()) {
+                transform.apply_bytes(block, &mut buffer[range.clone()]);
+            }
+        }
+        Ok(())
+    })?;
+    if let Some(utf8) = &utf8 {
+        utf8.finish()?;
+    }
+    let elapsed = start.elapsed().as_secs_f64();
+    eprintln!(
+        "{} keys, {} bytes read in {:.3} s ({:.1} MiB/s written)",
+        keys.len(),
+        bytes,
+        elapsed,
+        (bytes * keys.len() as u64) as f64 / elapsed / f64::from(1 << 20)
+    );
+    Ok(())
+}
+
+/// Transforms the input into the output with a Vigenère cipher, carrying the key position
+/// from chunk to chunk.
+fn run_vigenere<A: Alphabet>(config: &Config, cipher: VigenereCipher<A>) -> std::io::Result<()> {
+    let mut position = 0;
+    transform_stream(config, |chunk| {
+        position = cipher.apply_cipher_from(chunk, position);
+    })
+}
+
+/// Transforms the input into the output chunk by chunk, in order.
+fn transform_stream(config: &Config, mut transform: impl FnMut(&mut [u8])) -> std::io::Result<()> {
+    // Reading, transforming and writing overlap, so only a few chunks are held in memory.
+    // Text is validated on the way; in byte mode every chunk is transformed as it is.
+    let mut utf8 = (!config.bytes).then(pipeline::Utf8Check::default);
+    pipeline::run_pipeline(&config.input_file, &config.output_file, |chunk| {
+        if let Some(utf8) = &mut utf8 {
+            utf8.check(chunk)?;
+        }
+        transform(chunk);
+        Ok(())
+    })?;
+    if let Some(utf8) = &utf8 {
+        utf8.finish()?;
+    }
     Ok(())
 }
 
@@ -208,6 +481,101 @@ mod tests {
         assert_eq!(cipher.apply_cipher(&input), expected);
     }
 
+    #[test]
+    fn apply_cipher_bytes_matches_apply_cipher() {
+        let text = "Hello, 世界! ~\x00\x7f";
+        for shift in [-129, -1, 0, 1, 5, 127, 300] {
+            let cipher = CaesarCipher::new(shift);
+            let mut output = vec![0u8; text.len()];
+            cipher.apply_cipher_bytes(text.as_bytes(), &mut output);
+            assert_eq!(output, cipher.apply_cipher(text).as_bytes());
+        }
+    }
+
+    #[test]
+    fn apply_cipher_in_place_matches_apply_cipher_bytes() {
+        let input: Vec<u8> = (0..=255).collect();
+        for shift in [-1, 0, 3, 200] {
+            let cipher = CaesarCipher::new(shift);
+            let mut expected = vec![0u8; input.len()];
+            cipher.apply_cipher_bytes(&input, &mut expected);
+            let mut bytes = input.clone();
+            cipher.apply_cipher_in_place(&mut bytes);
+            assert_eq!(bytes, expected);
+        }
+    }
+
+    #[test]
+    fn apply_cipher_bytes_passes_non_ascii_bytes_through() {
+        let cipher = CaesarCipher::new(1);
+        let mut output = [0u8; 4];
+        cipher.apply_cipher_bytes(&[0x80, 0xff, b'a', 0xc3], &mut output);
+        assert_eq!(output, [0x80, 0xff, b'b', 0xc3]);
+    }
+
+    #[test]
+    fn run_passes_non_ascii_bytes_through_in_byte_mode() -> Result<(), Box<dyn std::error::Error>> {
+        let dir = testdir::testdir!();
+        let (input, output) = (dir.join("input.bin"), dir.join("output.bin"));
+        std::fs::write(&input, b"abc\xff\x80 \xe9")?;
+
+        let mut config = Config::new(1, Some(input), Some(output.clone()));
+        assert!(run(&config).is_err(), "text mode rejects invalid UTF-8");
+
+        config.bytes = true;
+        run(&config)?;
+        assert_eq!(std::fs::read(&output)?, b"bcd\xff\x80!\xe9");
+        Ok(())
+    }
+
+    #[test]
+    fn run_carries_the_vigenere_key_across_chunks() -> Result<(), Box<dyn std::error::Error>> {
+        let dir = testdir::testdir!();
+        let (input, output) = (dir.join("input.txt"), dir.join("output.txt"));
+        let content = "Attack at dawn, 0123! ".repeat(3 * ccipher_io::CHUNK_LEN / 22 + 1);
+        std::fs::write(&input, &content)?;
+
+        let mut config = Config::new(0, Some(input), Some(output.clone()));
+        config.alphabet = AlphabetKind::Latin26;
+        config.vigenere = vec![11, 4, 12, 14, 13];
+        run(&config)?;
+        let expected = VigenereCipher::with_alphabet(&config.vigenere, Latin26);
+        assert_eq!(
+            std::fs::read_to_string(&output)?,
+            expected.apply_cipher(&content)
+        );
+
+        config.maps = vec![ByteMap::Upper];
+        assert!(run(&config).is_err());
+        Ok(())
+    }
+
+    #[test]
+    fn run_writes_one_output_per_key() -> Result<(), Box<dyn std::error::Error>> {
+        let dir = testdir::testdir!();
+        let input = dir.join("input.txt");
+        let content = "Hello, 世界! ~\x7f ".repeat(2 * ccipher_io::CHUNK_LEN / 20);
+        std::fs::write(&input, &content)?;
+
+        let pattern = dir.join(format!("shift_{KEY_PLACEHOLDER}.txt"));
+        let mut config = Config::new(0, Some(input), Some(pattern));
+        config.alphabet = AlphabetKind::Latin26;
+        config.maps = vec![ByteMap::Upper];
+        config.keys = vec![1, -5, 27, 1];
+        run(&config)?;
+        for key in [1, -5, 27] {
+            let expected = ShiftCipher::new(key, Latin26)
+                .apply_cipher(&content)
+                .to_ascii_uppercase();
+            let output = std::fs::read_to_string(dir.join(format!("shift_{key}.txt")))?;
+            assert_eq!(output, expected, "key {key}");
+        }
+
+        config.output_file = Some(dir.join("output.txt"));
+        assert!(run(&config).is_err(), "the output file needs a placeholder");
+        Ok(())
+    }
+
     #[test]
     fn apply_cipher_returns_correct_text_on_negative_shift() {
         let cipher = CaesarCipher::new(-1);
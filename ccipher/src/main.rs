@@ -3,19 +3,122 @@ use clap::Parser;
 #[derive(Parser, Debug)]
 #[command(version, about, long_about = None)]
 struct Args {
-    #[arg(help = "encryption/decryption key")]
-    key: i32,
+    #[arg(
+        required_unless_present_any = ["vigenere", "keys"],
+        help = "encryption/decryption key"
+    )]
+    key: Option<i32>,
 
     #[arg(short = 'i', long, help = "input plaintext/ciphertext file")]
     input_file: Option<std::path::PathBuf>,
 
     #[arg(short = 'o', long, help = "output plaintext/ciphertext file")]
     output_file: Option<std::path::PathBuf>,
+
+    #[arg(
+        short = 'r',
+        long,
+        requires_all = ["input_file", "output_file"],
+        help = "mirror the input directory tree to the output directory in parallel"
+    )]
+    recursive: bool,
+
+    #[arg(
+        short = 'b',
+        long,
+        help = "treat the input as raw bytes: skip UTF-8 validation and pass non-ASCII bytes through"
+    )]
+    bytes: bool,
+
+    #[arg(
+        short = 'm',
+        long,
+        default_value_t = 1,
+        allow_negative_numbers = true,
+        value_parser = parse_multiplier,
+        help = "odd multiplier A of the affine cipher A*x + KEY mod 128"
+    )]
+    multiplier: i32,
+
+    #[arg(
+        long = "then",
+        value_name = "MAP",
+        help = "apply MAP after the key shift, in the order given: shift:K, rot13, upper, lower or affine:A:B"
+    )]
+    maps: Vec<ccipher::ByteMap>,
+
+    #[arg(
+        short = 'a',
+        long,
+        value_enum,
+        default_value_t = ccipher::AlphabetKind::Ascii128,
+        help = "alphabet the key shifts within"
+    )]
+    alphabet: ccipher::AlphabetKind,
+
+    #[arg(
+        long,
+        value_name = "KEYS",
+        value_delimiter = ',',
+        allow_negative_numbers = true,
+        conflicts_with_all = ["key", "recursive", "multiplier", "maps"],
+        help = "encrypt with the Vigenere cipher, a repeating key of comma-separated shifts"
+    )]
+    vigenere: Vec<i32>,
+
+    #[arg(
+        long,
+        value_name = "KEYS",
+        value_delimiter = ',',
+        allow_negative_numbers = true,
+        value_parser = parse_key_range,
+        requires = "output_file",
+        conflicts_with_all = ["key", "recursive", "vigenere"],
+        help = "encrypt under every key of a comma-separated list of keys and ranges A..=B, \
+                writing one output per key to an OUTPUT_FILE containing {key}"
+    )]
+    keys: Vec<std::ops::RangeInclusive<i32>>,
+}
+
+fn parse_multiplier(value: &str) -> Result<i32, String> {
+    match value.parse::<i32>() {
+        Ok(multiplier) if multiplier % 2 != 0 => Ok(multiplier),
+        _ => Err(format!("{value} is not an odd integer")),
+    }
+}
+
+fn parse_key_range(value: &str) -> Result<std::ops::RangeInclusive<i32>, String> {
+    use ccipher::Alphabet;
+
+    // Every key of the largest alphabet fits in one range; longer ranges only repeat keys.
+    const MAX_RANGE_LEN: i64 = ccipher::Ascii128::LEN as i64;
+    let range = match value.split_once("..=") {
+        Some((first, last)) => first.parse().ok().zip(last.parse().ok()),
+        None => value.parse().ok().map(|key| (key, key)),
+    };
+    match range {
+        Some((first, last)) if first <= last => {
+            if i64::from(last) - i64::from(first) >= MAX_RANGE_LEN {
+                return Err(format!("{value} holds more than {MAX_RANGE_LEN} keys"));
+            }
+            Ok(first..=last)
+        }
+        _ => Err(format!("{value} is not a key or a range of keys A..=B")),
+    }
 }
 
 fn main() {
     let args = Args::parse();
-    let config = ccipher::Config::new(args.key, args.input_file, args.output_file);
+    let config = ccipher::Config {
+        recursive: args.recursive,
+        bytes: args.bytes,
+        multiplier: args.multiplier,
+        maps: args.maps,
+        alphabet: args.alphabet,
+        vigenere: args.vigenere,
+        keys: args.keys.into_iter().flatten().collect(),
+        ..ccipher::Config::new(args.key.unwrap_or(0), args.input_file, args.output_file)
+    };
 
     if let Err(e) = ccipher::run(&config) {
         eprintln!("error: {}", e);
@@ -0,0 +1,482 @@
+//! Streaming one input through a transform with reads, transforms and writes overlapped.
+//!
+//! [`run_pipeline`] splits the work into three stages connected by bounded SPSC queues: a
+//! reader thread fills buffers from the input, the calling thread transforms them in place,
+//! and a writer thread drains them to the output. Written buffers go back to the reader over
+//! a third queue, so [`BUFFERS`] buffers of [`CHUNK_LEN`] bytes serve the whole stream and
+//! throughput approaches that of the slowest stage rather than the sum of all three.
+use ccipher_io::{spsc_queue, Consumer, Producer, CHUNK_LEN};
+use std::fs::{self, File};
+use std::io::{self, Read, Write};
+use std::panic;
+use std::path::{Path, PathBuf};
+use std::thread;
+
+/// Number of buffers in flight between the stages.
+pub(crate) const BUFFERS: usize = 4;
+
+/// Number of sets of output buffers in flight in [`run_fanout`]. Each set holds a chunk per
+/// output, so two sets, one being filled while the other is written, keep memory in check
+/// when there are many outputs.
+pub(crate) const FANOUT_BUFFERS: usize = 2;
+
+/// Copies the input to the output through `transform` and returns the number of bytes
+/// written.
+///
+/// The input file is opened before the output file is created, so a missing input leaves an
+/// existing output untouched. An output that is the input file itself is written to a
+/// temporary file that replaces the input once the run succeeds; see [`OutputFile`].
+/// Otherwise, if `transform` fails, the chunks transformed before it are still written and
+/// its error is returned.
+///
+/// # Errors
+///
+/// Returns the first error of the reader, then of `transform`, then of the writer.
+pub(crate) fn run_pipeline(
+    input_file: &Option<PathBuf>,
+    output_file: &Option<PathBuf>,
+    mut transform: impl FnMut(&mut [u8]) -> io::Result<()>,
+) -> io::Result<u64> {
+    let input: Box<dyn Read + Send> = match input_file {
+        Some(path) => Box::new(File::open(path)?),
+        None => Box::new(io::stdin()),
+    };
+    let (target, output): (_, Box<dyn Write + Send>) = match output_file {
+        Some(path) => {
+            let (target, file) = OutputFile::create(input_file.as_deref(), path)?;
+            (Some(target), Box::new(file))
+        }
+        None => (None, Box::new(io::stdout())),
+    };
+
+    let (mut recycled, free) = spsc_queue(BUFFERS);
+    let (read, mut full) = spsc_queue(BUFFERS);
+    let (mut transformed, done) = spsc_queue(BUFFERS);
+    for _ in 0..BUFFERS {
+        let _ = recycled.push(Vec::with_capacity(CHUNK_LEN));
+    }
+
+    let result = thread::scope(|scope| {
+        let reader = scope.spawn(move || read_stage(input, free, read));
+        let writer = scope.spawn(move || write_stage(output, done, recycled));
+
+        let mut transform_stage = || -> io::Result<()> {
+            while let Some(mut buffer) = full.pop() {
+                transform(&mut buffer)?;
+                if transformed.push(buffer).is_err() {
+                    break;
+                }
+            }
+            Ok(())
+        };
+        let transform_result = transform_stage();
+        // Closing both queues lets the other stages wind down after an error.
+        drop((full, transformed));
+
+        let read_result = reader.join().unwrap_or_else(|e| panic::resume_unwind(e));
+        let write_result = writer.join().unwrap_or_else(|e| panic::resume_unwind(e));
+        read_result?;
+        transform_result?;
+        write_result
+    });
+    match target {
+        Some(target) => target.finish(result),
+        None => result,
+    }
+}
+
+/// Copies the input to every output file through `transform`, reading the input only once,
+/// and returns the number of bytes read.
+///
+/// `transform` receives each chunk of the input along with one buffer per output, in the
+/// order of `output_files`, each as long as the chunk. The stages overlap as in
+/// [`run_pipeline`]; the writer thread writes every output of a chunk before the next, and
+/// only [`FANOUT_BUFFERS`] sets of output buffers are in flight.
+///
+/// # Errors
+///
+/// Returns the first error of the reader, then of `transform`, then of the writer.
+pub(crate) fn run_fanout(
+    input_file: &Option<PathBuf>,
+    output_files: &[PathBuf],
+    mut transform: impl FnMut(&[u8], &mut [Vec<u8>]) -> io::Result<()>,
+) -> io::Result<u64> {
+    let input: Box<dyn Read + Send> = match input_file {
+        Some(path) => Box::new(File::open(path)?),
+        None => Box::new(io::stdin()),
+    };
+    let (targets, outputs): (Vec<_>, Vec<_>) = output_files
+        .iter()
+        .map(|path| OutputFile::create(input_file.as_deref(), path))
+        .collect::<io::Result<Vec<_>>>()?
+        .into_iter()
+        .unzip();
+
+    let (mut recycled, free) = spsc_queue(BUFFERS);
+    let (read, mut full) = spsc_queue(BUFFERS);
+    let (mut transformed, done) = spsc_queue(FANOUT_BUFFERS);
+    let (mut written, mut free_outputs) = spsc_queue(FANOUT_BUFFERS);
+    for _ in 0..BUFFERS {
+        let _ = recycled.push(Vec::with_capacity(CHUNK_LEN));
+    }
+    for _ in 0..FANOUT_BUFFERS {
+        let _ = written.push(vec![Vec::with_capacity(CHUNK_LEN); outputs.len()]);
+    }
+
+    let result = thread::scope(|scope| {
+        let reader = scope.spawn(move || read_stage(input, free, read));
+        let writer = scope.spawn(move || fanout_write_stage(outputs, done, written));
+
+        let mut bytes = 0;
+        let mut transform_stage = || -> io::Result<()> {
+            while let Some(chunk) = full.pop() {
+                let Some(mut buffers) = free_outputs.pop() else {
+                    break;
+                };
+                for buffer in &mut buffers {
+                    buffer.resize(chunk.len(), 0);
+                }
+                transform(&chunk, &mut buffers)?;
+                bytes += chunk.len() as u64;
+                // The reader is gone once the input has ended; the chunk is simply dropped.
+                let _ = recycled.push(chunk);
+                if transformed.push(buffers).is_err() {
+                    break;
+                }
+            }
+            Ok(())
+        };
+        let transform_result = transform_stage();
+        drop((full, recycled, transformed, free_outputs));
+
+        let read_result = reader.join().unwrap_or_else(|e| panic::resume_unwind(e));
+        let write_result = writer.join().unwrap_or_else(|e| panic::resume_unwind(e));
+        read_result?;
+        transform_result?;
+        write_result?;
+        Ok(bytes)
+    });
+    targets
+        .into_iter()
+        .fold(result, |result, target| target.finish(result))
+}
+
+/// An output file of the pipeline.
+///
+/// The input is read while the output is written, so an output that is the input file
+/// itself cannot be truncated up front. It is written to a temporary file in the same
+/// directory instead, which is renamed over the input once the whole run has succeeded and
+/// removed if it fails, leaving the input intact.
+struct OutputFile {
+    path: PathBuf,
+    temp: Option<PathBuf>,
+}
+
+impl OutputFile {
+    /// Creates the output file at `path`, or a temporary file next to it if `path` is the
+    /// same file as `input`.
+    fn create(input: Option<&Path>, path: &Path) -> io::Result<(Self, File)> {
+        let Some(input) = input.filter(|&input| is_same_file(input, path)) else {
+            let target = OutputFile {
+                path: path.to_path_buf(),
+                temp: None,
+            };
+            return Ok((target, File::create(path)?));
+        };
+        let name = path.file_name().unwrap_or_default().to_string_lossy();
+        let temp = path.with_file_name(format!(".{name}.{}.tmp", std::process::id()));
+        let file = File::options().write(true).create_new(true).open(&temp)?;
+        file.set_permissions(fs::metadata(input)?.permissions())?;
+        let target = OutputFile {
+            path: path.to_path_buf(),
+            temp: Some(temp),
+        };
+        Ok((target, file))
+    }
+
+    /// Moves the temporary file, if any, over the output once `result` is a success, and
+    /// removes it otherwise. Returns `result`, or the error of the rename.
+    fn finish<T>(self, result: io::Result<T>) -> io::Result<T> {
+        let Some(temp) = &self.temp else {
+            return result;
+        };
+        if result.is_ok() {
+            fs::rename(temp, &self.path)?;
+        } else {
+            let _ = fs::remove_file(temp);
+        }
+        result
+    }
+}
+
+/// Returns `true` if both paths exist and name the same file, including through links.
+pub(crate) fn is_same_file(a: &Path, b: &Path) -> bool {
+    #[cfg(unix)]
+    {
+        use std::os::unix::fs::MetadataExt;
+        match (fs::metadata(a), fs::metadata(b)) {
+            (Ok(a), Ok(b)) => a.dev() == b.dev() && a.ino() == b.ino(),
+            _ => false,
+        }
+    }
+    #[cfg(not(unix))]
+    {
+        match (fs::canonicalize(a), fs::canonicalize(b)) {
+            (Ok(a), Ok(b)) => a == b,
+            _ => false,
+        }
+    }
+}
+
+/// Fills free buffers with up to [`CHUNK_LEN`] bytes each until the input ends or the
+/// transform stage goes away.
+fn read_stage(
+    mut input: impl Read,
+    mut free: Consumer<Vec<u8>>,
+    mut read: Producer<Vec<u8>>,
+) -> io::Result<()> {
+    while let Some(mut buffer) = free.pop() {
+        buffer.clear();
+        (&mut input)
+            .take(CHUNK_LEN as u64)
+            .read_to_end(&mut buffer)?;
+        if buffer.is_empty() || read.push(buffer).is_err() {
+            break;
+        }
+    }
+    Ok(())
+}
+
+/// Writes transformed buffers in order and hands them back to the reader.
+fn write_stage(
+    mut output: impl Write,
+    mut done: Consumer<Vec<u8>>,
+    mut recycled: Producer<Vec<u8>>,
+) -> io::Result<u64> {
+    let mut written = 0;
+    while let Some(buffer) = done.pop() {
+        output.write_all(&buffer)?;
+        written += buffer.len() as u64;
+        // The reader is gone once the input has ended; the buffer is simply dropped then.
+        let _ = recycled.push(buffer);
+    }
+    output.flush()?;
+    Ok(written)
+}
+
+/// Writes every set of transformed buffers to the outputs, in order, and hands it back to
+/// the transform stage.
+fn fanout_write_stage(
+    mut outputs: Vec<File>,
+    mut done: Consumer<Vec<Vec<u8>>>,
+    mut written: Producer<Vec<Vec<u8>>>,
+) -> io::Result<()> {
+    while let Some(buffers) = done.pop() {
+        for (output, buffer) in outputs.iter_mut().zip(&buffers) {
+            output.write_all(buffer)?;
+        }
+        let _ = written.push(buffers);
+    }
+    Ok(())
+}
+
+/// Incremental UTF-8 validation of a stream that arrives in chunks, where a character may
+/// straddle two chunks.
+#[derive(Default)]
+pub(crate) struct Utf8Check {
+    /// The start of a character cut off at the end of the previous chunk.
+    pending: Vec<u8>,
+}
+
+impl Utf8Check {
+    /// Validates the next chunk of the stream.
+    pub(crate) fn check(&mut self, mut chunk: &[u8]) -> io::Result<()> {
+        while !self.pending.is_empty() {
+            let Some((&byte, rest)) = chunk.split_first() else {
+                return Ok(());
+            };
+            self.pending.push(byte);
+            chunk = rest;
+            match std::str::from_utf8(&self.pending) {
+                Ok(_) => self.pending.clear(),
+                Err(e) if e.error_len().is_none() => {}
+                Err(_) => return Err(invalid_utf8()),
+            }
+        }
+        match std::str::from_utf8(chunk) {
+            Ok(_) => Ok(()),
+            Err(e) if e.error_len().is_none() => {
+                self.pending.extend_from_slice(&chunk[e.valid_up_to()..]);
+                Ok(())
+            }
+            Err(_) => Err(invalid_utf8()),
+        }
+    }
+
+    /// Checks that the stream did not end in the middle of a character.
+    pub(crate) fn finish(&self) -> io::Result<()> {
+        if self.pending.is_empty() {
+            Ok(())
+        } else {
+            Err(invalid_utf8())
+        }
+    }
+}
+
+fn invalid_utf8() -> io::Error {
+    io::Error::new(
+        io::ErrorKind::InvalidData,
+        "stream did not contain valid UTF-8",
+    )
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::fs;
+    use testdir::testdir;
+
+    #[test]
+    fn run_pipeline_transforms_every_chunk_in_order() -> io::Result<()> {
+        let dir = testdir!();
+        let (input, output) = (dir.join("input"), dir.join("output"));
+        for len in [0, 1, CHUNK_LEN, BUFFERS * CHUNK_LEN * 3 + 7] {
+            let content: Vec<u8> = (0..len).map(|i| (i % 251) as u8).collect();
+            fs::write(&input, &content)?;
+
+            let written = run_pipeline(&Some(input.clone()), &Some(output.clone()), |chunk| {
+                chunk.iter_mut().for_each(|byte| *byte ^= 0x55);
+                Ok(())
+            })?;
+
+            let expected: Vec<u8> = content.iter().map(|byte| byte ^ 0x55).collect();
+            assert_eq!(written, len as u64);
+            assert_eq!(fs::read(&output)?, expected, "length {len}");
+        }
+        Ok(())
+    }
+
+    #[test]
+    fn run_pipeline_stops_at_the_first_transform_error() -> io::Result<()> {
+        let dir = testdir!();
+        let (input, output) = (dir.join("input"), dir.join("output"));
+        fs::write(&input, vec![b'a'; 10 * CHUNK_LEN])?;
+
+        let mut chunks = 0;
+        let result = run_pipeline(&Some(input), &Some(output.clone()), |_| {
+            chunks += 1;
+            if chunks == 3 {
+                return Err(invalid_utf8());
+            }
+            Ok(())
+        });
+
+        assert_eq!(result.unwrap_err().kind(), io::ErrorKind::InvalidData);
+        assert_eq!(fs::read(&output)?.len(), 2 * CHUNK_LEN);
+        Ok(())
+    }
+
+    #[test]
+    fn run_fanout_writes_every_output_from_one_read() -> io::Result<()> {
+        let dir = testdir!();
+        let input = dir.join("input");
+        let outputs: Vec<PathBuf> = (0..3).map(|i| dir.join(format!("output{i}"))).collect();
+        let len = FANOUT_BUFFERS * CHUNK_LEN * 3 + 7;
+        let content: Vec<u8> = (0..len).map(|i| (i % 251) as u8).collect();
+        fs::write(&input, &content)?;
+
+        let mut chunks = 0;
+        let read = run_fanout(&Some(input), &outputs, |chunk, buffers| {
+            chunks += 1;
+            for (key, buffer) in buffers.iter_mut().enumerate() {
+                for (out, &byte) in buffer.iter_mut().zip(chunk) {
+                    *out = byte ^ key as u8;
+                }
+            }
+            Ok(())
+        })?;
+
+        assert_eq!(read, len as u64);
+        assert_eq!(chunks, len.div_ceil(CHUNK_LEN));
+        for (key, output) in outputs.iter().enumerate() {
+            let expected: Vec<u8> = content.iter().map(|byte| byte ^ key as u8).collect();
+            assert_eq!(fs::read(output)?, expected, "output {key}");
+        }
+        Ok(())
+    }
+
+    #[test]
+    fn run_pipeline_transforms_a_file_in_place() -> io::Result<()> {
+        let dir = testdir!();
+        let path = dir.join("file");
+        let content: Vec<u8> = (0..3 * CHUNK_LEN + 5).map(|i| (i % 251) as u8).collect();
+        fs::write(&path, &content)?;
+
+        let file = Some(path.clone());
+        run_pipeline(&file, &file, |chunk| {
+            chunk.iter_mut().for_each(|byte| *byte ^= 0x55);
+            Ok(())
+        })?;
+        let expected: Vec<u8> = content.iter().map(|byte| byte ^ 0x55).collect();
+        assert_eq!(fs::read(&path)?, expected);
+
+        // A failed run leaves the file as it was, with no temporary file behind.
+        let result = run_pipeline(&file, &file, |_| Err(invalid_utf8()));
+        assert!(result.is_err());
+        assert_eq!(fs::read(&path)?, expected);
+        assert_eq!(fs::read_dir(&dir)?.count(), 1);
+
+        let outputs = [dir.join("other"), path.clone()];
+        run_fanout(&file, &outputs, |chunk, buffers| {
+            buffers
+                .iter_mut()
+                .for_each(|buffer| buffer.copy_from_slice(chunk));
+            Ok(())
+        })?;
+        assert_eq!(fs::read(&path)?, expected);
+        assert_eq!(fs::read(&outputs[0])?, expected);
+        Ok(())
+    }
+
+    #[test]
+    fn run_pipeline_leaves_output_alone_on_missing_input() -> io::Result<()> {
+        let dir = testdir!();
+        let output = dir.join("output");
+        fs::write(&output, "keep")?;
+
+        let result = run_pipeline(
+            &Some(dir.join("missing")),
+            &Some(output.clone()),
+            |_| Ok(()),
+        );
+        assert!(result.is_err());
+        assert_eq!(fs::read_to_string(&output)?, "keep");
+        Ok(())
+    }
+
+    #[test]
+    fn utf8_check_accepts_characters_split_across_chunks() {
+        let text = "a\u{e9}\u{20ac}\u{1f600}z".as_bytes();
+        for split in 0..=text.len() {
+            let mut check = Utf8Check::default();
+            let (first, second) = text.split_at(split);
+            assert!(check.check(first).is_ok(), "split at {split}");
+            assert!(check.check(second).is_ok(), "split at {split}");
+            assert!(check.finish().is_ok(), "split at {split}");
+        }
+    }
+
+    #[test]
+    fn utf8_check_rejects_invalid_and_truncated_input() {
+        let mut check = Utf8Check::default();
+        assert!(check.check(b"ok \xe2\x82").is_ok());
+        assert!(check.check(b"A").is_err());
+
+        let mut check = Utf8Check::default();
+        assert!(check.check(b"\xff").is_err());
+
+        let mut check = Utf8Check::default();
+        assert!(check.check(b"\xf0\x9f").is_ok());
+        assert!(check.finish().is_err());
+    }
+}
@@ -0,0 +1,101 @@
+//! The Caesar shift over any [`Alphabet`].
+use crate::{Alphabet, Ascii128, CaesarCipher};
+
+/// A Caesar cipher that shifts the bytes of an [`Alphabet`].
+///
+/// The alphabet defaults to [`Ascii128`], the whole ASCII range, where the cipher shifts
+/// exactly like [`CaesarCipher`]. With [`crate::Latin26`] it is the classic letters-only
+/// Caesar cipher.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{Latin26, ShiftCipher};
+///
+/// let cipher = ShiftCipher::new(3, Latin26);
+/// assert_eq!(cipher.apply_cipher("Xylo!"), "Abor!");
+/// assert_eq!(ShiftCipher { shift: -3, alphabet: Latin26 }.apply_cipher("Abor!"), "Xylo!");
+/// ```
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ShiftCipher<A: Alphabet = Ascii128> {
+    /// The number of positions to shift characters in the cipher.
+    ///
+    /// Positive values shift characters forward in the alphabet, while negative values shift
+    /// characters backward. The shift wraps around within the alphabet.
+    pub shift: i32,
+    /// The alphabet the shift applies to.
+    pub alphabet: A,
+}
+
+impl<A: Alphabet> ShiftCipher<A> {
+    /// Creates a cipher that shifts the bytes of `alphabet` by `shift` positions.
+    pub fn new(shift: i32, alphabet: A) -> Self {
+        ShiftCipher { shift, alphabet }
+    }
+
+    /// Applies the cipher to the input text, shifting each character of the alphabet and
+    /// leaving all other characters unchanged.
+    pub fn apply_cipher(&self, text: &str) -> String {
+        crate::transform_text(text, |bytes| self.apply_cipher_in_place(bytes))
+    }
+
+    /// Applies the cipher to a byte slice, writing the result to `output`. Bytes outside the
+    /// alphabet are copied unchanged.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `input` and `output` differ in length.
+    pub fn apply_cipher_bytes(&self, input: &[u8], output: &mut [u8]) {
+        assert_eq!(input.len(), output.len(), "input and output lengths differ");
+
+        let shift = self.byte_shift();
+        for (out, &byte) in output.iter_mut().zip(input) {
+            *out = A::shift_byte(byte, shift);
+        }
+    }
+
+    /// Applies the cipher to a byte slice in place.
+    pub fn apply_cipher_in_place(&self, bytes: &mut [u8]) {
+        let shift = self.byte_shift();
+        for byte in bytes {
+            *byte = A::shift_byte(*byte, shift);
+        }
+    }
+
+    /// Returns the shift reduced to `0..A::LEN`.
+    pub(crate) fn byte_shift(&self) -> u8 {
+        self.shift.rem_euclid(i32::from(A::LEN)) as u8
+    }
+}
+
+impl From<CaesarCipher> for ShiftCipher {
+    fn from(cipher: CaesarCipher) -> Self {
+        ShiftCipher::new(cipher.shift, Ascii128)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::Latin26;
+
+    #[test]
+    fn ascii128_shifts_match_the_caesar_cipher() {
+        let text = "Hello, 世界! ~\x00\x7f";
+        for shift in [-129, -1, 0, 5, 300] {
+            assert_eq!(
+                ShiftCipher::new(shift, Ascii128).apply_cipher(text),
+                CaesarCipher { shift }.apply_cipher(text)
+            );
+        }
+    }
+
+    #[test]
+    fn latin26_shifts_wrap_within_each_case() {
+        let cipher = ShiftCipher::new(29, Latin26);
+        assert_eq!(cipher.apply_cipher("xyz XYZ 123 é"), "abc ABC 123 é");
+        let mut output = [0; 4];
+        cipher.apply_cipher_bytes(b"Zz~\xff", &mut output);
+        assert_eq!(&output, b"Cc~\xff");
+    }
+}
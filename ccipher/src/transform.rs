@@ -0,0 +1,432 @@
+//! Composing byte-wise maps into a single lookup table.
+//!
+//! A [`Transform`] is a chain of [`ByteMap`]s compiled into a 256-byte table when the chain
+//! is built, so applying a chain of any length costs one table lookup per byte. Chains that
+//! reduce to a plain Caesar shift, such as several shifts in a row, or ROT13 as a shift of
+//! the [`Latin26`] alphabet, are recognised and run through the shift kernels of
+//! [`ShiftCipher`] instead.
+use crate::{Alphabet, Ascii128, CaesarCipher, Latin26, ShiftCipher};
+use std::fmt;
+use std::str::FromStr;
+
+/// A map from bytes to bytes that is applied to each byte of a stream on its own.
+///
+/// Only ASCII bytes are affected; every other byte is left unchanged, so valid UTF-8 stays
+/// valid UTF-8.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::ByteMap;
+///
+/// assert_eq!("shift:-3".parse(), Ok(ByteMap::Shift(-3)));
+/// assert_eq!("affine:5:8".parse(), Ok(ByteMap::Affine(5, 8)));
+/// assert_eq!(ByteMap::Rot13.to_string(), "rot13");
+/// ```
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum ByteMap {
+    /// A Caesar shift by the given number of positions, wrapping within the ASCII range
+    /// exactly like [`CaesarCipher`].
+    Shift(i32),
+    /// ROT13 over the letters `A-Z` and `a-z`, preserving case.
+    Rot13,
+    /// Maps lowercase ASCII letters to uppercase.
+    Upper,
+    /// Maps uppercase ASCII letters to lowercase.
+    Lower,
+    /// The affine map `a·x + b mod 128` over the ASCII range. It is invertible exactly when
+    /// `a` is odd.
+    Affine(i32, i32),
+}
+
+impl ByteMap {
+    /// Applies the map to a single byte.
+    pub fn apply(self, byte: u8) -> u8 {
+        if !byte.is_ascii() {
+            return byte;
+        }
+        match self {
+            ByteMap::Shift(shift) => ((i32::from(byte) + shift.rem_euclid(128)) % 128) as u8,
+            ByteMap::Rot13 => match byte {
+                b'A'..=b'Z' => b'A' + (byte - b'A' + 13) % 26,
+                b'a'..=b'z' => b'a' + (byte - b'a' + 13) % 26,
+                _ => byte,
+            },
+            ByteMap::Upper => byte.to_ascii_uppercase(),
+            ByteMap::Lower => byte.to_ascii_lowercase(),
+            ByteMap::Affine(a, b) => {
+                (a.rem_euclid(128) * i32::from(byte) + b.rem_euclid(128)).rem_euclid(128) as u8
+            }
+        }
+    }
+}
+
+impl fmt::Display for ByteMap {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            ByteMap::Shift(shift) => write!(f, "shift:{shift}"),
+            ByteMap::Rot13 => write!(f, "rot13"),
+            ByteMap::Upper => write!(f, "upper"),
+            ByteMap::Lower => write!(f, "lower"),
+            ByteMap::Affine(a, b) => write!(f, "affine:{a}:{b}"),
+        }
+    }
+}
+
+impl FromStr for ByteMap {
+    type Err = String;
+
+    /// Parses `shift:K`, `rot13`, `upper`, `lower` or `affine:A:B`.
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        let number = |value: &str| {
+            value
+                .parse::<i32>()
+                .map_err(|_| format!("{value} is not an integer"))
+        };
+        let mut parts = s.split(':');
+        let map = match (parts.next(), parts.next(), parts.next(), parts.next()) {
+            (Some("shift"), Some(shift), None, None) => ByteMap::Shift(number(shift)?),
+            (Some("rot13"), None, None, None) => ByteMap::Rot13,
+            (Some("upper"), None, None, None) => ByteMap::Upper,
+            (Some("lower"), None, None, None) => ByteMap::Lower,
+            (Some("affine"), Some(a), Some(b), None) => ByteMap::Affine(number(a)?, number(b)?),
+            _ => {
+                return Err(format!(
+                    "unknown map {s}: expected shift:K, rot13, upper, lower or affine:A:B"
+                ))
+            }
+        };
+        Ok(map)
+    }
+}
+
+/// A chain of [`ByteMap`]s compiled into one 256-byte lookup table.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{ByteMap, Transform};
+///
+/// let transform = Transform::identity()
+///     .then(ByteMap::Shift(3))
+///     .then(ByteMap::Rot13)
+///     .then(ByteMap::Upper);
+/// let mut bytes = *b"Hello!";
+/// transform.apply_in_place(&mut bytes);
+///
+/// assert_eq!(&bytes, b"XUBBE$");
+/// ```
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct Transform {
+    table: [u8; 256],
+    kernel: Kernel,
+}
+
+/// The kernel a [`Transform`] is applied with.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum Kernel {
+    /// The table is a Caesar shift of [`Ascii128`].
+    Ascii(u8),
+    /// The table is a Caesar shift of [`Latin26`].
+    Latin(u8),
+    /// Any other table.
+    Table,
+}
+
+impl Transform {
+    /// Returns the transform that leaves every byte unchanged.
+    pub fn identity() -> Self {
+        Transform {
+            table: std::array::from_fn(|byte| byte as u8),
+            kernel: Kernel::Ascii(0),
+        }
+    }
+
+    /// Returns the transform that applies `self` and then `map`.
+    pub fn then(self, map: ByteMap) -> Self {
+        Self::from_table(self.table.map(|byte| map.apply(byte)))
+    }
+
+    /// Returns the transform that applies `self` and then `maps` in order.
+    pub fn then_all(self, maps: &[ByteMap]) -> Self {
+        maps.iter()
+            .fold(self, |transform, &map| transform.then(map))
+    }
+
+    /// Returns the transform that undoes `self`, or `None` if `self` maps two bytes to the
+    /// same byte, as case folding does.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use ccipher::{ByteMap, Transform};
+    ///
+    /// let encrypt = Transform::identity().then(ByteMap::Affine(5, 8)).then(ByteMap::Shift(1));
+    /// let decrypt = encrypt.inverse().unwrap();
+    /// assert_eq!(decrypt.apply(encrypt.apply(b'q')), b'q');
+    ///
+    /// assert!(Transform::identity().then(ByteMap::Upper).inverse().is_none());
+    /// ```
+    pub fn inverse(&self) -> Option<Self> {
+        let mut table = [0; 256];
+        let mut seen = [false; 256];
+        for (byte, &mapped) in self.table.iter().enumerate() {
+            if std::mem::replace(&mut seen[usize::from(mapped)], true) {
+                return None;
+            }
+            table[usize::from(mapped)] = byte as u8;
+        }
+        Some(Self::from_table(table))
+    }
+
+    /// Returns the lookup table, indexed by input byte.
+    pub fn table(&self) -> &[u8; 256] {
+        &self.table
+    }
+
+    /// Returns the Caesar shift in `0..128` this transform amounts to, if any.
+    pub fn as_shift(&self) -> Option<u8> {
+        match self.kernel {
+            Kernel::Ascii(shift) => Some(shift),
+            Kernel::Latin(_) | Kernel::Table => None,
+        }
+    }
+
+    /// Applies the transform to a single byte.
+    pub fn apply(&self, byte: u8) -> u8 {
+        self.table[usize::from(byte)]
+    }
+
+    /// Applies the transform to a byte slice in place.
+    pub fn apply_in_place(&self, bytes: &mut [u8]) {
+        match self.kernel {
+            Kernel::Ascii(shift) => {
+                CaesarCipher::new(i32::from(shift)).apply_cipher_in_place(bytes)
+            }
+            Kernel::Latin(shift) => {
+                ShiftCipher::new(i32::from(shift), Latin26).apply_cipher_in_place(bytes)
+            }
+            Kernel::Table => {
+                for byte in bytes {
+                    *byte = self.table[usize::from(*byte)];
+                }
+            }
+        }
+    }
+
+    /// Applies the transform to `input`, writing the result to `output`.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `input` and `output` differ in length.
+    pub fn apply_bytes(&self, input: &[u8], output: &mut [u8]) {
+        match self.kernel {
+            Kernel::Ascii(shift) => {
+                CaesarCipher::new(i32::from(shift)).apply_cipher_bytes(input, output)
+            }
+            Kernel::Latin(shift) => {
+                ShiftCipher::new(i32::from(shift), Latin26).apply_cipher_bytes(input, output)
+            }
+            Kernel::Table => {
+                assert_eq!(input.len(), output.len(), "input and output lengths differ");
+                for (out, &byte) in output.iter_mut().zip(input) {
+                    *out = self.table[usize::from(byte)];
+                }
+            }
+        }
+    }
+
+    fn from_table(table: [u8; 256]) -> Self {
+        let kernel = if let Some(shift) = shift_of::<Ascii128>(&table, 0) {
+            Kernel::Ascii(shift)
+        } else if let Some(shift) = shift_of::<Latin26>(&table, b'a') {
+            Kernel::Latin(shift)
+        } else {
+            Kernel::Table
+        };
+        Transform { table, kernel }
+    }
+}
+
+/// Returns the shift of alphabet `A` that `table` amounts to, if any. `first` is the byte at
+/// index 0 of the alphabet.
+fn shift_of<A: Alphabet>(table: &[u8; 256], first: u8) -> Option<u8> {
+    let shift = A::index(table[usize::from(first)])?;
+    let is_shift = table
+        .iter()
+        .enumerate()
+        .all(|(byte, &mapped)| mapped == A::shift_byte(byte as u8, shift));
+    is_shift.then_some(shift)
+}
+
+impl<A: Alphabet> From<ShiftCipher<A>> for Transform {
+    fn from(cipher: ShiftCipher<A>) -> Self {
+        let shift = cipher.byte_shift();
+        Transform::from_table(std::array::from_fn(|byte| A::shift_byte(byte as u8, shift)))
+    }
+}
+
+impl From<CaesarCipher> for Transform {
+    fn from(cipher: CaesarCipher) -> Self {
+        Transform::from(ShiftCipher::from(cipher))
+    }
+}
+
+/// A byte-wise cipher that can be applied in place to the chunks of a stream.
+pub trait ByteTransform: Sync {
+    /// Transforms `bytes` in place.
+    fn transform_in_place(&self, bytes: &mut [u8]);
+}
+
+impl ByteTransform for CaesarCipher {
+    fn transform_in_place(&self, bytes: &mut [u8]) {
+        self.apply_cipher_in_place(bytes);
+    }
+}
+
+impl<A: Alphabet> ByteTransform for ShiftCipher<A> {
+    fn transform_in_place(&self, bytes: &mut [u8]) {
+        self.apply_cipher_in_place(bytes);
+    }
+}
+
+impl ByteTransform for Transform {
+    fn transform_in_place(&self, bytes: &mut [u8]) {
+        self.apply_in_place(bytes);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn all_bytes() -> Vec<u8> {
+        (0..=255).collect()
+    }
+
+    #[test]
+    fn chains_of_shifts_reduce_to_a_single_shift() {
+        let transform = Transform::identity().then_all(&[
+            ByteMap::Shift(100),
+            ByteMap::Shift(-3),
+            ByteMap::Shift(60),
+            // 2^31 - 1 is 127 modulo 128 and -2^31 is 0.
+            ByteMap::Shift(i32::MAX),
+            ByteMap::Shift(i32::MIN),
+        ]);
+        assert_eq!(transform.as_shift(), Some(28));
+        assert_eq!(transform, Transform::from(CaesarCipher::new(156)));
+
+        let mut bytes = all_bytes();
+        transform.apply_in_place(&mut bytes);
+        let mut expected = vec![0; 256];
+        CaesarCipher::new(28).apply_cipher_bytes(&all_bytes(), &mut expected);
+        assert_eq!(bytes, expected);
+    }
+
+    #[test]
+    fn chains_apply_their_maps_in_order() {
+        let maps = [
+            ByteMap::Shift(1),
+            ByteMap::Lower,
+            ByteMap::Rot13,
+            ByteMap::Affine(3, -7),
+            ByteMap::Upper,
+        ];
+        let transform = Transform::identity().then_all(&maps);
+        assert_eq!(transform.as_shift(), None);
+
+        let mut bytes = all_bytes();
+        transform.apply_in_place(&mut bytes);
+        for (byte, mapped) in all_bytes().into_iter().zip(bytes) {
+            let expected = maps.iter().fold(byte, |byte, map| map.apply(byte));
+            assert_eq!(mapped, expected, "byte {byte}");
+        }
+    }
+
+    #[test]
+    fn maps_leave_non_ascii_bytes_alone() {
+        let maps = [
+            ByteMap::Shift(5),
+            ByteMap::Shift(i32::MAX),
+            ByteMap::Shift(i32::MIN),
+            ByteMap::Rot13,
+            ByteMap::Upper,
+            ByteMap::Lower,
+            ByteMap::Affine(7, 3),
+        ];
+        for map in maps {
+            assert!((128..=255).all(|byte| map.apply(byte) == byte), "{map}");
+        }
+        assert_eq!(ByteMap::Rot13.apply(b'n'), b'a');
+        assert_eq!(ByteMap::Affine(3, 1).apply(50), 23);
+    }
+
+    #[test]
+    fn rot13_and_latin_shifts_use_the_latin26_kernel() {
+        let rot13 = Transform::identity().then(ByteMap::Rot13);
+        assert_eq!(rot13.kernel, Kernel::Latin(13));
+        assert_eq!(rot13.as_shift(), None);
+        let latin = Transform::from(ShiftCipher::new(-3, Latin26));
+        assert_eq!(latin.kernel, Kernel::Latin(23));
+
+        let mut bytes = all_bytes();
+        rot13.apply_in_place(&mut bytes);
+        let expected: Vec<u8> = all_bytes()
+            .into_iter()
+            .map(|b| ByteMap::Rot13.apply(b))
+            .collect();
+        assert_eq!(bytes, expected);
+    }
+
+    #[test]
+    fn apply_bytes_matches_apply_in_place_for_every_kernel() {
+        let transforms = [
+            Transform::from(CaesarCipher::new(77)),
+            Transform::identity().then(ByteMap::Rot13),
+            Transform::identity().then(ByteMap::Affine(5, 8)),
+        ];
+        for transform in transforms {
+            let mut expected = all_bytes();
+            transform.apply_in_place(&mut expected);
+            let mut output = vec![0; 256];
+            transform.apply_bytes(&all_bytes(), &mut output);
+            assert_eq!(output, expected, "{:?}", transform.kernel);
+        }
+    }
+
+    #[test]
+    fn inverse_undoes_bijections_only() {
+        let transform = Transform::identity().then_all(&[ByteMap::Rot13, ByteMap::Affine(-5, 9)]);
+        let inverse = transform.inverse().unwrap();
+        for byte in 0..=255 {
+            assert_eq!(inverse.apply(transform.apply(byte)), byte);
+        }
+
+        assert!(Transform::identity()
+            .then(ByteMap::Affine(2, 0))
+            .inverse()
+            .is_none());
+        assert!(Transform::identity()
+            .then(ByteMap::Lower)
+            .inverse()
+            .is_none());
+    }
+
+    #[test]
+    fn byte_maps_round_trip_through_strings() {
+        let maps = [
+            ByteMap::Shift(-12),
+            ByteMap::Rot13,
+            ByteMap::Upper,
+            ByteMap::Lower,
+            ByteMap::Affine(5, 300),
+        ];
+        for map in maps {
+            assert_eq!(map.to_string().parse(), Ok(map));
+        }
+        for invalid in ["", "shift", "shift:x", "rot13:1", "affine:1", "swap"] {
+            assert!(invalid.parse::<ByteMap>().is_err(), "{invalid}");
+        }
+    }
+}
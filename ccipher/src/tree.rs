@@ -0,0 +1,398 @@
+//! Encrypting a whole directory tree into a mirror tree in parallel.
+//!
+//! Work is scheduled on a [`WorkStealingPool`] in tasks of roughly [`CHUNK_LEN`] bytes: small
+//! files are grouped into batches so that each task pays for more than one `open`, and large
+//! files are split into chunks that are transformed in parallel and written in place at
+//! their offsets.
+use crate::ByteTransform;
+use ccipher_io::{FileEntry, WorkStealingPool};
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
+
+/// Number of bytes transformed by one task: the size of a chunk of a large file, and the
+/// combined size above which a batch of small files is closed.
+pub const CHUNK_LEN: u64 = 1 << 20;
+
+/// Totals of a [`mirror_tree`] run.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct TreeStats {
+    /// Number of files written.
+    pub files: u64,
+    /// Number of bytes transformed.
+    pub bytes: u64,
+    /// Wall-clock time of the run.
+    pub elapsed: Duration,
+}
+
+impl TreeStats {
+    /// Returns the aggregate throughput of the run in bytes per second.
+    pub fn throughput(&self) -> f64 {
+        self.bytes as f64 / self.elapsed.as_secs_f64().max(f64::EPSILON)
+    }
+}
+
+/// One task of the pool.
+#[derive(Debug, PartialEq)]
+enum Task {
+    /// Small files, transformed whole, one after the other.
+    Batch(Vec<usize>),
+    /// A piece of a large file whose output was created at full length up front.
+    Chunk { file: usize, offset: u64, len: u64 },
+}
+
+/// Applies `cipher` to every regular file below `input` and writes the results to the same
+/// relative paths below `output`, creating directories as needed. The cipher can be a
+/// [`crate::CaesarCipher`] or any other [`ByteTransform`], such as a composed
+/// [`crate::Transform`].
+///
+/// Existing output files are overwritten. Empty directories are not mirrored. Large files
+/// are written in place at their offsets while they are read, so the output tree must not
+/// overlap the input tree.
+///
+/// # Errors
+///
+/// Returns an error of kind `InvalidInput` if the output tree equals, contains or lies within
+/// the input tree once links are resolved, or if a target file resolves to its source.
+/// Otherwise, returns the first error encountered while walking the input tree, or while
+/// reading or writing a file, prefixed with the path of that file.
+///
+/// # Examples
+///
+/// ```no_run
+/// use ccipher::{mirror_tree, CaesarCipher};
+/// use ccipher_io::WorkStealingPool;
+/// use std::path::Path;
+///
+/// let pool = WorkStealingPool::with_available_parallelism();
+/// let stats = mirror_tree(&CaesarCipher::new(3), Path::new("plain"), Path::new("enc"), &pool)?;
+/// println!("{} files, {:.0} bytes/s", stats.files, stats.throughput());
+/// # Ok::<(), std::io::Error>(())
+/// ```
+pub fn mirror_tree<C: ByteTransform + ?Sized>(
+    cipher: &C,
+    input: &Path,
+    output: &Path,
+    pool: &WorkStealingPool,
+) -> io::Result<TreeStats> {
+    let start = Instant::now();
+    let (resolved_input, resolved_output) = (fs::canonicalize(input)?, resolve(output)?);
+    if resolved_output.starts_with(&resolved_input) || resolved_input.starts_with(&resolved_output)
+    {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidInput,
+            format!(
+                "the output directory {} overlaps the input directory {}",
+                output.display(),
+                input.display()
+            ),
+        ));
+    }
+    let files = ccipher_io::walk_files(input)?;
+    let targets: Vec<_> = files
+        .iter()
+        .map(|file| output.join(file.path.strip_prefix(input).expect("walked below input")))
+        .collect();
+
+    // Create every directory and the full-length output of every chunked file up front, so
+    // that chunks can be written in any order.
+    for (file, target) in files.iter().zip(&targets) {
+        let prepare = || -> io::Result<()> {
+            if let Some(parent) = target.parent() {
+                fs::create_dir_all(parent)?;
+            }
+            if file.len > CHUNK_LEN {
+                if crate::pipeline::is_same_file(&file.path, target) {
+                    return Err(io::Error::new(
+                        io::ErrorKind::InvalidInput,
+                        "the target is the source file itself",
+                    ));
+                }
+                File::create(target)?.set_len(file.len)?;
+            }
+            Ok(())
+        };
+        prepare().map_err(|e| with_path(e, target))?;
+    }
+
+    let results = pool.map(plan_tasks(&files), Vec::new, |buffer, task| match task {
+        Task::Batch(batch) => batch.into_iter().try_fold(0, |bytes, file| {
+            let len = transform_file(cipher, &files[file].path, &targets[file], buffer)?;
+            Ok(bytes + len)
+        }),
+        Task::Chunk { file, offset, len } => {
+            let (path, target) = (&files[file].path, &targets[file]);
+            transform_chunk(cipher, path, target, offset, len, buffer)
+        }
+    });
+
+    let mut bytes = 0;
+    for result in results {
+        bytes += result?;
+    }
+    Ok(TreeStats {
+        files: files.len() as u64,
+        bytes,
+        elapsed: start.elapsed(),
+    })
+}
+
+/// Groups small files into batches of about [`CHUNK_LEN`] bytes and splits large files into
+/// chunks of [`CHUNK_LEN`] bytes.
+fn plan_tasks(files: &[FileEntry]) -> Vec<Task> {
+    let mut tasks = Vec::new();
+    let mut batch = Vec::new();
+    let mut batch_len = 0;
+    for (index, file) in files.iter().enumerate() {
+        if file.len > CHUNK_LEN {
+            tasks.extend(
+                (0..file.len)
+                    .step_by(CHUNK_LEN as usize)
+                    .map(|offset| Task::Chunk {
+                        file: index,
+                        offset,
+                        len: CHUNK_LEN.min(file.len - offset),
+                    }),
+            );
+            continue;
+        }
+        batch.push(index);
+        batch_len += file.len;
+        if batch_len >= CHUNK_LEN {
+            tasks.push(Task::Batch(std::mem::take(&mut batch)));
+            batch_len = 0;
+        }
+    }
+    if !batch.is_empty() {
+        tasks.push(Task::Batch(batch));
+    }
+    tasks
+}
+
+/// Transforms a small file whole in the worker's `buffer` and returns its length.
+fn transform_file<C: ByteTransform + ?Sized>(
+    cipher: &C,
+    path: &Path,
+    target: &Path,
+    buffer: &mut Vec<u8>,
+) -> io::Result<u64> {
+    buffer.clear();
+    File::open(path)
+        .and_then(|mut file| file.read_to_end(buffer))
+        .map_err(|e| with_path(e, path))?;
+    cipher.transform_in_place(buffer);
+    fs::write(target, &buffer).map_err(|e| with_path(e, target))?;
+    Ok(buffer.len() as u64)
+}
+
+/// Transforms `len` bytes of a large file at `offset` into the same range of its
+/// preallocated target in the worker's `buffer` and returns `len`.
+fn transform_chunk<C: ByteTransform + ?Sized>(
+    cipher: &C,
+    path: &Path,
+    target: &Path,
+    offset: u64,
+    len: u64,
+    buffer: &mut Vec<u8>,
+) -> io::Result<u64> {
+    buffer.resize(len as usize, 0);
+    File::open(path)
+        .and_then(|mut file| {
+            file.seek(SeekFrom::Start(offset))?;
+            file.read_exact(buffer)
+        })
+        .map_err(|e| with_path(e, path))?;
+    cipher.transform_in_place(buffer);
+    OpenOptions::new()
+        .write(true)
+        .open(target)
+        .and_then(|mut file| {
+            file.seek(SeekFrom::Start(offset))?;
+            file.write_all(buffer)
+        })
+        .map_err(|e| with_path(e, target))?;
+    Ok(len)
+}
+
+/// Resolves `path` like [`fs::canonicalize`], also when its last components do not exist
+/// yet, as with an output directory that is still to be created.
+fn resolve(path: &Path) -> io::Result<PathBuf> {
+    let mut missing = Vec::new();
+    let mut existing = path;
+    loop {
+        match fs::canonicalize(existing) {
+            Ok(mut resolved) => {
+                resolved.extend(missing.iter().rev());
+                return Ok(resolved);
+            }
+            Err(e) if e.kind() == io::ErrorKind::NotFound => {
+                let (Some(parent), Some(name)) = (existing.parent(), existing.file_name()) else {
+                    return Err(e);
+                };
+                missing.push(name);
+                existing = if parent.as_os_str().is_empty() {
+                    Path::new(".")
+                } else {
+                    parent
+                };
+            }
+            Err(e) => return Err(e),
+        }
+    }
+}
+
+fn with_path(e: io::Error, path: &Path) -> io::Error {
+    io::Error::new(e.kind(), format!("{}: {e}", path.display()))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{ByteMap, CaesarCipher, Transform};
+    use std::path::PathBuf;
+    use testdir::testdir;
+
+    fn entry(len: u64) -> FileEntry {
+        FileEntry {
+            path: PathBuf::from("file"),
+            len,
+        }
+    }
+
+    #[test]
+    fn plan_tasks_batches_small_files_and_chunks_large_ones() {
+        let files = [
+            entry(10),
+            entry(CHUNK_LEN - 10),
+            entry(0),
+            entry(2 * CHUNK_LEN + 1),
+            entry(CHUNK_LEN),
+            entry(5),
+        ];
+
+        assert_eq!(
+            plan_tasks(&files),
+            vec![
+                Task::Batch(vec![0, 1]),
+                Task::Chunk {
+                    file: 3,
+                    offset: 0,
+                    len: CHUNK_LEN
+                },
+                Task::Chunk {
+                    file: 3,
+                    offset: CHUNK_LEN,
+                    len: CHUNK_LEN
+                },
+                Task::Chunk {
+                    file: 3,
+                    offset: 2 * CHUNK_LEN,
+                    len: 1
+                },
+                Task::Batch(vec![2, 4]),
+                Task::Batch(vec![5]),
+            ]
+        );
+    }
+
+    #[test]
+    fn mirror_tree_round_trips_every_file() -> io::Result<()> {
+        let dir = testdir!();
+        let (plain, encrypted, decrypted) = (dir.join("plain"), dir.join("enc"), dir.join("dec"));
+        fs::create_dir_all(plain.join("a/b"))?;
+        let large: Vec<u8> = (0..2 * CHUNK_LEN + 123).map(|i| (i % 251) as u8).collect();
+        let files: [(&str, &[u8]); 4] = [
+            ("small.txt", b"Hello, world!\n"),
+            ("a/empty", b""),
+            ("a/b/utf8.txt", "caf\u{e9} \u{1f600}".as_bytes()),
+            ("a/large.bin", &large),
+        ];
+        for (name, content) in files {
+            fs::write(plain.join(name), content)?;
+        }
+
+        let pool = WorkStealingPool::new(3);
+        let stats = mirror_tree(&CaesarCipher::new(42), &plain, &encrypted, &pool)?;
+        assert_eq!(stats.files, 4);
+        assert_eq!(
+            stats.bytes,
+            files.iter().map(|(_, c)| c.len() as u64).sum::<u64>()
+        );
+
+        for (name, content) in files {
+            let mut expected = vec![0; content.len()];
+            CaesarCipher::new(42).apply_cipher_bytes(content, &mut expected);
+            assert_eq!(fs::read(encrypted.join(name))?, expected, "{name}");
+        }
+
+        mirror_tree(&CaesarCipher::new(-42), &encrypted, &decrypted, &pool)?;
+        for (name, content) in files {
+            assert_eq!(fs::read(decrypted.join(name))?, content, "{name}");
+        }
+        Ok(())
+    }
+
+    #[test]
+    fn mirror_tree_applies_composed_transforms() -> io::Result<()> {
+        let dir = testdir!();
+        let (plain, encrypted) = (dir.join("plain"), dir.join("enc"));
+        fs::create_dir_all(&plain)?;
+        fs::write(plain.join("a.txt"), "Hello, world!")?;
+
+        let transform = Transform::identity().then_all(&[ByteMap::Rot13, ByteMap::Upper]);
+        mirror_tree(&transform, &plain, &encrypted, &WorkStealingPool::new(2))?;
+        assert_eq!(fs::read(encrypted.join("a.txt"))?, b"URYYB, JBEYQ!");
+        Ok(())
+    }
+
+    #[test]
+    fn mirror_tree_rejects_overlapping_trees() -> io::Result<()> {
+        let dir = testdir!();
+        let plain = dir.join("plain");
+        fs::create_dir_all(plain.join("sub"))?;
+        let large = vec![b'a'; 3 * CHUNK_LEN as usize];
+        fs::write(plain.join("sub/large.txt"), &large)?;
+
+        let pool = WorkStealingPool::new(2);
+        let cipher = CaesarCipher::new(1);
+        for output in [
+            plain.clone(),
+            plain.join("."),
+            plain.join("sub"),
+            plain.join("new/out"),
+            dir.clone(),
+        ] {
+            let result = mirror_tree(&cipher, &plain, &output, &pool);
+            let kind = result.map(|_| ()).unwrap_err().kind();
+            assert_eq!(kind, io::ErrorKind::InvalidInput, "{}", output.display());
+        }
+        assert_eq!(fs::read(plain.join("sub/large.txt"))?, large);
+        assert!(!plain.join("new").exists());
+
+        // A target that resolves to its source through a link is caught too.
+        #[cfg(unix)]
+        {
+            let out = dir.join("out");
+            fs::create_dir_all(&out)?;
+            std::os::unix::fs::symlink(plain.join("sub"), out.join("sub"))?;
+            let result = mirror_tree(&cipher, &plain, &out, &pool);
+            assert_eq!(result.unwrap_err().kind(), io::ErrorKind::InvalidInput);
+            assert_eq!(fs::read(plain.join("sub/large.txt"))?, large);
+        }
+        Ok(())
+    }
+
+    #[test]
+    fn mirror_tree_fails_on_missing_input() {
+        let dir = testdir!();
+        let pool = WorkStealingPool::new(2);
+        let result = mirror_tree(
+            &CaesarCipher::new(1),
+            &dir.join("missing"),
+            &dir.join("out"),
+            &pool,
+        );
+        assert!(result.is_err());
+    }
+}
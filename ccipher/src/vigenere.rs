@@ -0,0 +1,161 @@
+//! The Vigenère cipher: a repeating key of Caesar shifts.
+use crate::{Alphabet, Ascii128, ShiftCipher};
+
+/// A Vigenère cipher that shifts the bytes of an [`Alphabet`] by a repeating key of Caesar
+/// shifts.
+///
+/// The key advances at every byte of the alphabet and stays put at every other byte, so
+/// with [`crate::Latin26`] the key is only spent on letters, as in the classic cipher. Like
+/// [`ShiftCipher`], the cipher maps valid UTF-8 to valid UTF-8.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{Latin26, VigenereCipher};
+///
+/// let cipher = VigenereCipher::with_alphabet(&[11, 4, 12, 14, 13], Latin26);
+/// assert_eq!(cipher.apply_cipher("attack at dawn"), "lxfopv ef rnhr");
+/// assert_eq!(cipher.inverse().apply_cipher("lxfopv ef rnhr"), "attack at dawn");
+/// ```
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct VigenereCipher<A: Alphabet = Ascii128> {
+    /// The shifts of the key, each reduced to `0..A::LEN`.
+    shifts: Vec<u8>,
+    alphabet: A,
+}
+
+impl VigenereCipher {
+    /// Creates a Vigenère cipher over the ASCII range with the given key of shifts.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `shifts` is empty.
+    pub fn new(shifts: &[i32]) -> Self {
+        Self::with_alphabet(shifts, Ascii128)
+    }
+}
+
+impl<A: Alphabet> VigenereCipher<A> {
+    /// Creates a Vigenère cipher over `alphabet` with the given key of shifts.
+    ///
+    /// # Panics
+    ///
+    /// Panics if `shifts` is empty.
+    pub fn with_alphabet(shifts: &[i32], alphabet: A) -> Self {
+        assert!(!shifts.is_empty(), "the key needs at least one shift");
+        VigenereCipher {
+            shifts: shifts
+                .iter()
+                .map(|&shift| ShiftCipher::new(shift, alphabet).byte_shift())
+                .collect(),
+            alphabet,
+        }
+    }
+
+    /// Returns the shifts of the key, each in `0..A::LEN`.
+    pub fn shifts(&self) -> &[u8] {
+        &self.shifts
+    }
+
+    /// Returns the cipher that undoes this one.
+    pub fn inverse(&self) -> Self {
+        let shifts: Vec<i32> = self.shifts.iter().map(|&shift| -i32::from(shift)).collect();
+        Self::with_alphabet(&shifts, self.alphabet)
+    }
+
+    /// Applies the cipher to the input text.
+    pub fn apply_cipher(&self, text: &str) -> String {
+        crate::transform_text(text, |bytes| self.apply_cipher_in_place(bytes))
+    }
+
+    /// Applies the cipher to a byte slice in place, starting at the first shift of the key.
+    pub fn apply_cipher_in_place(&self, bytes: &mut [u8]) {
+        self.apply_cipher_from(bytes, 0);
+    }
+
+    /// Applies the cipher in place to a chunk of a longer stream, and returns the key
+    /// position the next chunk starts at.
+    ///
+    /// `position` is the index of the key shift that applies to the first byte of the
+    /// alphabet in `bytes`, which is the value returned for the previous chunk.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use ccipher::VigenereCipher;
+    ///
+    /// let cipher = VigenereCipher::new(&[1, 2, 3]);
+    /// let mut first = *b"abcd";
+    /// let mut second = *b"efg";
+    /// let position = cipher.apply_cipher_from(&mut first, 0);
+    /// cipher.apply_cipher_from(&mut second, position);
+    ///
+    /// assert_eq!((&first, &second), (b"bdfe", b"gih"));
+    /// ```
+    pub fn apply_cipher_from(&self, bytes: &mut [u8], position: usize) -> usize {
+        let mut position = position % self.shifts.len();
+        for byte in bytes {
+            if A::index(*byte).is_some() {
+                *byte = A::shift_byte(*byte, self.shifts[position]);
+                position += 1;
+                if position == self.shifts.len() {
+                    position = 0;
+                }
+            }
+        }
+        position
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{CaesarCipher, Latin26};
+
+    #[test]
+    fn single_shift_key_is_a_caesar_cipher() {
+        let text = "Hello, 世界! ~\x00\x7f";
+        for shift in [-130, -1, 0, 7, 300] {
+            assert_eq!(
+                VigenereCipher::new(&[shift]).apply_cipher(text),
+                CaesarCipher::new(shift).apply_cipher(text)
+            );
+            assert_eq!(
+                VigenereCipher::with_alphabet(&[shift], Latin26).apply_cipher(text),
+                ShiftCipher::new(shift, Latin26).apply_cipher(text)
+            );
+        }
+    }
+
+    #[test]
+    fn key_advances_only_on_alphabet_bytes() {
+        let cipher = VigenereCipher::with_alphabet(&[1, 2], Latin26);
+        assert_eq!(cipher.apply_cipher("a a-a é a"), "b c-b é c");
+        let cipher = VigenereCipher::new(&[1, 2]);
+        assert_eq!(cipher.apply_cipher("aéaa"), "bécb");
+    }
+
+    #[test]
+    fn chunks_match_a_single_pass() {
+        let text: Vec<u8> = (0..1000u32).map(|i| (i * 7 % 256) as u8).collect();
+        let cipher = VigenereCipher::new(&[3, -5, 64, 1, 99]);
+        let mut expected = text.clone();
+        cipher.apply_cipher_in_place(&mut expected);
+
+        let mut chunked = text.clone();
+        let mut position = 0;
+        for chunk in chunked.chunks_mut(37) {
+            position = cipher.apply_cipher_from(chunk, position);
+        }
+        assert_eq!(chunked, expected);
+
+        cipher.inverse().apply_cipher_in_place(&mut chunked);
+        assert_eq!(chunked, text);
+    }
+
+    #[test]
+    #[should_panic(expected = "the key needs at least one shift")]
+    fn new_rejects_empty_keys() {
+        VigenereCipher::new(&[]);
+    }
+}
@@ -8,27 +8,56 @@
 //!
 //! * File input/output support
 //! * Standard input/output (stdin/stdout) support
+//! * Streaming readers and writers for inputs too large to hold in memory
+//! * Directory tree walking and a work-stealing pool for processing many files in parallel
+//! * A bounded lock-free single-producer single-consumer queue for pipelines of threads
+//! * Whole-file reads and writes with an optional io_uring backend on Linux (the `io-uring`
+//!   feature) that keeps several reads or writes in flight
 //! * Error handling for I/O operations
 use std::fs::File;
-use std::io::{self, Read, Write};
+use std::io::{self, BufRead, BufReader, BufWriter, Read, Write};
 use std::path::PathBuf;
 
+mod pool;
+mod spsc;
+mod transfer;
+#[cfg(all(feature = "io-uring", target_os = "linux"))]
+mod uring;
+mod walk;
+
+pub use pool::WorkStealingPool;
+pub use spsc::{spsc_queue, Consumer, Producer};
+pub use transfer::{io_uring_available, CHUNK_LEN, QUEUE_DEPTH};
+pub use walk::{walk_files, FileEntry};
+
 /// Reads input text from either a file or standard input.
 ///
+/// The content is read as by [`read_input_bytes`] and validated as UTF-8 in a single pass.
+///
 /// # Returns
 ///
-/// * `io::Result<String>` - The content read from the input source, or an IO error.
+/// * `io::Result<String>` - The content read from the input source, or an IO error. Content
+///   that is not valid UTF-8 is an error of kind `InvalidData`.
 pub fn read_input(input_file: &Option<PathBuf>) -> io::Result<String> {
+    String::from_utf8(read_input_bytes(input_file)?).map_err(|_| {
+        io::Error::new(
+            io::ErrorKind::InvalidData,
+            "stream did not contain valid UTF-8",
+        )
+    })
+}
+
+/// Reads raw bytes from either a file or standard input, without any validation.
+///
+/// # Returns
+///
+/// * `io::Result<Vec<u8>>` - The content read from the input source, or an IO error.
+pub fn read_input_bytes(input_file: &Option<PathBuf>) -> io::Result<Vec<u8>> {
     match input_file {
-        Some(path) => {
-            let mut file = File::open(path)?;
-            let mut content = String::new();
-            file.read_to_string(&mut content)?;
-            Ok(content)
-        }
+        Some(path) => transfer::read_file(path),
         None => {
-            let mut content = String::new();
-            io::stdin().read_to_string(&mut content)?;
+            let mut content = Vec::new();
+            io::stdin().read_to_end(&mut content)?;
             Ok(content)
         }
     }
@@ -40,16 +69,51 @@ pub fn read_input(input_file: &Option<PathBuf>) -> io::Result<String> {
 ///
 /// * `io::Result<()>` - `Ok(())` if the write operation succeeds, or an IO error.
 pub fn write_output(output_file: &Option<PathBuf>, content: &str) -> io::Result<()> {
+    write_output_bytes(output_file, content.as_bytes())
+}
+
+/// Writes raw bytes to either a file or standard output.
+///
+/// # Returns
+///
+/// * `io::Result<()>` - `Ok(())` if the write operation succeeds, or an IO error.
+pub fn write_output_bytes(output_file: &Option<PathBuf>, content: &[u8]) -> io::Result<()> {
     match output_file {
-        Some(path) => {
-            let mut file = File::create(path)?;
-            file.write_all(content.as_bytes())?;
-            Ok(())
-        }
-        None => {
-            io::stdout().write_all(content.as_bytes())?;
-            Ok(())
-        }
+        Some(path) => transfer::write_file(path, content),
+        None => io::stdout().write_all(content),
+    }
+}
+
+/// Opens a buffered reader over either a file or standard input.
+///
+/// Unlike [`read_input`], the content is not loaded into memory up front, so callers can
+/// process arbitrarily large inputs a line or a chunk at a time.
+///
+/// # Returns
+///
+/// * `io::Result<Box<dyn BufRead>>` - A reader over the input source, or an IO error if the
+///   file cannot be opened.
+pub fn open_input(input_file: &Option<PathBuf>) -> io::Result<Box<dyn BufRead>> {
+    match input_file {
+        Some(path) => Ok(Box::new(BufReader::new(File::open(path)?))),
+        None => Ok(Box::new(io::stdin().lock())),
+    }
+}
+
+/// Opens a buffered writer to either a file or standard output.
+///
+/// Standard output is line buffered, so content written line by line reaches it as soon as
+/// each line is complete. The writer must be flushed once all content has been written;
+/// dropping it flushes too, but silently discards any error.
+///
+/// # Returns
+///
+/// * `io::Result<Box<dyn Write>>` - A writer to the output destination, or an IO error if
+///   the file cannot be created.
+pub fn open_output(output_file: &Option<PathBuf>) -> io::Result<Box<dyn Write>> {
+    match output_file {
+        Some(path) => Ok(Box::new(BufWriter::new(File::create(path)?))),
+        None => Ok(Box::new(io::stdout().lock())),
     }
 }
 
@@ -81,6 +145,30 @@ mod tests {
         assert!(result.is_err());
     }
 
+    #[test]
+    fn read_input_rejects_binary_content_that_read_input_bytes_accepts() -> io::Result<()> {
+        let dir = testdir!();
+        let input_path = dir.join("input.bin");
+        let content = b"caf\xe9 \x00\xff";
+        fs::write(&input_path, content)?;
+
+        let error = read_input(&Some(input_path.clone())).unwrap_err();
+        assert_eq!(error.kind(), io::ErrorKind::InvalidData);
+        assert_eq!(read_input_bytes(&Some(input_path))?, content);
+        Ok(())
+    }
+
+    #[test]
+    fn write_output_bytes_writes_binary_content() -> io::Result<()> {
+        let dir = testdir!();
+        let output_path = dir.join("output.bin");
+        let content = [0x00, 0x80, 0xff, b'a'];
+
+        write_output_bytes(&Some(output_path.clone()), &content)?;
+        assert_eq!(fs::read(output_path)?, content);
+        Ok(())
+    }
+
     #[test]
     fn write_output_to_file_returns_ok() -> io::Result<()> {
         let dir = testdir!();
@@ -102,4 +190,31 @@ mod tests {
         let result = write_output(&Some(invalid_path), content);
         assert!(result.is_err());
     }
+
+    #[test]
+    fn open_input_reads_file_line_by_line() -> io::Result<()> {
+        let dir = testdir!();
+        let input_path = dir.join("input.txt");
+        fs::write(&input_path, "first\nsecond\n")?;
+
+        let lines: Vec<String> = open_input(&Some(input_path))?
+            .lines()
+            .collect::<Result<_, _>>()?;
+        assert_eq!(lines, vec!["first", "second"]);
+        Ok(())
+    }
+
+    #[test]
+    fn open_output_writes_file_once_flushed() -> io::Result<()> {
+        let dir = testdir!();
+        let output_path = dir.join("output.txt");
+
+        let mut output = open_output(&Some(output_path.clone()))?;
+        output.write_all(b"streamed")?;
+        output.flush()?;
+
+        assert_eq!(fs::read_to_string(output_path)?, "streamed");
+        assert!(open_output(&Some(PathBuf::from("/nonexistent/directory/file.txt"))).is_err());
+        Ok(())
+    }
 }
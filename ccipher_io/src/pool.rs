@@ -0,0 +1,193 @@
+//! A small work-stealing thread pool for batches of independent tasks.
+//!
+//! Tasks are dealt out to the workers in contiguous blocks, so neighbouring tasks (for
+//! example the pieces of one file) tend to run on the same thread. Each worker takes tasks
+//! from the front of its own queue; once its queue is empty it steals from the back of the
+//! other workers' queues, so a worker that drew a few large tasks does not hold up the rest.
+use std::collections::VecDeque;
+use std::num::NonZeroUsize;
+use std::panic;
+use std::sync::Mutex;
+use std::thread;
+
+/// A fixed number of worker threads that process a batch of tasks with work stealing.
+///
+/// Threads are spawned for each call to [`WorkStealingPool::map`] and joined before it
+/// returns, so tasks may borrow from the caller.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher_io::WorkStealingPool;
+///
+/// let pool = WorkStealingPool::new(4);
+/// let lengths = pool.map(vec!["a", "bb", "ccc"], || (), |_, word| word.len());
+///
+/// assert_eq!(lengths, vec![1, 2, 3]);
+/// ```
+#[derive(Clone, Copy, Debug)]
+pub struct WorkStealingPool {
+    threads: usize,
+}
+
+impl WorkStealingPool {
+    /// Creates a pool of `threads` workers, or of one worker if `threads` is zero.
+    pub fn new(threads: usize) -> Self {
+        WorkStealingPool {
+            threads: threads.max(1),
+        }
+    }
+
+    /// Creates a pool with one worker per available CPU.
+    pub fn with_available_parallelism() -> Self {
+        Self::new(thread::available_parallelism().map_or(1, NonZeroUsize::get))
+    }
+
+    /// Returns the number of workers of the pool.
+    pub fn threads(&self) -> usize {
+        self.threads
+    }
+
+    /// Runs `work` on every task and returns the results in the order of `tasks`.
+    ///
+    /// Every worker creates its own state with `init` and passes it to each task it runs,
+    /// so scratch buffers are allocated once per worker rather than once per task.
+    ///
+    /// # Panics
+    ///
+    /// Resumes the panic of any task that panicked.
+    pub fn map<T, R, S>(
+        &self,
+        tasks: Vec<T>,
+        init: impl Fn() -> S + Sync,
+        work: impl Fn(&mut S, T) -> R + Sync,
+    ) -> Vec<R>
+    where
+        T: Send,
+        R: Send,
+    {
+        let len = tasks.len();
+        let workers = self.threads.min(len);
+        if workers <= 1 {
+            let mut state = init();
+            return tasks
+                .into_iter()
+                .map(|task| work(&mut state, task))
+                .collect();
+        }
+
+        let mut tasks = tasks.into_iter().enumerate();
+        let queues: Vec<Mutex<VecDeque<(usize, T)>>> = (0..workers)
+            .map(|worker| {
+                let block = (worker + 1) * len / workers - worker * len / workers;
+                Mutex::new(tasks.by_ref().take(block).collect())
+            })
+            .collect();
+
+        let mut results: Vec<Option<R>> = (0..len).map(|_| None).collect();
+        thread::scope(|scope| {
+            let handles: Vec<_> = (0..workers)
+                .map(|worker| {
+                    let (queues, init, work) = (&queues, &init, &work);
+                    scope.spawn(move || {
+                        let mut state = init();
+                        let mut done = Vec::new();
+                        while let Some((index, task)) = next_task(queues, worker) {
+                            done.push((index, work(&mut state, task)));
+                        }
+                        done
+                    })
+                })
+                .collect();
+            for handle in handles {
+                let done = handle.join().unwrap_or_else(|e| panic::resume_unwind(e));
+                for (index, result) in done {
+                    results[index] = Some(result);
+                }
+            }
+        });
+
+        results
+            .into_iter()
+            .map(|result| result.expect("every task runs exactly once"))
+            .collect()
+    }
+}
+
+/// Pops the next task of `worker`'s own queue, or steals one from the back of another queue.
+///
+/// No tasks are added once the workers start, so finding every queue empty means the batch
+/// is done.
+fn next_task<T>(queues: &[Mutex<VecDeque<(usize, T)>>], worker: usize) -> Option<(usize, T)> {
+    if let Some(task) = queues[worker].lock().unwrap().pop_front() {
+        return Some(task);
+    }
+    (1..queues.len())
+        .map(|offset| (worker + offset) % queues.len())
+        .find_map(|victim| queues[victim].lock().unwrap().pop_back())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+    use std::time::Duration;
+
+    #[test]
+    fn map_returns_results_in_task_order() {
+        for threads in [0, 1, 3, 8, 100] {
+            let pool = WorkStealingPool::new(threads);
+            let squares = pool.map((0..50u64).collect(), || (), |_, n| n * n);
+            assert_eq!(squares, (0..50u64).map(|n| n * n).collect::<Vec<_>>());
+        }
+        assert!(WorkStealingPool::new(4)
+            .map(Vec::<u8>::new(), || (), |_, n| n)
+            .is_empty());
+    }
+
+    #[test]
+    fn map_steals_from_a_worker_with_slow_tasks() {
+        // The first worker is dealt every slow task; the others must help it out.
+        let pool = WorkStealingPool::new(2);
+        let tasks = vec![true, true, true, true, false, false, false, false];
+        let workers = pool.map(
+            tasks,
+            || thread::current().id(),
+            |id, slow| {
+                if slow {
+                    thread::sleep(Duration::from_millis(20));
+                }
+                *id
+            },
+        );
+
+        assert_ne!(workers[0], workers[3]);
+    }
+
+    #[test]
+    fn map_creates_state_once_per_worker() {
+        let states = AtomicUsize::new(0);
+        let pool = WorkStealingPool::new(3);
+        let results = pool.map(
+            (0..30).collect(),
+            || states.fetch_add(1, Ordering::Relaxed),
+            |_, n: u32| n,
+        );
+
+        assert_eq!(results.len(), 30);
+        assert_eq!(states.load(Ordering::Relaxed), 3);
+    }
+
+    #[test]
+    #[should_panic(expected = "task failed")]
+    fn map_resumes_task_panics() {
+        WorkStealingPool::new(2).map(
+            vec![1, 2, 3],
+            || (),
+            |_, n| {
+                assert_ne!(n, 2, "task failed");
+                n
+            },
+        );
+    }
+}
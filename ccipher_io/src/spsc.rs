@@ -0,0 +1,245 @@
+//! A bounded single-producer single-consumer queue for handing buffers between threads.
+//!
+//! The queue is a ring of slots indexed by two counters: the producer alone advances `tail`
+//! and the consumer alone advances `head`, so neither side takes a lock to push or pop. A
+//! side that finds the ring full (or empty) parks its thread until the other side makes
+//! progress or goes away.
+use std::cell::UnsafeCell;
+use std::mem::MaybeUninit;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread::{self, Thread};
+
+/// Creates a queue holding up to `capacity` values, or one value if `capacity` is zero.
+///
+/// Both ends block: [`Producer::push`] waits while the queue is full and
+/// [`Consumer::pop`] waits while it is empty. Dropping one end wakes up the other.
+///
+/// # Examples
+///
+/// ```
+/// use std::thread;
+///
+/// let (mut producer, mut consumer) = ccipher_io::spsc_queue(2);
+/// let sender = thread::spawn(move || {
+///     for n in 0..10 {
+///         producer.push(n).unwrap();
+///     }
+/// });
+///
+/// let received: Vec<u32> = std::iter::from_fn(|| consumer.pop()).collect();
+/// sender.join().unwrap();
+/// assert_eq!(received, (0..10).collect::<Vec<_>>());
+/// ```
+pub fn spsc_queue<T: Send>(capacity: usize) -> (Producer<T>, Consumer<T>) {
+    let shared = Arc::new(Shared {
+        slots: (0..capacity.max(1))
+            .map(|_| UnsafeCell::new(MaybeUninit::uninit()))
+            .collect(),
+        head: AtomicUsize::new(0),
+        tail: AtomicUsize::new(0),
+        closed: AtomicBool::new(false),
+        producer: Waiter::default(),
+        consumer: Waiter::default(),
+    });
+    (
+        Producer {
+            shared: Arc::clone(&shared),
+        },
+        Consumer { shared },
+    )
+}
+
+/// The sending end of a [`spsc_queue`].
+pub struct Producer<T> {
+    shared: Arc<Shared<T>>,
+}
+
+/// The receiving end of a [`spsc_queue`].
+pub struct Consumer<T> {
+    shared: Arc<Shared<T>>,
+}
+
+struct Shared<T> {
+    slots: Box<[UnsafeCell<MaybeUninit<T>>]>,
+    /// Number of values popped so far; written by the consumer only.
+    head: AtomicUsize,
+    /// Number of values pushed so far; written by the producer only.
+    tail: AtomicUsize,
+    /// Set once either end has been dropped.
+    closed: AtomicBool,
+    /// Where the producer waits for a free slot.
+    producer: Waiter,
+    /// Where the consumer waits for a value.
+    consumer: Waiter,
+}
+
+// The slots between `head` and `tail` belong to the consumer and the others to the producer,
+// and each end is owned by one thread at a time.
+unsafe impl<T: Send> Send for Shared<T> {}
+unsafe impl<T: Send> Sync for Shared<T> {}
+
+/// The thread of one end while it is blocked on the queue.
+#[derive(Default)]
+struct Waiter {
+    parked: AtomicBool,
+    thread: Mutex<Option<Thread>>,
+}
+
+impl Waiter {
+    /// Parks the current thread until `ready` holds.
+    fn wait_until(&self, ready: impl Fn() -> bool) {
+        while !ready() {
+            *self.thread.lock().unwrap() = Some(thread::current());
+            // Pairs with the load in `wake`: either the other end sees the flag, or this
+            // end sees its progress when checking again below.
+            self.parked.store(true, Ordering::SeqCst);
+            if !ready() {
+                thread::park();
+            }
+            self.parked.store(false, Ordering::SeqCst);
+        }
+    }
+
+    /// Wakes up the thread blocked on the queue, if any.
+    fn wake(&self) {
+        if self.parked.load(Ordering::SeqCst) {
+            if let Some(thread) = self.thread.lock().unwrap().as_ref() {
+                thread.unpark();
+            }
+        }
+    }
+}
+
+impl<T> Shared<T> {
+    fn slot(&self, index: usize) -> *mut MaybeUninit<T> {
+        self.slots[index % self.slots.len()].get()
+    }
+
+    fn close(&self) {
+        self.closed.store(true, Ordering::SeqCst);
+        self.producer.wake();
+        self.consumer.wake();
+    }
+}
+
+impl<T> Producer<T> {
+    /// Appends `value` to the queue, waiting while the queue is full.
+    ///
+    /// # Errors
+    ///
+    /// Returns `value` back if the consumer has been dropped.
+    pub fn push(&mut self, value: T) -> Result<(), T> {
+        let shared = &*self.shared;
+        let tail = shared.tail.load(Ordering::Relaxed);
+        shared.producer.wait_until(|| {
+            tail - shared.head.load(Ordering::SeqCst) < shared.slots.len()
+                || shared.closed.load(Ordering::SeqCst)
+        });
+        if shared.closed.load(Ordering::SeqCst) {
+            return Err(value);
+        }
+        // SAFETY: the slot at `tail` is free, and only the producer writes to free slots.
+        unsafe { (*shared.slot(tail)).write(value) };
+        shared.tail.store(tail + 1, Ordering::SeqCst);
+        shared.consumer.wake();
+        Ok(())
+    }
+}
+
+impl<T> Consumer<T> {
+    /// Removes the oldest value from the queue, waiting while the queue is empty.
+    ///
+    /// Returns `None` once the producer has been dropped and every value it pushed has been
+    /// popped.
+    pub fn pop(&mut self) -> Option<T> {
+        let shared = &*self.shared;
+        let head = shared.head.load(Ordering::Relaxed);
+        shared.consumer.wait_until(|| {
+            shared.tail.load(Ordering::SeqCst) != head || shared.closed.load(Ordering::SeqCst)
+        });
+        if shared.tail.load(Ordering::SeqCst) == head {
+            return None;
+        }
+        // SAFETY: the slot at `head` was filled by the producer before it advanced `tail`.
+        let value = unsafe { (*shared.slot(head)).assume_init_read() };
+        shared.head.store(head + 1, Ordering::SeqCst);
+        shared.producer.wake();
+        Some(value)
+    }
+}
+
+impl<T> Drop for Producer<T> {
+    fn drop(&mut self) {
+        self.shared.close();
+    }
+}
+
+impl<T> Drop for Consumer<T> {
+    fn drop(&mut self) {
+        self.shared.close();
+    }
+}
+
+impl<T> Drop for Shared<T> {
+    fn drop(&mut self) {
+        // Both ends are gone; drop the values that were pushed but never popped.
+        let (head, tail) = (*self.head.get_mut(), *self.tail.get_mut());
+        for index in head..tail {
+            // SAFETY: the slots between `head` and `tail` hold initialized values.
+            unsafe { (*self.slot(index)).assume_init_drop() };
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::AtomicUsize;
+
+    #[test]
+    fn values_arrive_in_order_across_threads() {
+        for capacity in [0, 1, 3, 64] {
+            let (mut producer, mut consumer) = spsc_queue(capacity);
+            let sender = thread::spawn(move || {
+                for n in 0..10_000u32 {
+                    producer.push(n).unwrap();
+                }
+            });
+            let received: Vec<u32> = std::iter::from_fn(|| consumer.pop()).collect();
+            sender.join().unwrap();
+            assert_eq!(received, (0..10_000).collect::<Vec<_>>());
+        }
+    }
+
+    #[test]
+    fn push_fails_once_the_consumer_is_gone() {
+        let (mut producer, consumer) = spsc_queue(1);
+        producer.push(1).unwrap();
+        let blocked = thread::spawn(move || producer.push(2));
+        thread::sleep(std::time::Duration::from_millis(20));
+        drop(consumer);
+        assert_eq!(blocked.join().unwrap(), Err(2));
+    }
+
+    #[test]
+    fn values_left_in_the_queue_are_dropped() {
+        struct Counted<'a>(&'a AtomicUsize);
+        impl Drop for Counted<'_> {
+            fn drop(&mut self) {
+                self.0.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+
+        let drops = AtomicUsize::new(0);
+        let (mut producer, mut consumer) = spsc_queue(4);
+        for _ in 0..3 {
+            assert!(producer.push(Counted(&drops)).is_ok());
+        }
+        drop(producer);
+        drop(consumer.pop());
+        assert_eq!(drops.load(Ordering::Relaxed), 1);
+        drop(consumer);
+        assert_eq!(drops.load(Ordering::Relaxed), 3);
+    }
+}
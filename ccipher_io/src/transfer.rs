@@ -0,0 +1,107 @@
+//! Whole-file transfers between memory and regular files.
+//!
+//! With the `io-uring` feature on Linux, [`crate::read_input_bytes`] and
+//! [`crate::write_output_bytes`] keep [`QUEUE_DEPTH`] requests of [`CHUNK_LEN`] bytes in
+//! flight on an io_uring instance for files that span several chunks. Where
+//! io_uring is unavailable (other platforms, older kernels, or sandboxes that forbid it) the
+//! same functions fall back to blocking reads and writes.
+use std::fs::File;
+use std::io::{self, Read, Write};
+use std::path::Path;
+
+/// Size of one read or write request.
+pub const CHUNK_LEN: usize = 256 * 1024;
+/// Number of requests kept in flight by the io_uring backend.
+pub const QUEUE_DEPTH: usize = 8;
+
+/// Returns `true` if whole-file reads and writes of regular files use the io_uring backend.
+pub fn io_uring_available() -> bool {
+    #[cfg(all(feature = "io-uring", target_os = "linux"))]
+    {
+        crate::uring::Ring::new().is_ok()
+    }
+    #[cfg(not(all(feature = "io-uring", target_os = "linux")))]
+    {
+        false
+    }
+}
+
+/// Reads a whole file, with several reads in flight when the io_uring backend is available
+/// and the file spans more than one chunk.
+pub(crate) fn read_file(path: &Path) -> io::Result<Vec<u8>> {
+    let mut file = File::open(path)?;
+    let mut content = Vec::new();
+    #[cfg(all(feature = "io-uring", target_os = "linux"))]
+    {
+        use std::io::{Seek, SeekFrom};
+
+        let len = file.metadata()?.len() as usize;
+        if len > CHUNK_LEN {
+            if let Ok(mut ring) = crate::uring::Ring::new() {
+                content.resize(len, 0);
+                let read = ring.read_into(&file, &mut content)?;
+                content.truncate(read);
+                // Pick up anything appended since the length was taken.
+                file.seek(SeekFrom::Start(read as u64))?;
+            }
+        }
+    }
+    file.read_to_end(&mut content)?;
+    Ok(content)
+}
+
+/// Creates or truncates a file and writes `content` to it, with several writes in flight
+/// when the io_uring backend is available, the content spans more than one chunk and the
+/// file is a regular file. Pipes, FIFOs and devices such as `/dev/stdout` are written in
+/// order, since writes at offsets would interleave on them.
+pub(crate) fn write_file(path: &Path, content: &[u8]) -> io::Result<()> {
+    let mut file = File::create(path)?;
+    #[cfg(all(feature = "io-uring", target_os = "linux"))]
+    if content.len() > CHUNK_LEN && file.metadata()?.is_file() {
+        if let Ok(mut ring) = crate::uring::Ring::new() {
+            return ring.write_from(&file, content);
+        }
+    }
+    file.write_all(content)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::fs;
+    use testdir::testdir;
+
+    fn sample(len: usize) -> Vec<u8> {
+        (0..len).map(|i| (i * 7 % 256) as u8).collect()
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn write_file_keeps_the_order_of_chunks_on_a_fifo() -> io::Result<()> {
+        let dir = testdir!();
+        let fifo = dir.join("fifo");
+        let status = std::process::Command::new("mkfifo").arg(&fifo).status()?;
+        assert!(status.success());
+        let content = sample(QUEUE_DEPTH * CHUNK_LEN + 17);
+
+        let reader = std::thread::spawn({
+            let fifo = fifo.clone();
+            move || fs::read(fifo)
+        });
+        write_file(&fifo, &content)?;
+        assert_eq!(reader.join().unwrap()?, content);
+        Ok(())
+    }
+
+    #[test]
+    fn read_file_and_write_file_round_trip_large_content() -> io::Result<()> {
+        let dir = testdir!();
+        let path = dir.join("large");
+        let content = sample(3 * CHUNK_LEN + 17);
+
+        write_file(&path, &content)?;
+        assert_eq!(fs::read(&path)?, content);
+        assert_eq!(read_file(&path)?, content);
+        Ok(())
+    }
+}
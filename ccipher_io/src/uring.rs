@@ -0,0 +1,421 @@
+//! A minimal io_uring driver for reading, writing and transforming whole files.
+//!
+//! Only the few operations the transfers in [`crate::transfer`] need are implemented, on
+//! top of the raw system calls. Every function keeps up to [`QUEUE_DEPTH`] requests in flight
+//! and waits for all of them to complete before returning, even on error, so the kernel never
+//! touches a buffer after it has been handed back to the caller.
+use crate::transfer::{CHUNK_LEN, QUEUE_DEPTH};
+use std::fs::File;
+use std::io;
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd, RawFd};
+use std::ptr;
+use std::sync::atomic::{AtomicU32, Ordering};
+
+const IORING_OFF_SQ_RING: libc::off_t = 0;
+const IORING_OFF_CQ_RING: libc::off_t = 0x8000000;
+const IORING_OFF_SQES: libc::off_t = 0x10000000;
+const IORING_ENTER_GETEVENTS: libc::c_uint = 1;
+/// Present from Linux 5.7, which also has the plain read and write operations used here.
+const IORING_FEAT_FAST_POLL: u32 = 1 << 5;
+
+const IORING_OP_READ: u8 = 22;
+const IORING_OP_WRITE: u8 = 23;
+
+#[repr(C)]
+#[derive(Default)]
+struct SqringOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    flags: u32,
+    dropped: u32,
+    array: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+#[repr(C)]
+#[derive(Default)]
+struct CqringOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    overflow: u32,
+    cqes: u32,
+    flags: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+#[repr(C)]
+#[derive(Default)]
+struct Params {
+    sq_entries: u32,
+    cq_entries: u32,
+    flags: u32,
+    sq_thread_cpu: u32,
+    sq_thread_idle: u32,
+    features: u32,
+    wq_fd: u32,
+    resv: [u32; 3],
+    sq_off: SqringOffsets,
+    cq_off: CqringOffsets,
+}
+
+/// A submission queue entry.
+#[repr(C)]
+#[derive(Default)]
+struct Sqe {
+    opcode: u8,
+    flags: u8,
+    ioprio: u16,
+    fd: i32,
+    off: u64,
+    addr: u64,
+    len: u32,
+    rw_flags: u32,
+    user_data: u64,
+    buf_index: u16,
+    personality: u16,
+    splice_fd_in: i32,
+    addr3: u64,
+    pad: u64,
+}
+
+/// A completion queue entry.
+#[repr(C)]
+struct Cqe {
+    user_data: u64,
+    res: i32,
+    flags: u32,
+}
+
+/// A memory mapping of one of the ring regions, unmapped on drop.
+struct Mapping {
+    ptr: *mut u8,
+    len: usize,
+}
+
+impl Mapping {
+    fn new(fd: RawFd, len: usize, offset: libc::off_t) -> io::Result<Self> {
+        // SAFETY: a fresh shared mapping of the ring file descriptor; the kernel validates the
+        // offset and length.
+        let ptr = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                fd,
+                offset,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Mapping {
+            ptr: ptr.cast(),
+            len,
+        })
+    }
+
+    /// Returns the ring field at byte `offset` of the mapping.
+    fn at<T>(&self, offset: u32) -> *mut T {
+        debug_assert!(offset as usize + size_of::<T>() <= self.len);
+        // SAFETY: the offsets come from the kernel and lie within the mapping.
+        unsafe { self.ptr.add(offset as usize).cast() }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        // SAFETY: the mapping was created by `Mapping::new` and is not used afterwards.
+        unsafe { libc::munmap(self.ptr.cast(), self.len) };
+    }
+}
+
+/// An io_uring instance with its submission and completion rings mapped.
+pub(crate) struct Ring {
+    fd: OwnedFd,
+    sq: Mapping,
+    cq: Mapping,
+    sqes: Mapping,
+    params: Params,
+    /// Entries pushed since the last call to `io_uring_enter`.
+    pending: u32,
+}
+
+impl Ring {
+    /// Sets up a ring of [`QUEUE_DEPTH`] entries, failing with `Unsupported` on kernels that
+    /// lack the operations used here.
+    pub(crate) fn new() -> io::Result<Self> {
+        let mut params = Params::default();
+        // SAFETY: `params` is a valid `io_uring_params` the kernel fills in.
+        let fd = unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_setup,
+                QUEUE_DEPTH as u32,
+                &mut params as *mut Params,
+            )
+        };
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        // SAFETY: `fd` was just returned by the kernel and is not owned by anything else.
+        let fd = unsafe { OwnedFd::from_raw_fd(fd as RawFd) };
+        if params.features & IORING_FEAT_FAST_POLL == 0 {
+            return Err(io::ErrorKind::Unsupported.into());
+        }
+
+        let sq_len = params.sq_off.array as usize + params.sq_entries as usize * 4;
+        let cq_len = params.cq_off.cqes as usize + params.cq_entries as usize * size_of::<Cqe>();
+        let sqes_len = params.sq_entries as usize * size_of::<Sqe>();
+        let sq = Mapping::new(fd.as_raw_fd(), sq_len, IORING_OFF_SQ_RING)?;
+        let cq = Mapping::new(fd.as_raw_fd(), cq_len, IORING_OFF_CQ_RING)?;
+        let sqes = Mapping::new(fd.as_raw_fd(), sqes_len, IORING_OFF_SQES)?;
+        Ok(Ring {
+            fd,
+            sq,
+            cq,
+            sqes,
+            params,
+            pending: 0,
+        })
+    }
+
+    /// Queues a request. Callers never have more requests in flight than the ring has
+    /// entries, so there is always room.
+    fn push(&mut self, sqe: Sqe) {
+        let off = &self.params.sq_off;
+        // SAFETY: the ring fields are valid for the lifetime of the mapping, and only this
+        // thread writes the tail.
+        unsafe {
+            let tail = &*self.sq.at::<AtomicU32>(off.tail);
+            let mask = *self.sq.at::<u32>(off.ring_mask);
+            let t = tail.load(Ordering::Relaxed);
+            let index = t & mask;
+            self.sqes
+                .at::<Sqe>(index * size_of::<Sqe>() as u32)
+                .write(sqe);
+            self.sq.at::<u32>(off.array + index * 4).write(index);
+            tail.store(t.wrapping_add(1), Ordering::Release);
+        }
+        self.pending += 1;
+    }
+
+    /// Submits the queued requests and waits until at least one completion is available.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the kernel rejects the call for any reason other than a transient one. The
+    /// requests already in flight could then still be using their buffers, so unwinding is
+    /// the only way out that does not return those buffers to the caller.
+    fn submit_and_wait(&mut self) {
+        loop {
+            // SAFETY: plain system call on the ring descriptor.
+            let res = unsafe {
+                libc::syscall(
+                    libc::SYS_io_uring_enter,
+                    self.fd.as_raw_fd(),
+                    self.pending,
+                    1 as libc::c_uint,
+                    IORING_ENTER_GETEVENTS,
+                    ptr::null::<libc::sigset_t>(),
+                    0usize,
+                )
+            };
+            if res >= 0 {
+                self.pending -= res as u32;
+                return;
+            }
+            let e = io::Error::last_os_error();
+            match e.raw_os_error() {
+                Some(libc::EINTR | libc::EAGAIN | libc::EBUSY) => {}
+                _ => panic!("io_uring_enter failed with requests in flight: {e}"),
+            }
+        }
+    }
+
+    /// Takes the next completion, if any.
+    fn pop(&mut self) -> Option<(u64, i32)> {
+        let off = &self.params.cq_off;
+        // SAFETY: as in `push`; only this thread writes the head.
+        unsafe {
+            let head = &*self.cq.at::<AtomicU32>(off.head);
+            let tail = &*self.cq.at::<AtomicU32>(off.tail);
+            let h = head.load(Ordering::Relaxed);
+            if h == tail.load(Ordering::Acquire) {
+                return None;
+            }
+            let mask = *self.cq.at::<u32>(off.ring_mask);
+            let cqe = self
+                .cq
+                .at::<Cqe>(off.cqes + (h & mask) * size_of::<Cqe>() as u32);
+            let completion = ((*cqe).user_data, (*cqe).res);
+            head.store(h.wrapping_add(1), Ordering::Release);
+            Some(completion)
+        }
+    }
+}
+
+/// Progress of one request slot.
+#[derive(Clone, Copy, Default)]
+struct Slot {
+    offset: u64,
+    len: usize,
+    done: usize,
+    busy: bool,
+}
+
+impl Slot {
+    fn start(offset: u64, len: usize) -> Self {
+        Slot {
+            offset,
+            len,
+            done: 0,
+            busy: true,
+        }
+    }
+
+    /// Returns the request for the bytes of the slot not transferred yet, at `base` in memory.
+    fn sqe(&self, opcode: u8, fd: RawFd, base: *mut u8, index: usize) -> Sqe {
+        Sqe {
+            opcode,
+            fd,
+            off: self.offset + self.done as u64,
+            addr: base.wrapping_add(self.done) as u64,
+            len: (self.len - self.done) as u32,
+            user_data: index as u64,
+            ..Sqe::default()
+        }
+    }
+}
+
+/// Turns a negative completion result into an error, and a zero-length write into
+/// `WriteZero`.
+fn completion_error(res: i32, writing: bool) -> Option<io::Error> {
+    match res {
+        res if res < 0 => Some(io::Error::from_raw_os_error(-res)),
+        0 if writing => Some(io::ErrorKind::WriteZero.into()),
+        _ => None,
+    }
+}
+
+impl Ring {
+    /// Reads the file from offset 0 into `buffer` with several reads in flight. Returns the
+    /// number of bytes read, which is less than the buffer length if the file is shorter.
+    pub(crate) fn read_into(&mut self, file: &File, buffer: &mut [u8]) -> io::Result<usize> {
+        self.transfer(file, IORING_OP_READ, buffer.as_mut_ptr(), buffer.len())
+    }
+
+    /// Writes `content` to the file from offset 0 with several writes in flight.
+    pub(crate) fn write_from(&mut self, file: &File, content: &[u8]) -> io::Result<()> {
+        // Write requests only read from the buffer.
+        let base = content.as_ptr().cast_mut();
+        self.transfer(file, IORING_OP_WRITE, base, content.len())?;
+        Ok(())
+    }
+
+    /// Moves `len` bytes between the file and the memory at `base`, one chunk per slot.
+    fn transfer(
+        &mut self,
+        file: &File,
+        opcode: u8,
+        base: *mut u8,
+        len: usize,
+    ) -> io::Result<usize> {
+        let fd = file.as_raw_fd();
+        let writing = opcode == IORING_OP_WRITE;
+        let mut slots = [Slot::default(); QUEUE_DEPTH];
+        let (mut next, mut end, mut in_flight) = (0, len, 0);
+        let mut error = None;
+
+        loop {
+            for (index, slot) in slots.iter_mut().enumerate() {
+                if error.is_some() || next >= end {
+                    break;
+                }
+                if !slot.busy {
+                    *slot = Slot::start(next as u64, CHUNK_LEN.min(end - next));
+                    next += slot.len;
+                    self.push(slot.sqe(opcode, fd, base.wrapping_add(next - slot.len), index));
+                    in_flight += 1;
+                }
+            }
+            if in_flight == 0 {
+                break;
+            }
+
+            self.submit_and_wait();
+            while let Some((user_data, res)) = self.pop() {
+                let index = user_data as usize;
+                let slot = &mut slots[index];
+                if let Some(e) = completion_error(res, writing) {
+                    error.get_or_insert(e);
+                } else if res == 0 {
+                    // End of file: nothing lies beyond this chunk.
+                    end = end.min(slot.offset as usize + slot.done);
+                    next = next.min(end);
+                } else {
+                    slot.done += res as usize;
+                    if slot.done < slot.len && error.is_none() {
+                        let chunk = base.wrapping_add(slot.offset as usize);
+                        self.push(slot.sqe(opcode, fd, chunk, index));
+                        continue;
+                    }
+                }
+                slot.busy = false;
+                in_flight -= 1;
+            }
+        }
+
+        match error {
+            Some(e) => Err(e),
+            None => Ok(end),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::fs;
+    use testdir::testdir;
+
+    // Sandboxes may forbid io_uring; the tests of `transfer` cover the fallback then.
+
+    #[test]
+    fn read_into_stops_at_end_of_file() -> io::Result<()> {
+        let Ok(mut ring) = Ring::new() else {
+            return Ok(());
+        };
+        let dir = testdir!();
+        let path = dir.join("short");
+        let content: Vec<u8> = (0..2 * CHUNK_LEN + 5).map(|i| i as u8).collect();
+        fs::write(&path, &content)?;
+
+        let mut buffer = vec![0; 5 * CHUNK_LEN];
+        let read = ring.read_into(&File::open(&path)?, &mut buffer)?;
+        assert_eq!(read, content.len());
+        assert_eq!(&buffer[..read], content);
+        Ok(())
+    }
+
+    #[test]
+    fn write_from_reports_write_errors() -> io::Result<()> {
+        let Ok(mut ring) = Ring::new() else {
+            return Ok(());
+        };
+        let dir = testdir!();
+        let path = dir.join("output");
+        fs::write(&path, b"")?;
+
+        // The output is opened read-only, so every write fails.
+        let output = File::open(&path)?;
+        let result = ring.write_from(&output, &vec![1; 3 * CHUNK_LEN]);
+        assert_eq!(result.unwrap_err().raw_os_error(), Some(libc::EBADF));
+        Ok(())
+    }
+}
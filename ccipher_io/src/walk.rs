@@ -0,0 +1,85 @@
+//! Listing the files of a directory tree.
+use std::fs;
+use std::io;
+use std::path::{Path, PathBuf};
+
+/// A regular file found while walking a directory tree.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct FileEntry {
+    /// Path of the file, starting with the root that was walked.
+    pub path: PathBuf,
+    /// Size of the file in bytes when it was listed.
+    pub len: u64,
+}
+
+/// Lists every regular file below `root`, sorted by path.
+///
+/// Symbolic links are not followed, so the walk cannot loop. The size of each file is
+/// taken from its directory entry and lets callers split large files before reading them.
+///
+/// # Errors
+///
+/// Returns the first error encountered while reading a directory or the metadata of one of
+/// its entries.
+pub fn walk_files(root: &Path) -> io::Result<Vec<FileEntry>> {
+    let mut files = Vec::new();
+    let mut directories = vec![root.to_path_buf()];
+    while let Some(directory) = directories.pop() {
+        for entry in fs::read_dir(&directory)? {
+            let entry = entry?;
+            let file_type = entry.file_type()?;
+            if file_type.is_dir() {
+                directories.push(entry.path());
+            } else if file_type.is_file() {
+                files.push(FileEntry {
+                    path: entry.path(),
+                    len: entry.metadata()?.len(),
+                });
+            }
+        }
+    }
+    files.sort_unstable_by(|a, b| a.path.cmp(&b.path));
+    Ok(files)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use testdir::testdir;
+
+    #[test]
+    fn walk_files_lists_nested_files_in_order() -> io::Result<()> {
+        let dir = testdir!();
+        fs::create_dir_all(dir.join("b/c"))?;
+        fs::create_dir_all(dir.join("empty"))?;
+        fs::write(dir.join("b/c/deep.txt"), "deep")?;
+        fs::write(dir.join("b/one.txt"), "1")?;
+        fs::write(dir.join("a.txt"), "")?;
+
+        let files = walk_files(&dir)?;
+        let listed: Vec<(PathBuf, u64)> = files
+            .into_iter()
+            .map(|file| {
+                (
+                    file.path.strip_prefix(&dir).unwrap().to_path_buf(),
+                    file.len,
+                )
+            })
+            .collect();
+        assert_eq!(
+            listed,
+            vec![
+                (PathBuf::from("a.txt"), 0),
+                (PathBuf::from("b/c/deep.txt"), 4),
+                (PathBuf::from("b/one.txt"), 1),
+            ]
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn walk_files_fails_on_missing_root() {
+        let dir = testdir!();
+        assert!(walk_files(&dir.join("missing")).is_err());
+    }
+}
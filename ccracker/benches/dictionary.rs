@@ -0,0 +1,111 @@
+//! Compares dictionary lookups with and without the Bloom filter prefilter.
+//!
+//! Run with `cargo bench -p ccracker --bench dictionary`. Both workloads are miss-heavy, as
+//! the dictionary attack is: under all but one shift almost no token is a word.
+use ccracker::{rank_ascii_dict_attack_bytes, DictScratch, Dictionary, POPULAR_ENGLISH_WORDS};
+use std::hint::black_box;
+use std::time::{Duration, Instant};
+
+/// Runs `f` repeatedly for about half a second and returns the mean time per call.
+fn measure(mut f: impl FnMut()) -> Duration {
+    f();
+    let mut iterations = 0u32;
+    let start = Instant::now();
+    while start.elapsed() < Duration::from_millis(500) {
+        f();
+        iterations += 1;
+    }
+    start.elapsed() / iterations
+}
+
+/// Every sampled dictionary word under every non-zero shift: almost all lookups miss.
+///
+/// The words are returned back to back in one buffer along with their lengths.
+fn shifted_words() -> (Vec<u8>, Vec<usize>) {
+    let mut buffer = Vec::new();
+    let mut lengths = Vec::new();
+    for word in POPULAR_ENGLISH_WORDS.lines().step_by(16) {
+        for shift in 1..128u8 {
+            buffer.extend(word.bytes().map(|byte| byte.wrapping_add(shift) & 0x7f));
+            lengths.push(word.len());
+        }
+    }
+    (buffer, lengths)
+}
+
+/// Builds about `len` bytes of text from dictionary words picked by a fixed-seed generator,
+/// so that tokens rarely repeat and lookups touch the whole table.
+fn random_words(len: usize) -> String {
+    let words: Vec<&str> = POPULAR_ENGLISH_WORDS.lines().collect();
+    let mut state = 0x2545_f491_4f6c_dd1du64;
+    let mut text = String::new();
+    while text.len() < len {
+        state = state
+            .wrapping_mul(6364136223846793005)
+            .wrapping_add(1442695040888963407);
+        text.push_str(words[(state >> 33) as usize % words.len()]);
+        text.push(' ');
+    }
+    text
+}
+
+/// Calls `f` with each word of a buffer returned by [`shifted_words`].
+fn for_each_word(buffer: &[u8], lengths: &[usize], mut f: impl FnMut(&[u8])) {
+    let mut start = 0;
+    for &len in lengths {
+        f(&buffer[start..start + len]);
+        start += len;
+    }
+}
+
+fn main() {
+    let filtered = Dictionary::popular_english();
+    let exact = Dictionary::popular_english().without_prefilter();
+    println!(
+        "{} words, {} byte prefilter",
+        filtered.len(),
+        filtered.prefilter_size_in_bytes()
+    );
+
+    let (buffer, lengths) = shifted_words();
+    let mut hits = 0;
+    for_each_word(&buffer, &lengths, |word| {
+        hits += usize::from(exact.contains(word))
+    });
+    println!(
+        "lookups: {} shifted words, {:.2}% hits",
+        lengths.len(),
+        100.0 * hits as f64 / lengths.len() as f64
+    );
+    for (name, dictionary) in [("exact", &exact), ("prefiltered", &filtered)] {
+        let elapsed = measure(|| {
+            for_each_word(&buffer, &lengths, |word| {
+                black_box(dictionary.contains(black_box(word)));
+            });
+        });
+        println!(
+            "  {name:>12}: {:6.2} ns/lookup",
+            elapsed.as_nanos() as f64 / lengths.len() as f64
+        );
+    }
+
+    let ciphertext = ccipher::CaesarCipher::new(42)
+        .apply_cipher(&random_words(1 << 16))
+        .into_bytes();
+    println!("attack: {} byte ciphertext", ciphertext.len());
+    for (name, dictionary) in [("exact", &exact), ("prefiltered", &filtered)] {
+        let mut scratch = DictScratch::new();
+        let elapsed = measure(|| {
+            black_box(rank_ascii_dict_attack_bytes(
+                black_box(&ciphertext),
+                dictionary,
+                1,
+                &mut scratch,
+            ));
+        });
+        println!(
+            "  {name:>12}: {:6.2} ms/attack",
+            elapsed.as_secs_f64() * 1000.0
+        );
+    }
+}
@@ -0,0 +1,109 @@
+//! Compares the frequency attack's metrics by throughput and by accuracy.
+//!
+//! Run with `cargo bench -p ccracker --bench metrics`. Accuracy is measured on snippets of
+//! the bundled English corpus encrypted under pseudo-random keys; the n-gram attack is
+//! listed alongside for reference.
+use ccracker::{rank_ascii_freq_attack_with_metric, rank_ascii_ngram_attack, Metric};
+use clap::ValueEnum;
+use std::hint::black_box;
+use std::time::{Duration, Instant};
+
+const CORPUS: &str = include_str!("../datasets/english_corpus.txt");
+const LENGTHS: [usize; 7] = [16, 32, 64, 128, 256, 512, 1024];
+const SAMPLES: usize = 200;
+
+/// Runs `f` repeatedly for about half a second and returns the mean time per call.
+fn measure(mut f: impl FnMut()) -> Duration {
+    f();
+    let mut iterations = 0u32;
+    let start = Instant::now();
+    while start.elapsed() < Duration::from_millis(500) {
+        f();
+        iterations += 1;
+    }
+    start.elapsed() / iterations
+}
+
+/// An attack that returns the best shift of a ciphertext.
+type Attack = Box<dyn Fn(&str) -> Option<u8>>;
+
+/// A fixed-seed generator so every run measures the same samples.
+struct Lcg(u64);
+
+impl Lcg {
+    fn next(&mut self) -> usize {
+        self.0 = self
+            .0
+            .wrapping_mul(6364136223846793005)
+            .wrapping_add(1442695040888963407);
+        (self.0 >> 33) as usize
+    }
+}
+
+/// Returns `SAMPLES` pairs of (snippet ciphertext, shift that decrypts it).
+fn samples(len: usize, rng: &mut Lcg) -> Vec<(String, u8)> {
+    (0..SAMPLES)
+        .map(|_| {
+            let start = rng.next() % (CORPUS.len() - len);
+            let key = (rng.next() % 128) as i32;
+            let ciphertext =
+                ccipher::CaesarCipher::new(key).apply_cipher(&CORPUS[start..start + len]);
+            (ciphertext, (-key).rem_euclid(128) as u8)
+        })
+        .collect()
+}
+
+fn main() {
+    let mut rng = Lcg(0x2545_f491_4f6c_dd1d);
+    let samples: Vec<Vec<(String, u8)>> =
+        LENGTHS.iter().map(|&len| samples(len, &mut rng)).collect();
+
+    println!("accuracy over {SAMPLES} corpus snippets per length");
+    print!("{:>12}", "length");
+    for len in LENGTHS {
+        print!("{len:>7}");
+    }
+    println!();
+    let attacks: Vec<(String, Attack)> = Metric::value_variants()
+        .iter()
+        .map(|&metric| {
+            let attack: Attack = Box::new(move |ciphertext: &str| {
+                rank_ascii_freq_attack_with_metric(ciphertext, 1, metric)
+                    .best()
+                    .map(|c| c.shift)
+            });
+            (format!("{metric:?}"), attack)
+        })
+        .chain(std::iter::once((
+            "ngram".to_string(),
+            Box::new(|ciphertext: &str| {
+                rank_ascii_ngram_attack(ciphertext.as_bytes(), 1)
+                    .best()
+                    .map(|c| c.shift)
+            }) as Attack,
+        )))
+        .collect();
+    for (name, attack) in &attacks {
+        print!("{name:>12}");
+        for samples in &samples {
+            let correct = samples
+                .iter()
+                .filter(|(ciphertext, shift)| attack(ciphertext) == Some(*shift))
+                .count();
+            print!("{:>6.1}%", 100.0 * correct as f64 / SAMPLES as f64);
+        }
+        println!();
+    }
+
+    let ciphertext = ccipher::CaesarCipher::new(42).apply_cipher(&CORPUS[..4096]);
+    println!("throughput: {} byte ciphertext", ciphertext.len());
+    for (name, attack) in &attacks {
+        let elapsed = measure(|| {
+            black_box(attack(black_box(&ciphertext)));
+        });
+        println!(
+            "  {name:>12}: {:8.2} us/attack",
+            elapsed.as_secs_f64() * 1e6
+        );
+    }
+}
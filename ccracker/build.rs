@@ -0,0 +1,151 @@
+//! Generates the n-gram log-probability tables used by the n-gram attack.
+//!
+//! The tables are estimated from `datasets/english_corpus.txt` and written to
+//! `$OUT_DIR/ngram_tables.rs` as flat `f32` arrays, so the attack starts without parsing
+//! or allocating anything at run time.
+use std::env;
+use std::fmt::Write as _;
+use std::fs;
+use std::path::Path;
+
+const CORPUS: &str = "datasets/english_corpus.txt";
+
+/// Size of the ASCII alphabet.
+const ALPHABET: usize = 128;
+/// Letters are folded to 26 case-insensitive classes, whitespace to one class and every
+/// other byte to one more.
+const CLASSES: usize = 28;
+const WHITESPACE_CLASS: u8 = 26;
+const OTHER_CLASS: u8 = 27;
+
+/// Pseudo-count of the add-alpha smoothed unigram distributions.
+const UNIGRAM_ALPHA: f64 = 0.5;
+/// Weight of the unigram prior that conditional distributions are interpolated with.
+const PRIOR_WEIGHT: f64 = 2.0;
+
+fn class(byte: u8) -> u8 {
+    match byte {
+        b'a'..=b'z' => byte - b'a',
+        b'A'..=b'Z' => byte - b'A',
+        b'\t'..=b'\r' | b' ' => WHITESPACE_CLASS,
+        _ => OTHER_CLASS,
+    }
+}
+
+/// Returns the add-alpha smoothed distribution of the given counts.
+fn unigram(counts: &[u64]) -> Vec<f64> {
+    let total: u64 = counts.iter().sum();
+    let denominator = total as f64 + UNIGRAM_ALPHA * counts.len() as f64;
+    counts
+        .iter()
+        .map(|&count| (count as f64 + UNIGRAM_ALPHA) / denominator)
+        .collect()
+}
+
+/// Returns `ln P(next | context)`, interpolating the observed counts with the unigram prior.
+/// Contexts that never occur in the corpus fall back to the prior.
+fn conditional(pair_count: u64, context_count: u64, prior: f64) -> f32 {
+    let p = (pair_count as f64 + PRIOR_WEIGHT * prior) / (context_count as f64 + PRIOR_WEIGHT);
+    p.ln() as f32
+}
+
+fn write_array(out: &mut String, name: &str, len: &str, values: impl Iterator<Item = String>) {
+    writeln!(out, "static {name}: [{len}] = [").unwrap();
+    for value in values {
+        writeln!(out, "    {value},").unwrap();
+    }
+    writeln!(out, "];").unwrap();
+}
+
+fn main() {
+    println!("cargo:rerun-if-changed={CORPUS}");
+    println!("cargo:rerun-if-changed=build.rs");
+
+    let corpus = fs::read(CORPUS).expect("failed to read the n-gram corpus");
+    // Only runs of ASCII bytes form n-grams.
+    let runs: Vec<&[u8]> = corpus
+        .split(|byte| !byte.is_ascii())
+        .filter(|run| !run.is_empty())
+        .collect();
+
+    let mut bytes = vec![0u64; ALPHABET];
+    let mut byte_pairs = vec![0u64; ALPHABET * ALPHABET];
+    let mut classes = vec![0u64; CLASSES];
+    let mut class_triples = vec![0u64; CLASSES * CLASSES * CLASSES];
+    for run in &runs {
+        for &byte in run.iter() {
+            bytes[usize::from(byte)] += 1;
+            classes[usize::from(class(byte))] += 1;
+        }
+        for pair in run.windows(2) {
+            byte_pairs[usize::from(pair[0]) * ALPHABET + usize::from(pair[1])] += 1;
+        }
+        let run_classes: Vec<usize> = run.iter().map(|&byte| usize::from(class(byte))).collect();
+        for triple in run_classes.windows(3) {
+            class_triples[(triple[0] * CLASSES + triple[1]) * CLASSES + triple[2]] += 1;
+        }
+    }
+
+    // How often each byte, or pair of classes, is followed by another within a run.
+    let mut byte_contexts = vec![0u64; ALPHABET];
+    for (index, &count) in byte_pairs.iter().enumerate() {
+        byte_contexts[index / ALPHABET] += count;
+    }
+    let mut class_contexts = vec![0u64; CLASSES * CLASSES];
+    for (index, &count) in class_triples.iter().enumerate() {
+        class_contexts[index / CLASSES] += count;
+    }
+    let byte_prior = unigram(&bytes);
+    let class_prior = unigram(&classes);
+
+    // Bigrams are laid out by diagonal: row `d` holds ln P(x + d | x) for x = 0, 1, ...,
+    // 127, twice in a row. A pair (a, a + d) maps to (a + s, a + s + d) under shift s, so the
+    // scores of one pair under all 128 shifts are the contiguous window row[a..a + 128].
+    let diagonals = (0..ALPHABET).flat_map(|d| {
+        let byte_pairs = &byte_pairs;
+        let byte_contexts = &byte_contexts;
+        let byte_prior = &byte_prior;
+        (0..2 * ALPHABET).map(move |x| {
+            let (first, second) = (x % ALPHABET, (x + d) % ALPHABET);
+            let p = conditional(
+                byte_pairs[first * ALPHABET + second],
+                byte_contexts[first],
+                byte_prior[second],
+            );
+            format!("{p:?}")
+        })
+    });
+    let trigrams = (0..CLASSES * CLASSES * CLASSES).map(|index| {
+        let p = conditional(
+            class_triples[index],
+            class_contexts[index / CLASSES],
+            class_prior[index % CLASSES],
+        );
+        format!("{p:?}")
+    });
+
+    let mut out = String::new();
+    writeln!(out, "// Generated by build.rs from {CORPUS}. Do not edit.").unwrap();
+    writeln!(out, "const CLASSES: usize = {CLASSES};").unwrap();
+    write_array(
+        &mut out,
+        "CLASS",
+        "u8; 2 * ASCII_LEN",
+        (0..2 * ALPHABET).map(|byte| class((byte % ALPHABET) as u8).to_string()),
+    );
+    write_array(
+        &mut out,
+        "BIGRAM_DIAGONALS",
+        "f32; ASCII_LEN * 2 * ASCII_LEN",
+        diagonals,
+    );
+    write_array(
+        &mut out,
+        "TRIGRAMS",
+        "f32; CLASSES * CLASSES * CLASSES",
+        trigrams,
+    );
+
+    let path = Path::new(&env::var("OUT_DIR").unwrap()).join("ngram_tables.rs");
+    fs::write(path, out).expect("failed to write the n-gram tables");
+}
@@ -0,0 +1,403 @@
+//! Cracking the affine cipher `a·x + b mod 128` by frequency analysis over all 8192 keys.
+//!
+//! Decrypting with a key moves the count of every ciphertext byte `y` to the plaintext byte
+//! `a·y + b`, so the plaintext histogram of every key is a permutation of the ciphertext
+//! histogram, which is counted once. For each multiplier `a` the histogram is permuted
+//! into the order of `a·y`, after which the 128 shifts `b` are scored exactly like the
+//! shifts of a Caesar cipher.
+//!
+//! With the L1 metric keys are also pruned: the terms of a key's distance are summed in
+//! order of decreasing ciphertext counts, and the key is abandoned as soon as its partial
+//! distance exceeds the best distances found so far. The 64 multipliers are searched in
+//! parallel on a [`WorkStealingPool`], so the whole key space costs little more than the
+//! 128 shifts of the frequency attack.
+use crate::lanes::LANES;
+use crate::ranking::confidence_margin;
+use crate::{ascii_histogram, histogram_freq_scores, metrics, Format, Metric, ScoreOrder};
+use ccipher_io::WorkStealingPool;
+use std::cmp::Ordering;
+use std::io::{self, Write};
+use std::sync::atomic::{AtomicU64, Ordering as AtomicOrdering};
+
+/// Number of affine keys: 64 odd multipliers times 128 shifts.
+pub const AFFINE_KEYS: usize = 64 * LANES;
+
+/// A candidate affine key along with its frequency analysis score.
+///
+/// The key decrypts: the plaintext of a ciphertext byte `y` is `multiplier·y + shift mod
+/// 128`, as applied by [`ccipher::AffineCipher`].
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct AffineCandidate {
+    /// The odd multiplier of the decryption key.
+    pub multiplier: u8,
+    /// The shift of the decryption key.
+    pub shift: u8,
+    /// The raw metric value of the key's plaintext distribution.
+    pub score: f64,
+}
+
+/// The top candidate affine keys, ordered from most to least likely.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct AffineRanking {
+    /// At most `k` candidates, best first. Ties are broken in favor of the smaller
+    /// multiplier, then the smaller shift.
+    pub candidates: Vec<AffineCandidate>,
+    /// Normalized margin between the best and the runner-up score in the range `[0, 1]`,
+    /// as in [`crate::Ranking`].
+    pub confidence: f64,
+}
+
+impl AffineRanking {
+    /// Returns the most likely candidate, if any.
+    pub fn best(&self) -> Option<&AffineCandidate> {
+        self.candidates.first()
+    }
+
+    /// Writes the ranking to `out` in the requested format, like [`crate::Ranking::write`]
+    /// with the multiplier of each key added.
+    ///
+    /// # Errors
+    ///
+    /// Returns any error produced by the underlying writer.
+    pub fn write(&self, out: &mut impl Write, format: Format) -> io::Result<()> {
+        match format {
+            Format::Text => {
+                match self.candidates.as_slice() {
+                    [] => writeln!(out, "unable to find candidate key")?,
+                    [only] => writeln!(
+                        out,
+                        "candidate key: {} (multiplier: {})",
+                        only.shift, only.multiplier
+                    )?,
+                    candidates => {
+                        for candidate in candidates {
+                            writeln!(
+                                out,
+                                "candidate key: {} (multiplier: {}, score: {})",
+                                candidate.shift, candidate.multiplier, candidate.score
+                            )?;
+                        }
+                        writeln!(out, "confidence: {:.3}", self.confidence)?;
+                    }
+                }
+                Ok(())
+            }
+            Format::Json => {
+                write!(out, "{{\"confidence\":{},\"candidates\":[", self.confidence)?;
+                for (i, candidate) in self.candidates.iter().enumerate() {
+                    if i > 0 {
+                        write!(out, ",")?;
+                    }
+                    write!(
+                        out,
+                        "{{\"multiplier\":{},\"key\":{},\"score\":{}}}",
+                        candidate.multiplier, candidate.shift, candidate.score
+                    )?;
+                }
+                writeln!(out, "]}}")
+            }
+            Format::Tsv => {
+                writeln!(out, "rank\tmultiplier\tkey\tscore\tconfidence")?;
+                for (i, candidate) in self.candidates.iter().enumerate() {
+                    writeln!(
+                        out,
+                        "{}\t{}\t{}\t{}\t{}",
+                        i + 1,
+                        candidate.multiplier,
+                        candidate.shift,
+                        candidate.score,
+                        self.confidence
+                    )?;
+                }
+                Ok(())
+            }
+        }
+    }
+}
+
+/// Ranks the `k` affine keys whose plaintext character distribution is closest to English
+/// according to `metric`, searching the multipliers in parallel on `pool`.
+///
+/// Only ASCII bytes take part in the analysis. An input without ASCII bytes has no
+/// candidates.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::AffineCipher;
+/// use ccipher_io::WorkStealingPool;
+/// use ccracker::{rank_ascii_affine_attack, Metric};
+///
+/// let plaintext = "The frequency attack needs a few sentences of ordinary English text \
+///                  before the distribution of its characters becomes reliable enough.";
+/// let cipher = AffineCipher::new(5, 8);
+/// let ciphertext = cipher.apply_cipher(plaintext);
+/// let pool = WorkStealingPool::new(4);
+/// let ranking = rank_ascii_affine_attack(ciphertext.as_bytes(), 1, Metric::L1, &pool);
+///
+/// let best = ranking.best().unwrap();
+/// assert_eq!(AffineCipher::new(best.multiplier.into(), best.shift.into()), cipher.inverse());
+/// ```
+pub fn rank_ascii_affine_attack(
+    ciphertext: &[u8],
+    k: usize,
+    metric: Metric,
+    pool: &WorkStealingPool,
+) -> AffineRanking {
+    let counts = ascii_histogram(ciphertext);
+    if counts.iter().all(|&count| count == 0) {
+        return AffineRanking::default();
+    }
+
+    let capacity = k.max(2);
+    let order = metric.order();
+    let mut by_count: Vec<u8> = (0..LANES as u8).collect();
+    by_count.sort_by_key(|&byte| std::cmp::Reverse(counts[usize::from(byte)]));
+    // The worst score kept by any finished multiplier. Every key scoring worse is beaten by
+    // at least `capacity` keys and can be abandoned.
+    let bound = AtomicU64::new(f64::INFINITY.to_bits());
+
+    let multipliers: Vec<u8> = (1..LANES as u8).step_by(2).collect();
+    let tops = pool.map(
+        multipliers,
+        || (),
+        |_, multiplier| {
+            let mut top = Top::new(capacity, order);
+            if metric == Metric::L1 {
+                score_l1_pruned(&counts, &by_count, multiplier, &mut top, &bound);
+            } else {
+                let scores = histogram_freq_scores(&permute(&counts, multiplier), metric);
+                for (shift, &score) in scores.iter().enumerate() {
+                    top.push(AffineCandidate {
+                        multiplier,
+                        shift: shift as u8,
+                        score,
+                    });
+                }
+            }
+            top.candidates
+        },
+    );
+
+    let mut best: Vec<AffineCandidate> = tops.into_iter().flatten().collect();
+    best.sort_by(|a, b| compare(order, a, b));
+    best.truncate(capacity);
+    let confidence = match best.as_slice() {
+        [] => 0.0,
+        [_] => 1.0,
+        [first, second, ..] => confidence_margin(first.score, second.score),
+    };
+    best.truncate(k);
+    AffineRanking {
+        candidates: best,
+        confidence,
+    }
+}
+
+/// Returns the histogram of the plaintext bytes `multiplier·y`, before any shift.
+fn permute(counts: &[u64; LANES], multiplier: u8) -> [u64; LANES] {
+    let mut permuted = [0; LANES];
+    for (byte, &count) in counts.iter().enumerate() {
+        permuted[usize::from(multiplier.wrapping_mul(byte as u8) & 0x7f)] = count;
+    }
+    permuted
+}
+
+/// Scores the 128 shifts of `multiplier` with the integer L1 distance of
+/// [`metrics::l1_distances`], abandoning every key whose partial distance exceeds the best
+/// keys found so far.
+fn score_l1_pruned(
+    counts: &[u64; LANES],
+    by_count: &[u8],
+    multiplier: u8,
+    top: &mut Top,
+    bound: &AtomicU64,
+) {
+    let (weights, weight_total) = metrics::l1_weights();
+    let counts = metrics::l1_counts(counts);
+    let total: u64 = counts.iter().sum();
+    let scale = (total * weight_total) as f64;
+
+    for shift in 0..LANES as u8 {
+        let global = f64::from_bits(bound.load(AtomicOrdering::Relaxed));
+        let limit = top.worst().map_or(global, |worst| worst.min(global));
+        let mut distance = 0u64;
+        // Partial sums only grow, so a key is abandoned once its partial distance is worse.
+        let complete = by_count.iter().all(|&byte| {
+            let plain = multiplier.wrapping_mul(byte).wrapping_add(shift) & 0x7f;
+            let observed = counts[usize::from(byte)] * weight_total;
+            let expected = u64::from(weights[usize::from(plain)]) * total;
+            distance += observed.abs_diff(expected);
+            distance as f64 / scale <= limit
+        });
+        if complete {
+            top.push(AffineCandidate {
+                multiplier,
+                shift,
+                score: distance as f64 / scale,
+            });
+        }
+    }
+
+    // Distances are non-negative, so their bit patterns order like their values.
+    if let Some(worst) = top.worst() {
+        bound.fetch_min(worst.to_bits(), AtomicOrdering::Relaxed);
+    }
+}
+
+/// Orders candidates best first, breaking ties by multiplier and then by shift.
+fn compare(order: ScoreOrder, a: &AffineCandidate, b: &AffineCandidate) -> Ordering {
+    let by_score = match order {
+        ScoreOrder::LowerIsBetter => a.score.total_cmp(&b.score),
+        ScoreOrder::HigherIsBetter => b.score.total_cmp(&a.score),
+    };
+    by_score
+        .then(a.multiplier.cmp(&b.multiplier))
+        .then(a.shift.cmp(&b.shift))
+}
+
+/// The best `capacity` candidates of one multiplier, best first.
+struct Top {
+    capacity: usize,
+    order: ScoreOrder,
+    candidates: Vec<AffineCandidate>,
+}
+
+impl Top {
+    fn new(capacity: usize, order: ScoreOrder) -> Self {
+        Top {
+            capacity,
+            order,
+            candidates: Vec::with_capacity(capacity + 1),
+        }
+    }
+
+    /// Returns the score a candidate must beat to be kept once the list is full.
+    fn worst(&self) -> Option<f64> {
+        (self.candidates.len() == self.capacity).then(|| self.candidates[self.capacity - 1].score)
+    }
+
+    fn push(&mut self, candidate: AffineCandidate) {
+        let position = self
+            .candidates
+            .partition_point(|kept| compare(self.order, kept, &candidate) == Ordering::Less);
+        if position < self.capacity {
+            self.candidates.insert(position, candidate);
+            self.candidates.truncate(self.capacity);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ccipher::AffineCipher;
+
+    const PLAINTEXT: &str = "It was the best of times, it was the worst of times, it was the \
+        age of wisdom, it was the age of foolishness, it was the epoch of belief, it was the \
+        epoch of incredulity, it was the season of Light, it was the season of Darkness.";
+
+    /// Scores every key without pruning.
+    fn exhaustive(ciphertext: &[u8], metric: Metric) -> Vec<AffineCandidate> {
+        let counts = ascii_histogram(ciphertext);
+        let mut all = Vec::with_capacity(AFFINE_KEYS);
+        for multiplier in (1..LANES as u8).step_by(2) {
+            let scores = histogram_freq_scores(&permute(&counts, multiplier), metric);
+            for (shift, &score) in scores.iter().enumerate() {
+                all.push(AffineCandidate {
+                    multiplier,
+                    shift: shift as u8,
+                    score,
+                });
+            }
+        }
+        all.sort_by(|a, b| compare(metric.order(), a, b));
+        all
+    }
+
+    #[test]
+    fn affine_attack_recovers_the_inverse_key() {
+        let pool = WorkStealingPool::new(3);
+        for (multiplier, shift) in [(1, 0), (3, 100), (77, 5), (127, 127)] {
+            let cipher = AffineCipher::new(multiplier, shift);
+            let ciphertext = cipher.apply_cipher(PLAINTEXT);
+            for metric in [Metric::L1, Metric::ChiSquared, Metric::Cosine] {
+                let ranking = rank_ascii_affine_attack(ciphertext.as_bytes(), 1, metric, &pool);
+                let best = ranking.best().unwrap();
+                assert_eq!(
+                    AffineCipher::new(best.multiplier.into(), best.shift.into()),
+                    cipher.inverse(),
+                    "key ({multiplier}, {shift}) with {metric:?}"
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn pruning_keeps_the_exhaustive_top_keys() {
+        let ciphertext = AffineCipher::new(9, 40).apply_cipher(PLAINTEXT);
+        let expected = exhaustive(ciphertext.as_bytes(), Metric::L1);
+        for threads in [1, 4] {
+            let pool = WorkStealingPool::new(threads);
+            let ranking = rank_ascii_affine_attack(ciphertext.as_bytes(), 10, Metric::L1, &pool);
+            assert_eq!(ranking.candidates, expected[..10]);
+        }
+    }
+
+    #[test]
+    fn multiplier_one_scores_match_the_frequency_attack() {
+        let ciphertext = ccipher::CaesarCipher::new(42).apply_cipher(PLAINTEXT);
+        let caesar = crate::rank_ascii_freq_attack(&ciphertext, 1);
+        let affine = exhaustive(ciphertext.as_bytes(), Metric::L1);
+        let one = affine.iter().find(|c| c.multiplier == 1).unwrap();
+        assert_eq!(one.shift, caesar.best().unwrap().shift);
+        assert_eq!(one.score, caesar.best().unwrap().score);
+    }
+
+    #[test]
+    fn affine_attack_without_ascii_has_no_candidates() {
+        let pool = WorkStealingPool::new(2);
+        let ranking = rank_ascii_affine_attack(&[0xff, 0x80], 3, Metric::L1, &pool);
+        assert_eq!(ranking, AffineRanking::default());
+    }
+
+    #[test]
+    fn write_reports_multiplier_and_key() {
+        let ranking = AffineRanking {
+            candidates: vec![
+                AffineCandidate {
+                    multiplier: 13,
+                    shift: 8,
+                    score: 0.25,
+                },
+                AffineCandidate {
+                    multiplier: 1,
+                    shift: 3,
+                    score: 0.5,
+                },
+            ],
+            confidence: 0.5,
+        };
+        let render = |format| {
+            let mut out = Vec::new();
+            ranking.write(&mut out, format).unwrap();
+            String::from_utf8(out).unwrap()
+        };
+
+        assert_eq!(
+            render(Format::Text),
+            "candidate key: 8 (multiplier: 13, score: 0.25)\n\
+             candidate key: 3 (multiplier: 1, score: 0.5)\n\
+             confidence: 0.500\n"
+        );
+        assert_eq!(
+            render(Format::Json),
+            "{\"confidence\":0.5,\"candidates\":[{\"multiplier\":13,\"key\":8,\"score\":0.25},\
+             {\"multiplier\":1,\"key\":3,\"score\":0.5}]}\n"
+        );
+        assert_eq!(
+            render(Format::Tsv),
+            "rank\tmultiplier\tkey\tscore\tconfidence\n1\t13\t8\t0.25\t0.5\n2\t1\t3\t0.5\t0.5\n"
+        );
+    }
+}
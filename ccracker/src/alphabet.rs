@@ -0,0 +1,290 @@
+//! Cracking Caesar ciphers over any [`Alphabet`], such as the 26 letters of the classic
+//! cipher.
+//!
+//! The `rank_ascii_*` attacks are specialized for the 128 keys of [`ccipher::Ascii128`].
+//! The attacks here are generic over the alphabet, are compiled separately for each one, and
+//! only try its `A::LEN` keys: 26 for [`ccipher::Latin26`]. The frequency attack rotates a
+//! histogram of alphabet positions, like the ASCII frequency attack rotates the byte
+//! histogram. The other attacks decrypt the ciphertext under every key into one reused
+//! buffer and score the plaintext, which for a small alphabet is cheaper than scanning all
+//! 128 shifts at once.
+use crate::{dictionary, is_word_separator, metrics, ngram};
+use crate::{DictScratch, Dictionary, Metric, Ranking, ScoreOrder};
+use ccipher::{Alphabet, ShiftCipher};
+use memchr::memmem;
+
+/// Size of the per-key tables, enough for any alphabet.
+const MAX_KEYS: usize = 256;
+
+/// Ranks the `k` keys of alphabet `A` whose plaintext distribution of alphabet positions is
+/// closest to English text according to `metric`.
+///
+/// The reference distribution is the English character distribution summed over the bytes
+/// that share a position, so for [`ccipher::Latin26`] upper and lower case letters count as
+/// one. The ranking is empty when the ciphertext holds no byte of the alphabet.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{Latin26, ShiftCipher};
+/// use ccracker::{rank_alphabet_freq_attack, Metric};
+///
+/// let plaintext = "The frequency attack needs a few sentences of ordinary English text \
+///                  before the distribution of its characters becomes reliable enough.";
+/// let ciphertext = ShiftCipher::new(5, Latin26).apply_cipher(plaintext);
+/// let ranking = rank_alphabet_freq_attack::<Latin26>(ciphertext.as_bytes(), 1, Metric::L1);
+///
+/// assert_eq!(ranking.best().map(|c| c.shift), Some(21));
+/// ```
+pub fn rank_alphabet_freq_attack<A: Alphabet>(
+    ciphertext: &[u8],
+    k: usize,
+    metric: Metric,
+) -> Ranking {
+    let mut counts = [0u32; MAX_KEYS];
+    for index in ciphertext.iter().filter_map(|&byte| A::index(byte)) {
+        counts[usize::from(index)] += 1;
+    }
+    rank_alphabet_histogram::<A>(&counts, k, metric)
+}
+
+/// Ranks the keys of alphabet `A` from a histogram of the alphabet positions of a
+/// ciphertext, as [`rank_alphabet_freq_attack`] does. Histograms of separate pieces of a
+/// ciphertext can be summed and ranked once.
+pub(crate) fn rank_alphabet_histogram<A: Alphabet>(
+    counts: &[u32],
+    k: usize,
+    metric: Metric,
+) -> Ranking {
+    let len = usize::from(A::LEN);
+    let total: u32 = counts[..len].iter().sum();
+    if total == 0 {
+        return Ranking::default();
+    }
+
+    let reference = reference::<A>();
+    let mut scores = [0.0; MAX_KEYS];
+    let mut distribution = [0.0; MAX_KEYS];
+    for (shift, score) in scores[..len].iter_mut().enumerate() {
+        // Decrypting with `shift` moves the count of position `i` to position `i + shift`.
+        for (index, &count) in counts[..len].iter().enumerate() {
+            distribution[(index + shift) % len] = count as f32 / total as f32;
+        }
+        *score = f64::from(metric.score(&reference[..len], &distribution[..len]));
+    }
+    Ranking::from_scores(&scores[..len], k, metric.order(), |_| true)
+}
+
+/// Ranks the `k` keys of alphabet `A` that produce the most dictionary words.
+///
+/// Every key is decrypted into the buffers of `scratch`; afterwards
+/// [`DictScratch::best_plaintext`] holds the decryption under the best candidate. Keys that
+/// produce no dictionary words are not considered candidates.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::Latin26;
+/// use ccracker::{rank_alphabet_dict_attack, DictScratch, Dictionary};
+///
+/// let dictionary = Dictionary::from_words(["hello", "world"]);
+/// let mut scratch = DictScratch::new();
+/// let ranking =
+///     rank_alphabet_dict_attack::<Latin26>(b"khoor zruog", &dictionary, 1, &mut scratch);
+///
+/// assert_eq!(ranking.best().map(|c| c.shift), Some(23));
+/// assert_eq!(scratch.best_plaintext(), b"hello world");
+/// ```
+pub fn rank_alphabet_dict_attack<A: Alphabet>(
+    ciphertext: &[u8],
+    dictionary: &Dictionary,
+    k: usize,
+    scratch: &mut DictScratch,
+) -> Ranking {
+    // The padding lets the dictionary pack every token with a single 16-byte load.
+    let len = ciphertext.len();
+    scratch.len = len;
+    scratch.plaintext.resize(len + dictionary::PACKED_LEN, 0);
+    scratch
+        .best_plaintext
+        .resize(len + dictionary::PACKED_LEN, 0);
+
+    let mut scores = [0.0; MAX_KEYS];
+    let mut best_count = 0;
+    for shift in 0..A::LEN {
+        let cipher = ShiftCipher::new(i32::from(shift), A::default());
+        cipher.apply_cipher_bytes(ciphertext, &mut scratch.plaintext[..len]);
+        let count = dictionary.count_words_padded(&scratch.plaintext, len, is_word_separator);
+        scores[usize::from(shift)] = f64::from(count);
+        // Among equal counts, the smallest shift wins.
+        if count > best_count {
+            best_count = count;
+            std::mem::swap(&mut scratch.plaintext, &mut scratch.best_plaintext);
+        }
+    }
+
+    let scores = &scores[..usize::from(A::LEN)];
+    Ranking::from_scores(scores, k, ScoreOrder::HigherIsBetter, |count| count > 0.0)
+}
+
+/// Ranks the `k` keys of alphabet `A` whose plaintext is most likely English according to
+/// bigram and trigram statistics, as [`crate::rank_ascii_ngram_attack`] does.
+///
+/// The ranking is empty when the ciphertext holds fewer than two consecutive ASCII bytes.
+pub fn rank_alphabet_ngram_attack<A: Alphabet>(ciphertext: &[u8], k: usize) -> Ranking {
+    let scores = plaintext_scores::<A>(ciphertext, |plaintext| {
+        ngram::ngram_score(plaintext, 0).map(|(score, _)| f64::from(score))
+    });
+    match scores {
+        Some(scores) => Ranking::from_scores(
+            &scores[..usize::from(A::LEN)],
+            k,
+            ScoreOrder::HigherIsBetter,
+            |_| true,
+        ),
+        None => Ranking::default(),
+    }
+}
+
+/// Ranks the `k` keys of alphabet `A` under which the ciphertext contains `crib` most often.
+///
+/// Candidate scores are counts of non-overlapping occurrences, and only keys with at least
+/// one occurrence are ranked. The ranking is empty when the crib holds no byte of the
+/// alphabet, since such a crib reads the same under every key.
+pub fn rank_alphabet_crib_attack<A: Alphabet>(ciphertext: &[u8], crib: &[u8], k: usize) -> Ranking {
+    if !crib.iter().any(|&byte| A::index(byte).is_some()) {
+        return Ranking::default();
+    }
+    let finder = memmem::Finder::new(crib);
+    let scores = plaintext_scores::<A>(ciphertext, |plaintext| {
+        Some(finder.find_iter(plaintext).count() as f64)
+    });
+    match scores {
+        Some(scores) => Ranking::from_scores(
+            &scores[..usize::from(A::LEN)],
+            k,
+            ScoreOrder::HigherIsBetter,
+            |count| count > 0.0,
+        ),
+        None => Ranking::default(),
+    }
+}
+
+/// Decrypts the ciphertext under every key of `A` into one buffer and scores the plaintext.
+///
+/// The returned table is indexed by key. Returns `None` when `score` does, which it should
+/// only do for reasons that do not depend on the key.
+fn plaintext_scores<A: Alphabet>(
+    ciphertext: &[u8],
+    mut score: impl FnMut(&[u8]) -> Option<f64>,
+) -> Option<[f64; MAX_KEYS]> {
+    let mut plaintext = vec![0; ciphertext.len()];
+    let mut scores = [0.0; MAX_KEYS];
+    for shift in 0..A::LEN {
+        let cipher = ShiftCipher::new(i32::from(shift), A::default());
+        cipher.apply_cipher_bytes(ciphertext, &mut plaintext);
+        scores[usize::from(shift)] = score(&plaintext)?;
+    }
+    Some(scores)
+}
+
+/// Returns the English distribution of the positions of alphabet `A`.
+fn reference<A: Alphabet>() -> [f32; MAX_KEYS] {
+    let mut reference = [0.0; MAX_KEYS];
+    for (byte, &p) in metrics::probabilities().iter().enumerate() {
+        if let Some(index) = A::index(byte as u8) {
+            reference[usize::from(index)] += p;
+        }
+    }
+    let total: f32 = reference.iter().sum();
+    reference.map(|p| p / total)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ccipher::{Ascii128, Latin26};
+
+    const PLAINTEXT: &str = "It was the best of times, it was the worst of times, it was the \
+        age of wisdom, it was the age of foolishness, it was the epoch of belief, it was the \
+        epoch of incredulity, it was the season of Light, it was the season of Darkness.";
+
+    fn encrypt(shift: i32) -> Vec<u8> {
+        ShiftCipher::new(shift, Latin26)
+            .apply_cipher(PLAINTEXT)
+            .into_bytes()
+    }
+
+    #[test]
+    fn latin26_attacks_rank_only_26_keys() {
+        let dictionary = Dictionary::popular_english();
+        for shift in [1, 13, 25] {
+            let ciphertext = encrypt(shift);
+            let expected = Some((26 - shift) as u8);
+            for metric in [Metric::L1, Metric::ChiSquared, Metric::Kl, Metric::Cosine] {
+                let ranking = rank_alphabet_freq_attack::<Latin26>(&ciphertext, 30, metric);
+                assert_eq!(ranking.candidates.len(), 26);
+                assert_eq!(ranking.best().map(|c| c.shift), expected, "{metric:?}");
+            }
+
+            let mut scratch = DictScratch::new();
+            let ranking =
+                rank_alphabet_dict_attack::<Latin26>(&ciphertext, &dictionary, 1, &mut scratch);
+            assert_eq!(ranking.best().map(|c| c.shift), expected);
+            assert_eq!(scratch.best_plaintext(), PLAINTEXT.as_bytes());
+
+            let ranking = rank_alphabet_ngram_attack::<Latin26>(&ciphertext, 30);
+            assert_eq!(ranking.candidates.len(), 26);
+            assert_eq!(ranking.best().map(|c| c.shift), expected);
+
+            let ranking = rank_alphabet_crib_attack::<Latin26>(&ciphertext, b"Darkness", 3);
+            assert_eq!(
+                ranking.best().map(|c| (c.shift, c.score)),
+                expected.map(|s| (s, 1.0))
+            );
+            assert_eq!(ranking.candidates.len(), 1);
+        }
+    }
+
+    #[test]
+    fn ascii128_attacks_agree_with_the_specialized_attacks() {
+        let ciphertext = ccipher::CaesarCipher::new(77).apply_cipher(PLAINTEXT);
+        let ciphertext = ciphertext.as_bytes();
+
+        let shifts =
+            |ranking: Ranking| -> Vec<u8> { ranking.candidates.iter().map(|c| c.shift).collect() };
+        assert_eq!(
+            shifts(rank_alphabet_ngram_attack::<Ascii128>(ciphertext, 3)),
+            shifts(crate::rank_ascii_ngram_attack(ciphertext, 3))
+        );
+        assert_eq!(
+            shifts(rank_alphabet_freq_attack::<Ascii128>(
+                ciphertext,
+                3,
+                Metric::ChiSquared
+            )),
+            shifts(crate::rank_ascii_freq_attack_bytes(
+                ciphertext,
+                3,
+                Metric::ChiSquared
+            ))
+        );
+    }
+
+    #[test]
+    fn inputs_without_alphabet_bytes_have_no_candidates() {
+        let ciphertext = b"123 456 !?";
+        assert_eq!(
+            rank_alphabet_freq_attack::<Latin26>(ciphertext, 3, Metric::L1),
+            Ranking::default()
+        );
+        assert_eq!(
+            rank_alphabet_crib_attack::<Latin26>(ciphertext, b"123", 3),
+            Ranking::default()
+        );
+        assert_eq!(
+            rank_alphabet_ngram_attack::<Latin26>(b"x", 3),
+            Ranking::default()
+        );
+    }
+}
@@ -0,0 +1,144 @@
+//! Known-plaintext ("crib") key recovery.
+//!
+//! A Caesar shift adds the same value to every ASCII byte, so the differences between
+//! consecutive bytes survive encryption unchanged. The ciphertext is mapped to its sequence
+//! of byte differences once, and the difference pattern of the crib is searched for in it
+//! with a vectorized substring search. Every occurrence pins down a single shift, derived
+//! from the first ASCII byte of the crib, and is verified byte by byte before it counts.
+use crate::ASCII_ALPHABET_LEN;
+use memchr::memmem;
+
+/// Difference of a pair of bytes that are not both ASCII. It lies outside the range of
+/// ASCII differences, so such pairs only ever match each other and are verified literally.
+const NON_ASCII_PAIR: u8 = 0x80;
+
+/// Maps each pair of consecutive bytes of `bytes` to the difference of the pair modulo 128,
+/// which does not depend on the shift the bytes were encrypted with.
+///
+/// The loop is branch-free and compiles to vector instructions.
+fn differences(bytes: &[u8], out: &mut Vec<u8>) {
+    out.clear();
+    out.extend(bytes.windows(2).map(|pair| {
+        let non_ascii = (pair[0] | pair[1]) & NON_ASCII_PAIR;
+        if non_ascii == 0 {
+            pair[1].wrapping_sub(pair[0]) & 0x7f
+        } else {
+            NON_ASCII_PAIR
+        }
+    }));
+}
+
+/// Returns the shift that decrypts `window` to `crib`, if there is one.
+///
+/// `first` is the index of the first ASCII byte of the crib. Non-ASCII crib bytes must
+/// appear unchanged in the ciphertext, since the cipher passes them through.
+fn verify(window: &[u8], crib: &[u8], first: usize) -> Option<u8> {
+    if !window[first].is_ascii() {
+        return None;
+    }
+    let shift = crib[first].wrapping_sub(window[first]) & 0x7f;
+    let matches = window.iter().zip(crib).all(|(&c, &p)| {
+        if p.is_ascii() {
+            c.is_ascii() && c.wrapping_add(shift) & 0x7f == p
+        } else {
+            c == p
+        }
+    });
+    matches.then_some(shift)
+}
+
+/// Counts, for every shift, how many occurrences of `crib` the ciphertext decrypts to under
+/// that shift.
+///
+/// Returns `None` when the crib holds no ASCII byte, since such a crib reads the same under
+/// every shift.
+pub(crate) fn crib_scores(
+    ciphertext: &[u8],
+    crib: &[u8],
+) -> Option<[u32; ASCII_ALPHABET_LEN as usize]> {
+    let first = crib.iter().position(u8::is_ascii)?;
+    let mut scores = [0u32; ASCII_ALPHABET_LEN as usize];
+    if crib.len() > ciphertext.len() {
+        return Some(scores);
+    }
+
+    if crib.len() == 1 {
+        // A single byte has no differences: every ASCII byte is an occurrence.
+        for &byte in ciphertext.iter().filter(|byte| byte.is_ascii()) {
+            scores[usize::from(crib[0].wrapping_sub(byte) & 0x7f)] += 1;
+        }
+        return Some(scores);
+    }
+
+    let mut pattern = Vec::with_capacity(crib.len() - 1);
+    differences(crib, &mut pattern);
+    let mut haystack = Vec::with_capacity(ciphertext.len() - 1);
+    differences(ciphertext, &mut haystack);
+
+    for start in memmem::find_iter(&haystack, &pattern) {
+        let window = &ciphertext[start..start + crib.len()];
+        if let Some(shift) = verify(window, crib, first) {
+            scores[usize::from(shift)] += 1;
+        }
+    }
+    Some(scores)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn encrypt(text: &str, key: i32) -> Vec<u8> {
+        ccipher::CaesarCipher::new(key)
+            .apply_cipher(text)
+            .into_bytes()
+    }
+
+    #[test]
+    fn crib_scores_counts_occurrences_under_their_shift() {
+        let ciphertext = encrypt("GET / HTTP/1.1\r\nHost: a\r\n\r\nHTTP/1.1 200 OK", 77);
+        let scores = crib_scores(&ciphertext, b"HTTP/1.1").unwrap();
+
+        assert_eq!(scores[128 - 77], 2);
+        assert_eq!(scores.iter().sum::<u32>(), 2);
+    }
+
+    #[test]
+    fn crib_scores_verifies_non_ascii_bytes_literally() {
+        let ciphertext = encrypt("caf\u{e9} and caf\u{e8}", 5);
+        let scores = crib_scores(&ciphertext, "caf\u{e9}".as_bytes()).unwrap();
+
+        assert_eq!(scores[128 - 5], 1);
+        assert_eq!(scores.iter().sum::<u32>(), 1);
+    }
+
+    #[test]
+    fn crib_scores_handles_single_byte_and_oversized_cribs() {
+        let ciphertext = encrypt("aab", 3);
+
+        let scores = crib_scores(&ciphertext, b"a").unwrap();
+        assert_eq!(scores[128 - 3], 2);
+        assert_eq!(scores[127 - 3], 1);
+
+        let scores = crib_scores(&ciphertext, b"aabb").unwrap();
+        assert!(scores.iter().all(|&score| score == 0));
+    }
+
+    #[test]
+    fn crib_scores_rejects_cribs_without_ascii_bytes() {
+        assert_eq!(crib_scores(b"abc", "\u{e9}".as_bytes()), None);
+        assert_eq!(crib_scores(b"abc", b""), None);
+    }
+
+    #[test]
+    fn differences_do_not_depend_on_the_shift() {
+        let text = "Shift \u{e9}invariant ~\x7f\x00";
+        let mut expected = Vec::new();
+        differences(text.as_bytes(), &mut expected);
+        for key in [1, 64, 127] {
+            let mut actual = Vec::new();
+            differences(&encrypt(text, key), &mut actual);
+            assert_eq!(actual, expected);
+        }
+    }
+}
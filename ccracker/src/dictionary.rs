@@ -0,0 +1,515 @@
+//! A prepared word dictionary that is queried with byte slices.
+//!
+//! The dictionary attack looks up every token of every candidate decryption, so lookups
+//! dominate its cost. Almost every English word is at most 16 bytes long, which means it
+//! fits in a single `u128`. Such words are packed into integer keys and stored in an
+//! open-addressing table; a membership test is then one integer hash and one integer
+//! compare instead of hashing and comparing a variable-length string through a pointer.
+//! The few longer words (and any word that is not pure ASCII) go to a fallback set.
+//!
+//! Words are bucketed by length, and the dictionary records its shortest and longest word
+//! along with a bitmap of the lengths that occur. Tokens whose length no word has, such as
+//! long base64 blobs or URLs in machine-generated text, are rejected before they are packed
+//! or hashed. The packed words also feed a cache-resident Bloom filter that rejects most
+//! of the remaining misses before the exact table is probed.
+//!
+//! # Packed keys
+//!
+//! A word of `1..=16` ASCII bytes is loaded little-endian into a `u128`, leaving the unused
+//! high bytes zero. Since ASCII bytes never set bit 7, the last byte of the word is tagged
+//! with `0x80`. The tag makes the key unambiguous (`"a"` and `"a\0"` differ) and guarantees
+//! that no key is zero, so zero can mark empty table slots.
+use crate::bloom::BloomFilter;
+use std::collections::HashSet;
+
+/// Maximum length in bytes of a word that can be packed into a `u128` key.
+pub(crate) const PACKED_LEN: usize = 16;
+
+/// `0x01` in every byte lane.
+const LANE_ONES: u128 = u128::MAX / 0xff;
+/// The high bit of every byte lane.
+const LANE_HIGH_BITS: u128 = LANE_ONES * 0x80;
+
+/// Returns a mask selecting the low `len` byte lanes of a `u128`.
+fn lane_mask(len: usize) -> u128 {
+    if len >= PACKED_LEN {
+        u128::MAX
+    } else {
+        (1u128 << (8 * len)) - 1
+    }
+}
+
+/// Packs the low `len` byte lanes of `lanes` into a key, if they are all ASCII.
+fn pack_lanes(lanes: u128, len: usize) -> Option<u128> {
+    let word = lanes & lane_mask(len);
+    if len == 0 || len > PACKED_LEN || word & LANE_HIGH_BITS != 0 {
+        return None;
+    }
+    Some(word | 0x80 << (8 * (len - 1)))
+}
+
+/// Packs a word into a key, if it is `1..=16` ASCII bytes long.
+fn pack_word(word: &[u8]) -> Option<u128> {
+    if word.len() > PACKED_LEN {
+        return None;
+    }
+    let mut lanes = [0u8; PACKED_LEN];
+    lanes[..word.len()].copy_from_slice(word);
+    pack_lanes(u128::from_le_bytes(lanes), word.len())
+}
+
+/// An open-addressing (linear probing) hash set of packed keys.
+struct PackedTable {
+    slots: Box<[u128]>,
+    /// Number of bits used to index `slots`.
+    bits: u32,
+}
+
+impl PackedTable {
+    fn with_keys(keys: &[u128]) -> Self {
+        // Keep the load factor at or below one half so probe sequences stay short.
+        let capacity = (keys.len() * 2).next_power_of_two().max(16);
+        let mut table = PackedTable {
+            slots: vec![0; capacity].into_boxed_slice(),
+            bits: capacity.trailing_zeros(),
+        };
+        for &key in keys {
+            table.insert(key);
+        }
+        table
+    }
+
+    fn slot(&self, key: u128) -> usize {
+        // Fold both halves together and use the high bits of a Fibonacci hash.
+        let folded = (key as u64) ^ ((key >> 64) as u64).rotate_left(32);
+        (folded.wrapping_mul(0x9e37_79b9_7f4a_7c15) >> (64 - self.bits)) as usize
+    }
+
+    fn insert(&mut self, key: u128) {
+        let mask = self.slots.len() - 1;
+        let mut slot = self.slot(key);
+        while self.slots[slot] != 0 && self.slots[slot] != key {
+            slot = (slot + 1) & mask;
+        }
+        self.slots[slot] = key;
+    }
+
+    fn contains(&self, key: u128) -> bool {
+        let mask = self.slots.len() - 1;
+        let mut slot = self.slot(key);
+        loop {
+            match self.slots[slot] {
+                0 => return false,
+                stored if stored == key => return true,
+                _ => slot = (slot + 1) & mask,
+            }
+        }
+    }
+}
+
+/// The word lengths present in a dictionary.
+struct LengthIndex {
+    min: usize,
+    max: usize,
+    /// Bit `n` is set if some word is `n` bytes long. Lengths of 64 bytes or more are only
+    /// bounded by `max`.
+    bitmap: u64,
+}
+
+impl LengthIndex {
+    fn new(lengths: impl IntoIterator<Item = usize>) -> Self {
+        let mut index = LengthIndex {
+            min: usize::MAX,
+            max: 0,
+            bitmap: 0,
+        };
+        for len in lengths {
+            index.min = index.min.min(len);
+            index.max = index.max.max(len);
+            if len < 64 {
+                index.bitmap |= 1 << len;
+            }
+        }
+        index
+    }
+
+    fn contains(&self, len: usize) -> bool {
+        if len < 64 {
+            self.bitmap >> len & 1 != 0
+        } else {
+            len <= self.max
+        }
+    }
+}
+
+/// A set of dictionary words that can be queried with `&[u8]` keys.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::Dictionary;
+///
+/// let dictionary = Dictionary::from_words(["hello", "world"]);
+/// assert!(dictionary.contains(b"hello"));
+/// assert!(!dictionary.contains(b"goodbye"));
+/// ```
+pub struct Dictionary {
+    /// Words of at most 16 ASCII bytes, bucketed by length: bucket `n` holds the words of
+    /// `n` bytes.
+    buckets: Vec<PackedTable>,
+    /// Prefilter over every packed word; `None` when disabled.
+    bloom: Option<BloomFilter>,
+    /// Every other word.
+    fallback: HashSet<Box<[u8]>>,
+    lengths: LengthIndex,
+    /// `word_bytes[b]` is `true` if byte `b` occurs in some word.
+    word_bytes: [bool; 256],
+    len: usize,
+}
+
+impl Dictionary {
+    /// Builds a dictionary from a list of words.
+    ///
+    /// Surrounding whitespace is trimmed and empty words are ignored.
+    pub fn from_words<'a>(words: impl IntoIterator<Item = &'a str>) -> Self {
+        let mut bucket_keys = vec![Vec::new(); PACKED_LEN + 1];
+        let mut fallback: HashSet<Box<[u8]>> = HashSet::new();
+        let mut word_bytes = [false; 256];
+        for word in words.into_iter().map(str::trim) {
+            if word.is_empty() {
+                continue;
+            }
+            for &byte in word.as_bytes() {
+                word_bytes[usize::from(byte)] = true;
+            }
+            match pack_word(word.as_bytes()) {
+                Some(key) => bucket_keys[word.len()].push(key),
+                None => {
+                    fallback.insert(word.as_bytes().into());
+                }
+            }
+        }
+        for keys in &mut bucket_keys {
+            keys.sort_unstable();
+            keys.dedup();
+        }
+
+        let lengths = LengthIndex::new(
+            bucket_keys
+                .iter()
+                .enumerate()
+                .filter(|(_, keys)| !keys.is_empty())
+                .map(|(len, _)| len)
+                .chain(fallback.iter().map(|word| word.len())),
+        );
+        let bloom = BloomFilter::with_keys(&bucket_keys.concat());
+        Dictionary {
+            word_bytes,
+            len: bucket_keys.iter().map(Vec::len).sum::<usize>() + fallback.len(),
+            bloom: Some(bloom),
+            buckets: bucket_keys
+                .iter()
+                .map(|keys| PackedTable::with_keys(keys))
+                .collect(),
+            fallback,
+            lengths,
+        }
+    }
+
+    /// Builds a dictionary from the bundled list of popular English words.
+    pub fn popular_english() -> Self {
+        Self::from_words(crate::POPULAR_ENGLISH_WORDS.lines())
+    }
+
+    /// Returns the dictionary without its Bloom filter prefilter.
+    ///
+    /// Every lookup then probes the exact table. This is mostly useful to measure what the
+    /// prefilter saves.
+    pub fn without_prefilter(mut self) -> Self {
+        self.bloom = None;
+        self
+    }
+
+    /// Returns the size in bytes of the Bloom filter prefilter, or zero when it is disabled.
+    pub fn prefilter_size_in_bytes(&self) -> usize {
+        self.bloom.as_ref().map_or(0, BloomFilter::size_in_bytes)
+    }
+
+    /// Returns `true` if `word` is in the dictionary.
+    pub fn contains(&self, word: &[u8]) -> bool {
+        if !self.lengths.contains(word.len()) {
+            return false;
+        }
+        match pack_word(word) {
+            Some(key) => self.contains_packed(key, word.len()),
+            None => self.fallback.contains(word),
+        }
+    }
+
+    /// Looks up the packed key of a word of `len` bytes.
+    fn contains_packed(&self, key: u128, len: usize) -> bool {
+        if let Some(bloom) = &self.bloom {
+            if !bloom.may_contain(key) {
+                return false;
+            }
+        }
+        self.buckets[len].contains(key)
+    }
+
+    /// Returns the length in bytes of the shortest word, or `None` for an empty dictionary.
+    pub fn min_word_len(&self) -> Option<usize> {
+        (!self.is_empty()).then_some(self.lengths.min)
+    }
+
+    /// Returns the length in bytes of the longest word, or `None` for an empty dictionary.
+    pub fn max_word_len(&self) -> Option<usize> {
+        (!self.is_empty()).then_some(self.lengths.max)
+    }
+
+    /// Returns `true` if byte `byte` occurs in some word of the dictionary.
+    ///
+    /// A token containing any other byte cannot be a dictionary word.
+    pub fn is_word_byte(&self, byte: u8) -> bool {
+        self.word_bytes[usize::from(byte)]
+    }
+
+    /// Returns `true` if some word in the dictionary is `len` bytes long.
+    ///
+    /// Tokens of any other length can be rejected without looking them up.
+    pub fn has_word_len(&self, len: usize) -> bool {
+        self.lengths.contains(len)
+    }
+
+    /// Counts the tokens of `text[..len]` that are dictionary words.
+    ///
+    /// Tokens are separated by bytes for which `is_separator` returns `true`. Tokens whose
+    /// length no dictionary word has are rejected before they are packed or hashed, and most
+    /// other misses are rejected by the Bloom filter before the exact table is probed. `text`
+    /// must extend at least [`PACKED_LEN`] bytes past `len`: every remaining token is then
+    /// packed with a single unaligned 16-byte load whose excess lanes are masked off, so the
+    /// padding contents do not matter.
+    pub(crate) fn count_words_padded(
+        &self,
+        text: &[u8],
+        len: usize,
+        is_separator: impl Fn(u8) -> bool,
+    ) -> u32 {
+        assert!(text.len() >= len + PACKED_LEN, "text is not padded");
+
+        let mut count = 0;
+        let mut start = 0;
+        while start < len {
+            if is_separator(text[start]) {
+                start += 1;
+                continue;
+            }
+            let end = text[start..len]
+                .iter()
+                .position(|&byte| is_separator(byte))
+                .map_or(len, |offset| start + offset);
+
+            let token_len = end - start;
+            if !self.lengths.contains(token_len) {
+                start = end;
+                continue;
+            }
+            let lanes = u128::from_le_bytes(
+                text[start..start + PACKED_LEN]
+                    .try_into()
+                    .expect("slice is 16 bytes long"),
+            );
+            let found = match pack_lanes(lanes, token_len) {
+                Some(key) => self.contains_packed(key, token_len),
+                None => self.fallback.contains(&text[start..end]),
+            };
+            count += u32::from(found);
+            start = end;
+        }
+
+        count
+    }
+
+    /// Returns the number of words in the dictionary.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Returns `true` if the dictionary holds no words.
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn count_words(dictionary: &Dictionary, text: &[u8]) -> u32 {
+        let mut padded = text.to_vec();
+        // Fill the padding with word bytes to check that it is masked off.
+        padded.extend_from_slice(&[b'x'; PACKED_LEN]);
+        dictionary.count_words_padded(&padded, text.len(), |byte| byte == b' ')
+    }
+
+    #[test]
+    fn from_words_trims_and_skips_empty_words() {
+        let dictionary = Dictionary::from_words([" the ", "", "  ", "fox\r", "the"]);
+
+        assert_eq!(dictionary.len(), 2);
+        assert!(dictionary.contains(b"the"));
+        assert!(dictionary.contains(b"fox"));
+        assert!(!dictionary.contains(b""));
+    }
+
+    #[test]
+    fn popular_english_contains_common_words() {
+        let dictionary = Dictionary::popular_english();
+
+        assert!(!dictionary.is_empty());
+        assert!(dictionary.contains(b"the"));
+        assert!(dictionary.contains(b"and"));
+        assert!(!dictionary.contains(b"The"));
+    }
+
+    #[test]
+    fn contains_distinguishes_packed_words_by_length() {
+        let dictionary = Dictionary::from_words(["a", "sixteen-letters!", "seventeen-letters"]);
+
+        assert!(dictionary.contains(b"a"));
+        assert!(!dictionary.contains(b"a\0"));
+        assert!(!dictionary.contains(b"\0a"));
+        assert!(dictionary.contains(b"sixteen-letters!"));
+        assert!(!dictionary.contains(b"sixteen-letters"));
+        assert!(dictionary.contains(b"seventeen-letters"));
+        assert!(!dictionary.contains(b"seventeen-letter"));
+    }
+
+    #[test]
+    fn contains_uses_fallback_for_non_ascii_words() {
+        let dictionary = Dictionary::from_words(["café", "cafe"]);
+
+        assert!(dictionary.contains("café".as_bytes()));
+        assert!(dictionary.contains(b"cafe"));
+        assert!(!dictionary.contains("cafè".as_bytes()));
+    }
+
+    #[test]
+    fn count_words_padded_counts_packed_and_fallback_words() {
+        let dictionary = Dictionary::from_words(["the", "fox", "seventeen-letters"]);
+
+        assert_eq!(count_words(&dictionary, b"the fox"), 2);
+        assert_eq!(count_words(&dictionary, b"  the   fox  "), 2);
+        assert_eq!(count_words(&dictionary, b"the seventeen-letters fo"), 2);
+        assert_eq!(count_words(&dictionary, b"th"), 0);
+        assert_eq!(count_words(&dictionary, b""), 0);
+    }
+
+    #[test]
+    fn word_lengths_are_indexed() {
+        let dictionary = Dictionary::from_words(["to", "fox", "seventeen-letters"]);
+
+        assert_eq!(dictionary.min_word_len(), Some(2));
+        assert_eq!(dictionary.max_word_len(), Some(17));
+        assert!(dictionary.has_word_len(2));
+        assert!(dictionary.has_word_len(17));
+        assert!(!dictionary.has_word_len(1));
+        assert!(!dictionary.has_word_len(4));
+        assert!(!dictionary.has_word_len(100));
+    }
+
+    #[test]
+    fn word_bytes_are_indexed() {
+        let dictionary = Dictionary::from_words(["to", "seventeen-letters", "café"]);
+
+        for byte in "toseventlrscafé-".bytes() {
+            assert!(dictionary.is_word_byte(byte), "{byte:#x}");
+        }
+        for byte in [0, b'b', b'z', b' ', 0x80] {
+            assert!(!dictionary.is_word_byte(byte), "{byte:#x}");
+        }
+        assert!(Dictionary::from_words(["a\0b"]).is_word_byte(0));
+    }
+
+    #[test]
+    fn empty_dictionary_has_no_word_lengths() {
+        let dictionary = Dictionary::from_words([]);
+
+        assert_eq!(dictionary.min_word_len(), None);
+        assert_eq!(dictionary.max_word_len(), None);
+        assert!(!dictionary.has_word_len(0));
+        assert!(!dictionary.contains(b"a"));
+        assert_eq!(count_words(&dictionary, b"a b c"), 0);
+    }
+
+    #[test]
+    fn count_words_padded_skips_tokens_longer_than_any_word() {
+        let dictionary = Dictionary::from_words(["the", "fox"]);
+        let blob = format!("the {} fox", "QUJD".repeat(64));
+
+        assert_eq!(count_words(&dictionary, blob.as_bytes()), 2);
+    }
+
+    #[test]
+    fn without_prefilter_finds_the_same_words() {
+        let words = ["the", "fox", "seventeen-letters", "café"];
+        let filtered = Dictionary::from_words(words);
+        let exact = Dictionary::from_words(words).without_prefilter();
+
+        for word in [
+            "the",
+            "fox",
+            "seventeen-letters",
+            "café",
+            "thé",
+            "dog",
+            "fo",
+        ] {
+            assert_eq!(
+                filtered.contains(word.as_bytes()),
+                exact.contains(word.as_bytes())
+            );
+        }
+    }
+
+    #[test]
+    fn prefilter_rejects_most_shifted_words() {
+        let dictionary = Dictionary::popular_english();
+        let bloom = dictionary.bloom.as_ref().unwrap();
+        let mut misses = 0;
+        let mut false_positives = 0;
+        for word in crate::POPULAR_ENGLISH_WORDS.lines().take(5000) {
+            for shift in [1u8, 17, 64, 100] {
+                let shifted: Vec<u8> = word
+                    .bytes()
+                    .map(|byte| byte.wrapping_add(shift) & 0x7f)
+                    .collect();
+                let Some(key) = pack_word(&shifted) else {
+                    continue;
+                };
+                if dictionary.buckets[shifted.len()].contains(key) {
+                    continue;
+                }
+                misses += 1;
+                false_positives += usize::from(bloom.may_contain(key));
+            }
+        }
+
+        // The documented false-positive rate is about 0.4%.
+        assert!(
+            false_positives * 100 < misses,
+            "{false_positives} of {misses}"
+        );
+    }
+
+    #[test]
+    fn packed_table_finds_every_inserted_key() {
+        let words: Vec<String> = (0..5000).map(|i| format!("w{i}")).collect();
+        let dictionary = Dictionary::from_words(words.iter().map(String::as_str));
+
+        assert_eq!(dictionary.len(), 5000);
+        assert!(words
+            .iter()
+            .all(|word| dictionary.contains(word.as_bytes())));
+        assert!(!dictionary.contains(b"w5000"));
+    }
+}
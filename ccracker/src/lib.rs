@@ -3,12 +3,24 @@
 //! # Overview
 //!
 //! This module provides functionality to automatically determine the shift key of a Caesar cipher
-//! encrypted text. It supports two methods of analysis:
+//! encrypted text. It supports four methods of analysis:
 //!
 //! * Dictionary-based attack - Attempts to find the key by matching decrypted words against a
 //!   dictionary of common English words.
 //! * Frequency analysis - Uses character frequency distribution comparison against typical
 //!   English text patterns.
+//! * N-gram analysis - Scores each key by the likelihood of the character pairs and triples
+//!   it produces, which works on inputs too short for frequency analysis.
+//! * Known-plaintext (crib) search - Finds the key from a fragment of the plaintext that is
+//!   known to occur in the message, such as a protocol header.
+//!
+//! Every attack has a form generic over the [`ccipher::Alphabet`] of the cipher, such as
+//! [`rank_alphabet_freq_attack`], which only tries the keys of that alphabet: 26 for the
+//! classic letters-only cipher.
+//!
+//! Ciphertext produced by the affine cipher `a·x + b` is cracked by frequency analysis over
+//! all 8192 affine keys with [`rank_ascii_affine_attack`], and ciphertext produced by the
+//! Vigenère cipher, a repeating key of shifts, with [`crack_vigenere`].
 //!
 //! # Usage
 //!
@@ -16,10 +28,7 @@
 //! use ccracker::{Config, Attack};
 //! use std::path::PathBuf;
 //!
-//! let config = Config {
-//!     ciphertext_file: Some(PathBuf::from("encrypted.txt")),
-//!     attack_type: Attack::Dictionary,
-//! };
+//! let config = Config::new(Some(PathBuf::from("encrypted.txt")), Attack::Dictionary);
 //!
 //! if let Ok(()) = ccracker::run(&config) {
 //!     println!("Analysis complete!");
@@ -28,16 +37,48 @@
 //!
 //! The library will output either a candidate key value or indicate that no viable key
 //! was found. The discovered key can then be used with a Caesar cipher implementation
-//! to decrypt the original message.
+//! to decrypt the original message. When more than one key is of interest, the `rank_*`
+//! functions return a [`Ranking`] of the best candidates and their scores.
+use ccipher::{Alphabet, AlphabetKind, Ascii128, Latin26};
 use clap::ValueEnum;
 use std::collections::BTreeMap;
-use std::collections::HashMap;
 use std::collections::HashSet;
-use std::io;
+use std::io::{self, Write};
 use std::path::PathBuf;
 
+mod affine;
+mod alphabet;
+mod bloom;
+mod crib;
+mod dictionary;
+mod lanes;
+mod metrics;
+mod ngram;
+mod per_line;
+mod ranking;
+mod segment;
+mod stream;
+mod tree;
+mod vigenere;
+
+pub use affine::{rank_ascii_affine_attack, AffineCandidate, AffineRanking, AFFINE_KEYS};
+pub use alphabet::{
+    rank_alphabet_crib_attack, rank_alphabet_dict_attack, rank_alphabet_freq_attack,
+    rank_alphabet_ngram_attack,
+};
+pub use dictionary::Dictionary;
+pub use lanes::{scan_lanes, LaneScanner, LaneStats, LANES};
+pub use metrics::Metric;
+pub use ngram::NgramScanner;
+pub use per_line::{crack_lines, LineCracker, KEY_CACHE_LEN};
+pub use ranking::{Candidate, Format, Ranking, ScoreOrder};
+pub use segment::{segment_ascii, write_segments, Segment, DEFAULT_WINDOW};
+pub use stream::{crack_stream, StreamCracker, DEFAULT_STREAM_CONFIDENCE};
+pub use tree::{write_manifest, FileReport, TreeCracker, MAX_UNITS_PER_FILE, UNIT_LEN};
+pub use vigenere::{crack_vigenere, VigenereKey, DEFAULT_MAX_PERIOD};
+
 /// The length of the ASCII alphabet, representing the total number of possible shift values (0-127).
-pub const ASCII_ALPHABET_LEN: u8 = 128;
+pub const ASCII_ALPHABET_LEN: u8 = Ascii128::LEN;
 /// A static string containing a list of commonly used English words, used for dictionary attacks.
 pub const POPULAR_ENGLISH_WORDS: &str = include_str!("../datasets/popular_english_words.txt");
 /// A static string containing the frequency distribution of characters in typical English text.
@@ -50,6 +91,10 @@ pub enum Attack {
     Dictionary,
     /// Uses letter frequency analysis to determine the most likely decryption key.
     Frequency,
+    /// Scores each key by the log-likelihood of its character bigrams and trigrams.
+    Ngram,
+    /// Searches the ciphertext for a known fragment of the plaintext (a crib).
+    Crib,
 }
 
 /// Configuration settings for the Caesar cipher cracker.
@@ -58,6 +103,46 @@ pub struct Config {
     pub ciphertext_file: Option<PathBuf>,
     /// Method to use for cracking the cipher (Dictionary or Frequency analysis).
     pub attack_type: Attack,
+    /// Number of candidate keys to report, best first.
+    pub top: usize,
+    /// Format used to print the candidate keys.
+    pub format: Format,
+    /// Metric the frequency attack compares character distributions with.
+    pub metric: Metric,
+    /// Known plaintext fragment searched for by the crib attack.
+    pub crib: Option<String>,
+    /// When set, the ciphertext is split into segments encrypted under different keys using
+    /// a sliding window of this many bytes, and one key is reported per segment instead of
+    /// running `attack_type`.
+    pub segment_window: Option<usize>,
+    /// When set, every line is cracked on its own with the n-gram model and the results are
+    /// streamed line by line instead of running `attack_type` on the whole input.
+    pub per_line: bool,
+    /// When set, the input is cracked with the n-gram model as it is read, and the key is
+    /// reported as soon as the confidence margin of the ranking reaches this value.
+    pub stream_confidence: Option<f64>,
+    /// In streaming mode, keeps scoring the input after the key was reported and reports
+    /// again whenever the best key changes.
+    pub verify: bool,
+    /// When set, every file below this directory is cracked with `attack_type` on a
+    /// work-stealing pool and a manifest of the files and their keys is reported instead.
+    pub recursive: Option<PathBuf>,
+    /// When set, the ciphertext is treated as affine ciphertext and all 8192 affine keys are
+    /// ranked by frequency analysis with `metric` instead of running `attack_type`.
+    pub affine: bool,
+    /// Alphabet of the Caesar cipher. With [`AlphabetKind::Latin26`] only its 26 keys are
+    /// tried, by the `rank_alphabet_*` form of `attack_type`.
+    pub alphabet: AlphabetKind,
+    /// When set, the ciphertext is treated as Vigenère ciphertext over `alphabet` and its
+    /// key, of at most this many shifts, is recovered with `metric` instead of running
+    /// `attack_type`.
+    pub vigenere_max_period: Option<usize>,
+    /// When set, the ciphertext is decrypted with the best candidate key and the plaintext is
+    /// written to `output_file`. The candidate keys are then reported on stderr.
+    pub decrypt: bool,
+    /// Optional plaintext output file used with `decrypt`. When None, the plaintext is written
+    /// to standard output (stdout).
+    pub output_file: Option<PathBuf>,
 }
 
 impl Config {
@@ -65,6 +150,20 @@ impl Config {
         Config {
             ciphertext_file,
             attack_type,
+            top: 1,
+            format: Format::Text,
+            metric: Metric::L1,
+            crib: None,
+            segment_window: None,
+            per_line: false,
+            stream_confidence: None,
+            verify: false,
+            recursive: None,
+            affine: false,
+            alphabet: AlphabetKind::Ascii128,
+            vigenere_max_period: None,
+            decrypt: false,
+            output_file: None,
         }
     }
 }
@@ -75,8 +174,10 @@ impl Config {
 /// for dictionary-based attack analysis.
 ///
 /// The words are loaded from a static string constant, filtered to remove
-/// empty lines, and converted to owned String instances.
-fn load_dictionary() -> HashSet<String> {
+/// empty lines, and converted to owned String instances. Prefer
+/// [`Dictionary::popular_english`] with the byte-slice attack, which does not
+/// need owned strings for lookups.
+pub fn load_dictionary() -> HashSet<String> {
     POPULAR_ENGLISH_WORDS
         .lines()
         .filter(|line| !line.trim().is_empty())
@@ -84,9 +185,183 @@ fn load_dictionary() -> HashSet<String> {
         .collect()
 }
 
+/// Reusable buffers for the byte-slice dictionary attack.
+///
+/// Every shift is decrypted into one scratch buffer, which is swapped with the best
+/// plaintext buffer whenever a shift beats the best count so far. Reusing a `DictScratch`
+/// across calls avoids allocating once its buffers have grown to the input size.
+#[derive(Default)]
+pub struct DictScratch {
+    plaintext: Vec<u8>,
+    best_plaintext: Vec<u8>,
+    len: usize,
+}
+
+impl DictScratch {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Returns the plaintext decrypted under the best shift of the last attack.
+    pub fn best_plaintext(&self) -> &[u8] {
+        &self.best_plaintext[..self.len]
+    }
+
+    /// Consumes the scratch and returns the buffer holding the best plaintext.
+    pub fn into_best_plaintext(mut self) -> Vec<u8> {
+        self.best_plaintext.truncate(self.len);
+        self.best_plaintext
+    }
+}
+
+/// Returns `true` for the ASCII bytes that `str::split_whitespace` splits words on.
+fn is_word_separator(byte: u8) -> bool {
+    matches!(byte, b'\t'..=b'\r' | b' ')
+}
+
+/// Counts the dictionary words produced by the most promising shifts of the ciphertext.
+///
+/// The returned table is indexed by shift. Words are separated by ASCII whitespace. A single
+/// [`scan_lanes`] pass first bounds the count of every shift; shifts are then decrypted in
+/// order of decreasing bound until no remaining shift can enter the top `keep` counts. The
+/// counts of shifts skipped this way are reported as zero, so the top `keep` entries of the
+/// table are exact (and at least two are, so a runner-up is always available).
+///
+/// On return, `scratch` holds the decryption under the first shift with the highest count so
+/// callers can emit it without decrypting the ciphertext again. Once the scratch buffers are
+/// large enough for the ciphertext, this function does not allocate.
+fn ascii_dict_scores(
+    ciphertext: &[u8],
+    dictionary: &Dictionary,
+    keep: usize,
+    scratch: &mut DictScratch,
+) -> [u32; ASCII_ALPHABET_LEN as usize] {
+    // The padding lets the dictionary pack every token with a single 16-byte load.
+    let len = ciphertext.len();
+    scratch.len = len;
+    scratch.plaintext.resize(len + dictionary::PACKED_LEN, 0);
+    scratch
+        .best_plaintext
+        .resize(len + dictionary::PACKED_LEN, 0);
+
+    let bounds = scan_lanes(ciphertext, dictionary).word_candidates;
+    let mut order: [u8; ASCII_ALPHABET_LEN as usize] = std::array::from_fn(|shift| shift as u8);
+    order.sort_unstable_by_key(|&shift| (std::cmp::Reverse(bounds[usize::from(shift)]), shift));
+
+    // The best exact counts seen so far, in decreasing order.
+    let keep = keep.clamp(2, ASCII_ALPHABET_LEN.into());
+    let mut top = [0; ASCII_ALPHABET_LEN as usize];
+    let mut top_len = 0;
+
+    let mut scores = [0; ASCII_ALPHABET_LEN as usize];
+    let mut best: Option<(u32, u8)> = None;
+    for shift in order {
+        let bound = bounds[usize::from(shift)];
+        if bound == 0 || (top_len == keep && bound < top[keep - 1]) {
+            // Every remaining shift has a bound this low and cannot enter the top counts.
+            break;
+        }
+
+        let cipher = ccipher::CaesarCipher::new(i32::from(shift));
+        cipher.apply_cipher_bytes(ciphertext, &mut scratch.plaintext[..len]);
+        let count = dictionary.count_words_padded(&scratch.plaintext, len, is_word_separator);
+        scores[usize::from(shift)] = count;
+        // Among equal counts, the smallest shift wins.
+        let is_best = best.map_or(count > 0, |(best_count, best_shift)| {
+            count > best_count || (count == best_count && shift < best_shift)
+        });
+        if is_best {
+            best = Some((count, shift));
+            std::mem::swap(&mut scratch.plaintext, &mut scratch.best_plaintext);
+        }
+
+        let position = top[..top_len].partition_point(|&other| other >= count);
+        if position < keep {
+            top.copy_within(position..keep - 1, position + 1);
+            top[position] = count;
+            top_len = (top_len + 1).min(keep);
+        }
+    }
+
+    scores
+}
+
+/// Ranks a table of per-shift dictionary word counts, skipping shifts without matches.
+fn rank_dict_counts(counts: &[u32; ASCII_ALPHABET_LEN as usize], k: usize) -> Ranking {
+    let scores = counts.map(f64::from);
+    Ranking::from_scores(&scores, k, ScoreOrder::HigherIsBetter, |count| count > 0.0)
+}
+
+/// Ranks the `k` shifts that produce the most dictionary words.
+///
+/// Shifts that produce no dictionary words at all are not considered candidates, so the
+/// ranking may hold fewer than `k` entries.
+///
+/// Like [`rank_ascii_dict_attack_with_plaintext`], this prepares a [`Dictionary`] from the
+/// word set on every call; see there for the cheaper form.
+pub fn rank_ascii_dict_attack(ciphertext: &str, dictionary: &HashSet<String>, k: usize) -> Ranking {
+    rank_ascii_dict_attack_with_plaintext(ciphertext, dictionary, k).0
+}
+
+/// Ranks the `k` shifts that produce the most dictionary words and returns the plaintext
+/// decrypted under the best of them.
+///
+/// The plaintext is the buffer produced while scoring the winning shift, so no additional
+/// pass over the ciphertext is made. It is `None` when no candidate key was found.
+///
+/// Every call builds a [`Dictionary`] from `dictionary`, hashing each word into its buckets
+/// and prefilter, which costs more than the attack itself on short ciphertexts. Callers that
+/// attack more than one text should build the [`Dictionary`] once and call
+/// [`rank_ascii_dict_attack_bytes`] with a reused [`DictScratch`] instead.
+pub fn rank_ascii_dict_attack_with_plaintext(
+    ciphertext: &str,
+    dictionary: &HashSet<String>,
+    k: usize,
+) -> (Ranking, Option<String>) {
+    let dictionary = Dictionary::from_words(dictionary.iter().map(String::as_str));
+    let mut scratch = DictScratch::new();
+    let counts = ascii_dict_scores(ciphertext.as_bytes(), &dictionary, k, &mut scratch);
+    let ranking = rank_dict_counts(&counts, k);
+    let plaintext = ranking.best().map(|_| {
+        String::from_utf8(scratch.into_best_plaintext())
+            .expect("shifting ASCII bytes preserves UTF-8")
+    });
+
+    (ranking, plaintext)
+}
+
+/// Ranks the `k` shifts that produce the most dictionary words in a byte-slice ciphertext.
+///
+/// This is the allocation-free form of [`rank_ascii_dict_attack`]: every shift is decrypted
+/// into the buffers of `scratch`, tokens are packed into integer keys and looked up in
+/// `dictionary`, and the scores are kept in a fixed table. Afterwards
+/// [`DictScratch::best_plaintext`] holds the decryption under the best candidate.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::{rank_ascii_dict_attack_bytes, DictScratch, Dictionary};
+///
+/// let dictionary = Dictionary::from_words(["hello", "world"]);
+/// let mut scratch = DictScratch::new();
+/// let ranking = rank_ascii_dict_attack_bytes(b"ifmmp!xpsme", &dictionary, 1, &mut scratch);
+///
+/// assert_eq!(ranking.best().map(|c| c.shift), Some(127));
+/// assert_eq!(scratch.best_plaintext(), b"hello world");
+/// ```
+pub fn rank_ascii_dict_attack_bytes(
+    ciphertext: &[u8],
+    dictionary: &Dictionary,
+    k: usize,
+    scratch: &mut DictScratch,
+) -> Ranking {
+    let counts = ascii_dict_scores(ciphertext, dictionary, k, scratch);
+    rank_dict_counts(&counts, k)
+}
+
 /// Attempts to crack a Caesar cipher using dictionary-based analysis.
 ///
-/// This function tries all possible shift values (0-255) and counts how many
+/// This function tries all possible shift values (0-127) and counts how many
 /// words in each decrypted attempt match words in the dictionary. The shift
 /// that produces the most dictionary matches is considered the most likely
 /// correct decryption key.
@@ -95,34 +370,14 @@ fn load_dictionary() -> HashSet<String> {
 ///
 /// * `Some(u8)` - The most likely shift value that produces readable text
 /// * `None` - If no meaningful matches were found in the dictionary
+///
+/// The dictionary is prepared anew on every call, as described on
+/// [`rank_ascii_dict_attack_with_plaintext`]; repeated attacks should use
+/// [`rank_ascii_dict_attack_bytes`] with a prebuilt [`Dictionary`].
 pub fn apply_ascii_dict_attack(ciphertext: &str, dictionary: &HashSet<String>) -> Option<u8> {
-    // Count the number of dictionary words for each shift
-    let mut scores: HashMap<u8, usize> = HashMap::new();
-    for shift in 0..ASCII_ALPHABET_LEN {
-        let cipher = ccipher::CaesarCipher::new(shift as i32);
-        let plaintext = cipher.apply_cipher(ciphertext);
-        scores.insert(
-            shift,
-            plaintext
-                .split_whitespace()
-                .filter(|&word| dictionary.contains(word))
-                .count(),
-        );
-    }
-
-    if scores.values().all(|&count| count == 0) {
-        // Return None if all shifts in scores have a value of 0
-        None
-    } else {
-        // Return the shift with highest score
-        Some(
-            scores
-                .iter()
-                .max_by_key(|&(_, &count)| count)
-                .map(|(&shift, _)| shift)
-                .unwrap_or(0),
-        )
-    }
+    rank_ascii_dict_attack(ciphertext, dictionary, 1)
+        .best()
+        .map(|candidate| candidate.shift)
 }
 
 /// Calculates the frequency distribution of characters in the given character count map.
@@ -139,21 +394,119 @@ pub fn apply_ascii_dict_attack(ciphertext: &str, dictionary: &HashSet<String>) -
 /// character's frequency as a percentage of total characters.
 ///
 /// If the input map is empty, returns a vector of zeros with length ASCII_ALPHABET_LEN.
-fn get_freq_distribution(char_counter: &BTreeMap<char, u32>) -> Vec<f64> {
+fn get_freq_distribution(char_counter: &BTreeMap<char, u64>) -> Vec<f64> {
     if char_counter.is_empty() {
         return vec![0.0; ASCII_ALPHABET_LEN.into()];
     }
 
-    let total_chars: u32 = char_counter.values().sum();
+    let total_chars: u64 = char_counter.values().sum();
 
     (0..ASCII_ALPHABET_LEN)
         .map(|c| {
             let count = char_counter.get(&char::from(c)).unwrap_or(&0);
-            f64::from(*count) / f64::from(total_chars)
+            *count as f64 / total_chars as f64
         })
         .collect()
 }
 
+/// Counts the ASCII bytes of the ciphertext. Non-ASCII bytes are never shifted and do not
+/// take part in frequency analysis. The counters are 64-bit so that no input can wrap them.
+fn ascii_histogram(ciphertext: &[u8]) -> [u64; ASCII_ALPHABET_LEN as usize] {
+    let mut counts = [0; ASCII_ALPHABET_LEN as usize];
+    for &byte in ciphertext.iter().filter(|byte| byte.is_ascii()) {
+        counts[usize::from(byte)] += 1;
+    }
+    counts
+}
+
+/// Scores each shift's character distribution against the reference English distribution.
+///
+/// The returned table is indexed by shift. The ciphertext is counted once: the distribution
+/// under each shift is a rotation of the ciphertext's own distribution. The L1 distance is
+/// computed from the raw histogram in integer arithmetic and only converted to a fraction
+/// for reporting, so it needs no allocation and ranks shifts identically on every platform.
+fn ascii_freq_scores(ciphertext: &[u8], metric: Metric) -> [f64; ASCII_ALPHABET_LEN as usize] {
+    histogram_freq_scores(&ascii_histogram(ciphertext), metric)
+}
+
+/// Scores each shift of a histogram of ASCII bytes as [`ascii_freq_scores`] does. Histograms
+/// of separate pieces of a ciphertext can be summed and scored once.
+fn histogram_freq_scores(
+    counts: &[u64; ASCII_ALPHABET_LEN as usize],
+    metric: Metric,
+) -> [f64; ASCII_ALPHABET_LEN as usize] {
+    if metric == Metric::L1 {
+        let (distances, scale) = metrics::l1_distances(counts);
+        // Without characters every shift is as far from English as it can be.
+        if scale == 0 {
+            return [1.0; ASCII_ALPHABET_LEN as usize];
+        }
+        return distances.map(|distance| distance as f64 / scale as f64);
+    }
+
+    let char_counter: BTreeMap<char, u64> = (0..ASCII_ALPHABET_LEN)
+        .filter(|&c| counts[usize::from(c)] > 0)
+        .map(|c| (char::from(c), counts[usize::from(c)]))
+        .collect();
+    let distribution = get_freq_distribution(&char_counter);
+    let distribution: [f32; ASCII_ALPHABET_LEN as usize] =
+        std::array::from_fn(|c| distribution[c] as f32);
+
+    metric.scores(&distribution).map(f64::from)
+}
+
+/// Ranks the `k` shifts whose character distribution is closest to English text.
+///
+/// Candidate scores are L1 distances to the reference distribution, so lower is better.
+pub fn rank_ascii_freq_attack(ciphertext: &str, k: usize) -> Ranking {
+    rank_ascii_freq_attack_with_metric(ciphertext, k, Metric::L1)
+}
+
+/// Ranks the `k` shifts whose character distribution is closest to English text according
+/// to `metric`.
+///
+/// Candidate scores are the raw metric values; see [`Metric::order`] for their orientation.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::{rank_ascii_freq_attack_with_metric, Metric};
+///
+/// let plaintext = "The frequency attack needs a few sentences of ordinary English text \
+///                  before the distribution of its characters becomes reliable enough.";
+/// let ciphertext = ccipher::CaesarCipher::new(5).apply_cipher(plaintext);
+/// let ranking = rank_ascii_freq_attack_with_metric(&ciphertext, 1, Metric::ChiSquared);
+///
+/// assert_eq!(ranking.best().map(|c| c.shift), Some(123));
+/// ```
+pub fn rank_ascii_freq_attack_with_metric(ciphertext: &str, k: usize, metric: Metric) -> Ranking {
+    rank_ascii_freq_attack_bytes(ciphertext.as_bytes(), k, metric)
+}
+
+/// Ranks the `k` shifts of a byte ciphertext as [`rank_ascii_freq_attack_with_metric`] does.
+///
+/// The ciphertext need not be valid UTF-8: non-ASCII bytes are never shifted and do not take
+/// part in the analysis.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::{rank_ascii_freq_attack_bytes, Metric};
+///
+/// let plaintext = "The frequency attack needs a few sentences of ordinary English text \
+///                  before the distribution of its characters becomes reliable enough.";
+/// let mut ciphertext = plaintext.as_bytes().to_vec();
+/// ciphertext.extend_from_slice(&[0xff, 0xfe, 0x80]);
+/// ccipher::CaesarCipher::new(5).apply_cipher_in_place(&mut ciphertext);
+/// let ranking = rank_ascii_freq_attack_bytes(&ciphertext, 1, Metric::L1);
+///
+/// assert_eq!(ranking.best().map(|c| c.shift), Some(123));
+/// ```
+pub fn rank_ascii_freq_attack_bytes(ciphertext: &[u8], k: usize, metric: Metric) -> Ranking {
+    let scores = ascii_freq_scores(ciphertext, metric);
+    Ranking::from_scores(&scores, k, metric.order(), |_| true)
+}
+
 /// Attempts to crack a Caesar cipher using frequency analysis.
 ///
 /// # Returns
@@ -162,55 +515,79 @@ fn get_freq_distribution(char_counter: &BTreeMap<char, u32>) -> Vec<f64> {
 ///
 /// # Algorithm
 ///
-/// 1. Counts character frequencies for each possible shift (0-127)
-/// 2. Calculates frequency distribution for each shift
+/// 1. Counts the character frequencies of the ciphertext
+/// 2. Derives the frequency distribution of each possible shift (0-127) by rotating it
 /// 3. Compares each distribution against a reference frequency table of English text
 /// 4. Returns the shift value that produces the distribution closest to standard English
 ///
 /// The function uses a predefined frequency table (FREQUENCY_TABLE) as reference for
 /// comparing character distributions in English text.
 pub fn apply_ascii_freq_attack(ciphertext: &str) -> u8 {
-    type CharCounter = BTreeMap<char, u32>;
-    type ShiftCharCounts = BTreeMap<u8, CharCounter>;
-
-    // Count the frequency of each character for each shift
-    let mut shift_counts: ShiftCharCounts = BTreeMap::new();
-    for shift in 0..ASCII_ALPHABET_LEN {
-        let cipher = ccipher::CaesarCipher::new(i32::from(shift));
-        let plaintext = cipher.apply_cipher(ciphertext);
+    rank_ascii_freq_attack(ciphertext, 1)
+        .best()
+        .map_or(0, |candidate| candidate.shift)
+}
 
-        for c in plaintext.chars() {
-            if c.is_ascii() {
-                let count = shift_counts.entry(shift).or_default();
-                *count.entry(c).or_insert(0) += 1;
-            }
-        }
+/// Ranks the `k` shifts whose plaintext is most likely English according to bigram and
+/// trigram statistics.
+///
+/// Candidate scores are summed natural-log probabilities, so higher (closer to zero) is
+/// better. Unlike [`rank_ascii_freq_attack`], this attack identifies the key of inputs as
+/// short as a sentence, and unlike the dictionary attack it never decrypts the ciphertext:
+/// every shift is scored from precomputed tables in a single pass. The ranking is empty when
+/// the ciphertext holds fewer than two consecutive ASCII bytes.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::rank_ascii_ngram_attack;
+///
+/// let ciphertext = ccipher::CaesarCipher::new(11).apply_cipher("Meet me by the old mill.");
+/// let ranking = rank_ascii_ngram_attack(ciphertext.as_bytes(), 1);
+///
+/// assert_eq!(ranking.best().map(|c| c.shift), Some(128 - 11));
+/// ```
+pub fn rank_ascii_ngram_attack(ciphertext: &[u8], k: usize) -> Ranking {
+    match ngram::ngram_scores(ciphertext) {
+        Some(scores) => Ranking::from_scores(
+            &scores.map(f64::from),
+            k,
+            ScoreOrder::HigherIsBetter,
+            |_| true,
+        ),
+        None => Ranking::default(),
     }
+}
 
-    // Calculate frequency distribution for each shift
-    let freq_distributions: Vec<Vec<f64>> =
-        shift_counts.values().map(get_freq_distribution).collect();
-
-    // Find the shift with the closest distribution to the reference ASCII frequency table
-    let freq_table: Vec<f64> = FREQUENCY_TABLE
-        .lines()
-        .map(|line| line.parse::<f64>().unwrap())
-        .collect();
-    let mut min_diff = f64::INFINITY;
-    let mut best_shift = 0;
-    for (shift, distribution) in freq_distributions.iter().enumerate() {
-        let diff = freq_table
-            .iter()
-            .zip(distribution.iter())
-            .map(|(f1, f2)| (f1 - f2).abs())
-            .sum();
-        if diff < min_diff {
-            min_diff = diff;
-            best_shift = shift as u8;
-        }
+/// Ranks the `k` shifts under which the ciphertext contains `crib` most often.
+///
+/// Byte differences are invariant under a Caesar shift, so the difference pattern of the
+/// crib is located in the ciphertext with a single vectorized substring search instead of
+/// decrypting the ciphertext under every shift. Each occurrence determines its shift and is
+/// verified before it is counted. Candidate scores are occurrence counts (higher is better)
+/// and only shifts with at least one verified occurrence are ranked, so the ranking is empty
+/// when the crib does not occur or holds no ASCII byte.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::rank_ascii_crib_attack;
+///
+/// let ciphertext = ccipher::CaesarCipher::new(90).apply_cipher("HTTP/1.1 200 OK");
+/// let ranking = rank_ascii_crib_attack(ciphertext.as_bytes(), b"HTTP/1.1", 1);
+///
+/// assert_eq!(ranking.best().map(|c| c.shift), Some(128 - 90));
+/// ```
+pub fn rank_ascii_crib_attack(ciphertext: &[u8], crib: &[u8], k: usize) -> Ranking {
+    match crib::crib_scores(ciphertext, crib) {
+        Some(scores) => Ranking::from_scores(
+            &scores.map(f64::from),
+            k,
+            ScoreOrder::HigherIsBetter,
+            |score| score > 0.0,
+        ),
+        None => Ranking::default(),
     }
-
-    best_shift
 }
 
 /// Executes the cipher cracking process based on the provided configuration.
@@ -222,27 +599,312 @@ pub fn apply_ascii_freq_attack(ciphertext: &str) -> u8 {
 ///
 /// # Example Output
 ///
-/// On success, prints either:
+/// With the default text format and a single requested key, prints either:
 /// - "candidate key: N" where N is the discovered shift value
 /// - "unable to find candidate key" if no viable solution was found
+///
+/// See [`Ranking::write`] for the other formats, and [`write_segments`] for the output of
+/// segmentation mode. In decrypt mode the candidate keys are printed to stderr and the
+/// recovered plaintext is written to the configured output.
+///
+/// # Errors
+///
+/// In decrypt mode, an error of kind `NotFound` is returned when no candidate key was found.
+/// The crib attack fails with an error of kind `InvalidInput` when no crib is configured.
 pub fn run(config: &Config) -> io::Result<()> {
-    let ciphertext = ccipher_io::read_input(&config.ciphertext_file)?;
-    let shift = match config.attack_type {
+    if config.per_line {
+        return run_per_line(config);
+    }
+    if let Some(confidence) = config.stream_confidence {
+        return run_stream(config, confidence);
+    }
+    if let Some(root) = &config.recursive {
+        return run_tree(config, root);
+    }
+    // Cracking only looks at ASCII bytes, so the input is not required to be UTF-8.
+    let ciphertext = ccipher_io::read_input_bytes(&config.ciphertext_file)?;
+    if config.affine {
+        return run_affine(config, ciphertext);
+    }
+    if let Some(max_period) = config.vigenere_max_period {
+        return match config.alphabet {
+            AlphabetKind::Ascii128 => run_vigenere::<Ascii128>(config, ciphertext, max_period),
+            AlphabetKind::Latin26 => run_vigenere::<Latin26>(config, ciphertext, max_period),
+        };
+    }
+    if config.alphabet == AlphabetKind::Latin26 {
+        return run_alphabet::<Latin26>(config, ciphertext);
+    }
+    if let Some(window) = config.segment_window {
+        return run_segmentation(config, &ciphertext, window);
+    }
+    let mut scratch = DictScratch::new();
+    let (ranking, plaintext) = match config.attack_type {
         Attack::Dictionary => {
-            let dictionary = load_dictionary();
-            apply_ascii_dict_attack(&ciphertext, &dictionary)
+            let dictionary = Dictionary::popular_english();
+            let ranking =
+                rank_ascii_dict_attack_bytes(&ciphertext, &dictionary, config.top, &mut scratch);
+            (ranking, Some(scratch.best_plaintext()))
         }
-        Attack::Frequency => Some(apply_ascii_freq_attack(&ciphertext)),
+        Attack::Frequency => (
+            rank_ascii_freq_attack_bytes(&ciphertext, config.top, config.metric),
+            None,
+        ),
+        Attack::Ngram => (rank_ascii_ngram_attack(&ciphertext, config.top), None),
+        Attack::Crib => (
+            rank_ascii_crib_attack(&ciphertext, crib(config)?, config.top),
+            None,
+        ),
     };
 
-    match shift {
-        Some(shift) => {
-            println!("candidate key: {}", shift);
+    if !config.decrypt {
+        return ranking.write(&mut io::stdout().lock(), config.format);
+    }
+
+    ranking.write(&mut io::stderr().lock(), config.format)?;
+    let mut decrypted;
+    let plaintext = match (plaintext, ranking.best()) {
+        (Some(plaintext), Some(_)) => plaintext,
+        (None, Some(best)) => {
+            let cipher = ccipher::CaesarCipher::new(i32::from(best.shift));
+            decrypted = ciphertext;
+            cipher.apply_cipher_in_place(&mut decrypted);
+            &decrypted
+        }
+        (_, None) => {
+            return Err(io::Error::new(
+                io::ErrorKind::NotFound,
+                "unable to find candidate key",
+            ))
         }
-        None => println!("unable to find candidate key"),
+    };
+    ccipher_io::write_output_bytes(&config.output_file, plaintext)
+}
+
+/// Returns the crib of the crib attack.
+fn crib(config: &Config) -> io::Result<&[u8]> {
+    config
+        .crib
+        .as_deref()
+        .map(str::as_bytes)
+        .ok_or_else(|| io::Error::new(io::ErrorKind::InvalidInput, "the crib attack needs a crib"))
+}
+
+/// Ranks the keys of alphabet `A` with the configured attack and, in decrypt mode, decrypts
+/// `ciphertext` with the best one.
+fn run_alphabet<A: Alphabet>(config: &Config, mut ciphertext: Vec<u8>) -> io::Result<()> {
+    let ranking = match config.attack_type {
+        Attack::Dictionary => {
+            let dictionary = Dictionary::popular_english();
+            let mut scratch = DictScratch::new();
+            rank_alphabet_dict_attack::<A>(&ciphertext, &dictionary, config.top, &mut scratch)
+        }
+        Attack::Frequency => rank_alphabet_freq_attack::<A>(&ciphertext, config.top, config.metric),
+        Attack::Ngram => rank_alphabet_ngram_attack::<A>(&ciphertext, config.top),
+        Attack::Crib => rank_alphabet_crib_attack::<A>(&ciphertext, crib(config)?, config.top),
+    };
+    if !config.decrypt {
+        return ranking.write(&mut io::stdout().lock(), config.format);
+    }
+
+    ranking.write(&mut io::stderr().lock(), config.format)?;
+    let best = ranking
+        .best()
+        .ok_or_else(|| io::Error::new(io::ErrorKind::NotFound, "unable to find candidate key"))?;
+    ccipher::ShiftCipher::new(best.shift.into(), A::default())
+        .apply_cipher_in_place(&mut ciphertext);
+    ccipher_io::write_output_bytes(&config.output_file, &ciphertext)
+}
+
+/// Recovers the Vigenère key of `ciphertext` over alphabet `A` and, in decrypt mode,
+/// decrypts it.
+fn run_vigenere<A: Alphabet>(
+    config: &Config,
+    mut ciphertext: Vec<u8>,
+    max_period: usize,
+) -> io::Result<()> {
+    let pool = ccipher_io::WorkStealingPool::with_available_parallelism();
+    let key = crack_vigenere::<A>(&ciphertext, max_period, config.metric, &pool);
+    let Some(key) = key else {
+        if !config.decrypt {
+            return writeln!(io::stdout().lock(), "unable to find candidate key");
+        }
+        return Err(io::Error::new(
+            io::ErrorKind::NotFound,
+            "unable to find candidate key",
+        ));
+    };
+    if !config.decrypt {
+        return key.write(&mut io::stdout().lock(), config.format);
+    }
+
+    key.write(&mut io::stderr().lock(), config.format)?;
+    let shifts: Vec<i32> = key.shifts.iter().map(|&shift| shift.into()).collect();
+    ccipher::VigenereCipher::with_alphabet(&shifts, A::default())
+        .apply_cipher_in_place(&mut ciphertext);
+    ccipher_io::write_output_bytes(&config.output_file, &ciphertext)
+}
+
+/// Ranks the affine keys of `ciphertext` and, in decrypt mode, decrypts it with the best one.
+fn run_affine(config: &Config, mut ciphertext: Vec<u8>) -> io::Result<()> {
+    let pool = ccipher_io::WorkStealingPool::with_available_parallelism();
+    let ranking = rank_ascii_affine_attack(&ciphertext, config.top, config.metric, &pool);
+    if !config.decrypt {
+        return ranking.write(&mut io::stdout().lock(), config.format);
     }
 
-    Ok(())
+    ranking.write(&mut io::stderr().lock(), config.format)?;
+    let best = ranking
+        .best()
+        .ok_or_else(|| io::Error::new(io::ErrorKind::NotFound, "unable to find candidate key"))?;
+    ccipher::AffineCipher::new(best.multiplier.into(), best.shift.into())
+        .apply_cipher_in_place(&mut ciphertext);
+    ccipher_io::write_output_bytes(&config.output_file, &ciphertext)
+}
+
+/// Cracks every file below `root` and reports the manifest. Files that cannot be read are
+/// reported on stderr and fail the run once all other files have been reported.
+fn run_tree(config: &Config, root: &std::path::Path) -> io::Result<()> {
+    let cracker = TreeCracker::new(
+        config.attack_type.clone(),
+        config.metric,
+        config.crib.as_deref().map(str::as_bytes),
+    );
+    let pool = ccipher_io::WorkStealingPool::with_available_parallelism();
+    let mut reports = Vec::new();
+    let mut failures = 0;
+    for report in cracker.crack(root, &pool)? {
+        match report {
+            Ok(report) => reports.push(report),
+            Err(e) => {
+                eprintln!("error: {e}");
+                failures += 1;
+            }
+        }
+    }
+
+    write_manifest(&reports, &mut io::stdout().lock(), config.format)?;
+    match failures {
+        0 => Ok(()),
+        _ => Err(io::Error::other(format!(
+            "{failures} files could not be read"
+        ))),
+    }
+}
+
+/// Streams the key of every line and, in decrypt mode, the decrypted lines.
+fn run_per_line(config: &Config) -> io::Result<()> {
+    let input = ccipher_io::open_input(&config.ciphertext_file)?;
+    if !config.decrypt {
+        return crack_lines(input, &mut io::stdout().lock(), None, config.format);
+    }
+
+    let mut plaintext = ccipher_io::open_output(&config.output_file)?;
+    crack_lines(
+        input,
+        &mut io::stderr().lock(),
+        Some(&mut plaintext),
+        config.format,
+    )?;
+    plaintext.flush()
+}
+
+/// Reports the key of a ciphertext as soon as it is known and, in decrypt mode, streams the
+/// plaintext from then on.
+fn run_stream(config: &Config, confidence: f64) -> io::Result<()> {
+    let input = ccipher_io::open_input(&config.ciphertext_file)?;
+    if !config.decrypt {
+        crack_stream(
+            input,
+            &mut io::stdout().lock(),
+            None,
+            config.top,
+            confidence,
+            config.verify,
+            config.format,
+        )?;
+        return Ok(());
+    }
+
+    let mut plaintext = ccipher_io::open_output(&config.output_file)?;
+    let key = crack_stream(
+        input,
+        &mut io::stderr().lock(),
+        Some(&mut plaintext),
+        config.top,
+        confidence,
+        config.verify,
+        config.format,
+    )?;
+    plaintext.flush()?;
+    match key {
+        Some(_) => Ok(()),
+        None => Err(io::Error::new(
+            io::ErrorKind::NotFound,
+            "unable to find candidate key",
+        )),
+    }
+}
+
+/// Reports the keys of the segments of a mixed-key ciphertext and, in decrypt mode, writes
+/// the plaintext with every segment decrypted under its own key.
+fn run_segmentation(config: &Config, ciphertext: &[u8], window: usize) -> io::Result<()> {
+    let segments = segment_ascii(ciphertext, window);
+    if !config.decrypt {
+        return write_segments(&segments, &mut io::stdout().lock(), config.format);
+    }
+
+    write_segments(&segments, &mut io::stderr().lock(), config.format)?;
+    if segments.is_empty() {
+        return Err(io::Error::new(
+            io::ErrorKind::NotFound,
+            "unable to find candidate key",
+        ));
+    }
+    let mut plaintext = vec![0; ciphertext.len()];
+    for segment in &segments {
+        let range = segment.offset..segment.offset + segment.len;
+        ccipher::CaesarCipher::new(i32::from(segment.shift))
+            .apply_cipher_bytes(&ciphertext[range.clone()], &mut plaintext[range]);
+    }
+    ccipher_io::write_output_bytes(&config.output_file, &plaintext)
+}
+
+#[cfg(test)]
+mod counting_allocator {
+    //! A global allocator for tests that counts the allocations made by each thread.
+    use std::alloc::{GlobalAlloc, Layout, System};
+    use std::cell::Cell;
+
+    thread_local! {
+        static ALLOCATIONS: Cell<usize> = const { Cell::new(0) };
+    }
+
+    struct CountingAllocator;
+
+    unsafe impl GlobalAlloc for CountingAllocator {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            let _ = ALLOCATIONS.try_with(|count| count.set(count.get() + 1));
+            System.alloc(layout)
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            System.dealloc(ptr, layout)
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+            let _ = ALLOCATIONS.try_with(|count| count.set(count.get() + 1));
+            System.realloc(ptr, layout, new_size)
+        }
+    }
+
+    #[global_allocator]
+    static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+    /// Returns the number of allocations made so far by the calling thread.
+    pub fn allocations() -> usize {
+        ALLOCATIONS.with(Cell::get)
+    }
 }
 
 #[cfg(test)]
@@ -337,6 +999,195 @@ mod tests {
         assert_eq!(shift, None);
     }
 
+    #[test]
+    fn rank_ascii_dict_attack_returns_winning_key_first() {
+        let dictionary = create_test_dictionary();
+        // "the fox" shifted by 3
+        let ciphertext = "wkh#ir{";
+        let ranking = rank_ascii_dict_attack(ciphertext, &dictionary, 5);
+
+        assert_eq!(ranking.best().map(|c| c.shift), Some(125));
+        assert_eq!(ranking.candidates[0].score, 2.0);
+        assert!(ranking.candidates.iter().all(|c| c.score > 0.0));
+        assert!(ranking.confidence > 0.0);
+    }
+
+    #[test]
+    fn rank_ascii_freq_attack_returns_k_candidates_in_order() {
+        let ciphertext = ccipher::CaesarCipher::new(7).apply_cipher("the rain in spain stays");
+        let ranking = rank_ascii_freq_attack(&ciphertext, 4);
+
+        assert_eq!(ranking.candidates.len(), 4);
+        assert_eq!(
+            ranking.best().map(|c| c.shift),
+            Some(apply_ascii_freq_attack(&ciphertext))
+        );
+        assert!(ranking
+            .candidates
+            .windows(2)
+            .all(|pair| pair[0].score <= pair[1].score));
+    }
+
+    #[test]
+    fn ascii_freq_scores_does_not_allocate_with_l1() {
+        let ciphertext = ccipher::CaesarCipher::new(9).apply_cipher("integer scoring stays exact");
+        // The first call initializes the reference tables.
+        ascii_freq_scores(ciphertext.as_bytes(), Metric::L1);
+
+        let before = counting_allocator::allocations();
+        let scores = ascii_freq_scores(ciphertext.as_bytes(), Metric::L1);
+        let after = counting_allocator::allocations();
+
+        assert_eq!(after - before, 0);
+        let best = Ranking::from_scores(&scores, 1, ScoreOrder::LowerIsBetter, |_| true);
+        assert_eq!(best.best().map(|c| c.shift), Some(119));
+    }
+
+    #[test]
+    fn rank_ascii_dict_attack_with_plaintext_returns_winning_plaintext() {
+        let dictionary = create_test_dictionary();
+        let ciphertext = "ifmmp!xpsme";
+        let (ranking, plaintext) =
+            rank_ascii_dict_attack_with_plaintext(ciphertext, &dictionary, 1);
+
+        assert_eq!(ranking.best().map(|c| c.shift), Some(127));
+        assert_eq!(plaintext.as_deref(), Some("hello world"));
+    }
+
+    #[test]
+    fn rank_ascii_dict_attack_with_plaintext_returns_none_when_no_matching_words() {
+        let dictionary = create_test_dictionary();
+        let (ranking, plaintext) =
+            rank_ascii_dict_attack_with_plaintext("xyz123 abc456", &dictionary, 1);
+
+        assert!(ranking.candidates.is_empty());
+        assert_eq!(plaintext, None);
+    }
+
+    #[test]
+    fn rank_ascii_dict_attack_bytes_matches_str_attack() {
+        let words = create_test_dictionary();
+        let dictionary = Dictionary::from_words(words.iter().map(String::as_str));
+        let mut scratch = DictScratch::new();
+        for ciphertext in [
+            "ifmmp!xpsme",
+            "wkh#ir{",
+            "xyz123 abc456",
+            "",
+            "\u{3}hello 世界",
+        ] {
+            let expected = rank_ascii_dict_attack(ciphertext, &words, 3);
+            let ranking =
+                rank_ascii_dict_attack_bytes(ciphertext.as_bytes(), &dictionary, 3, &mut scratch);
+            assert_eq!(ranking, expected);
+        }
+    }
+
+    #[test]
+    fn ascii_dict_scores_keeps_exact_top_counts_when_pruning() {
+        let dictionary = Dictionary::popular_english();
+        let text = "it was the best of times it was the worst of times \
+                    it was the age of wisdom it was the age of foolishness";
+        let ciphertext = ccipher::CaesarCipher::new(3)
+            .apply_cipher(text)
+            .into_bytes();
+
+        // Count every shift without pruning.
+        let mut exact = [0u32; ASCII_ALPHABET_LEN as usize];
+        for shift in 0..ASCII_ALPHABET_LEN {
+            let mut plaintext = vec![0; ciphertext.len()];
+            ccipher::CaesarCipher::new(i32::from(shift))
+                .apply_cipher_bytes(&ciphertext, &mut plaintext);
+            exact[usize::from(shift)] = plaintext
+                .split(|&byte| is_word_separator(byte))
+                .filter(|word| dictionary.contains(word))
+                .count() as u32;
+        }
+
+        for k in [1, 2, 5, 128] {
+            let mut scratch = DictScratch::new();
+            let counts = ascii_dict_scores(&ciphertext, &dictionary, k, &mut scratch);
+            assert_eq!(rank_dict_counts(&counts, k), rank_dict_counts(&exact, k));
+            assert_eq!(scratch.best_plaintext(), text.as_bytes());
+        }
+    }
+
+    #[test]
+    fn rank_ascii_dict_attack_bytes_does_not_allocate_while_scoring() {
+        let dictionary = Dictionary::popular_english();
+        let ciphertext = ccipher::CaesarCipher::new(42)
+            .apply_cipher("the quick brown fox jumps over the lazy dog")
+            .into_bytes();
+        let mut scratch = DictScratch::new();
+        // The first call sizes the scratch buffers; later calls must reuse them.
+        ascii_dict_scores(&ciphertext, &dictionary, 1, &mut scratch);
+
+        let before = counting_allocator::allocations();
+        let counts = ascii_dict_scores(&ciphertext, &dictionary, 1, &mut scratch);
+        let after = counting_allocator::allocations();
+
+        assert_eq!(after - before, 0);
+        assert_eq!(counts[86], 9);
+        assert_eq!(
+            scratch.best_plaintext(),
+            b"the quick brown fox jumps over the lazy dog"
+        );
+    }
+
+    #[test]
+    fn rank_ascii_ngram_attack_cracks_short_messages_under_every_shift() {
+        let messages = [
+            "Meet me at noon.",
+            "the cat sat on the warm mat",
+            "Send more money, the deal is off!",
+            "We leave at dawn; bring the maps and the lamp.",
+            "I could not find the key you left under the blue stone by the gate.",
+            "Please call your sister when you get home, she has been worried all week about you.",
+        ];
+        for message in messages {
+            for key in 0..i32::from(ASCII_ALPHABET_LEN) {
+                let ciphertext = ccipher::CaesarCipher::new(key).apply_cipher(message);
+                let ranking = rank_ascii_ngram_attack(ciphertext.as_bytes(), 1);
+
+                let expected = (-key).rem_euclid(ASCII_ALPHABET_LEN.into()) as u8;
+                assert_eq!(
+                    ranking.best().map(|c| c.shift),
+                    Some(expected),
+                    "{message:?} under key {key}"
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn rank_ascii_ngram_attack_returns_no_candidates_without_ngrams() {
+        assert_eq!(rank_ascii_ngram_attack(b"", 3), Ranking::default());
+        assert_eq!(rank_ascii_ngram_attack(b"x", 3), Ranking::default());
+    }
+
+    #[test]
+    fn rank_ascii_crib_attack_finds_every_key() {
+        let message = "Content-Type: text/plain; charset=utf-8";
+        for key in 0..i32::from(ASCII_ALPHABET_LEN) {
+            let ciphertext = ccipher::CaesarCipher::new(key).apply_cipher(message);
+            let ranking = rank_ascii_crib_attack(ciphertext.as_bytes(), b"Content-Type:", 2);
+
+            let expected = (-key).rem_euclid(ASCII_ALPHABET_LEN.into()) as u8;
+            assert_eq!(ranking.candidates.len(), 1, "key {key}");
+            assert_eq!(ranking.best().map(|c| c.shift), Some(expected));
+            assert_eq!(ranking.confidence, 1.0);
+        }
+    }
+
+    #[test]
+    fn rank_ascii_crib_attack_returns_no_candidates_without_occurrences() {
+        let ciphertext = ccipher::CaesarCipher::new(3).apply_cipher("no header here");
+        assert_eq!(
+            rank_ascii_crib_attack(ciphertext.as_bytes(), b"HTTP/1.1", 3),
+            Ranking::default()
+        );
+    }
+
     #[test]
     fn get_freq_distribution_returns_zeroes_on_empty_char_counter() {
         let char_counter = BTreeMap::new();
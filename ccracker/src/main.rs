@@ -3,7 +3,12 @@ use clap::Parser;
 #[derive(Parser, Debug)]
 #[command(version, about, long_about = None)]
 struct Args {
-    #[arg(short = 'i', long, help = "file containing ciphertext")]
+    #[arg(
+        short = 'i',
+        long,
+        conflicts_with = "recursive",
+        help = "file containing ciphertext"
+    )]
     ciphertext_file: Option<std::path::PathBuf>,
 
     #[arg(
@@ -14,11 +19,162 @@ struct Args {
         help = "attack type"
     )]
     attack: ccracker::Attack,
+
+    #[arg(
+        short = 't',
+        long,
+        default_value_t = 1,
+        value_parser = clap::value_parser!(u8).range(1..=128),
+        help = "number of candidate keys to report"
+    )]
+    top: u8,
+
+    #[arg(
+        short = 'f',
+        long,
+        value_enum,
+        default_value_t = ccracker::Format::Text,
+        help = "output format"
+    )]
+    format: ccracker::Format,
+
+    #[arg(
+        short = 'm',
+        long,
+        value_enum,
+        default_value_t = ccracker::Metric::L1,
+        help = "distance metric of the frequency attack"
+    )]
+    metric: ccracker::Metric,
+
+    #[arg(
+        short = 'c',
+        long,
+        required_if_eq("attack", "crib"),
+        help = "known plaintext fragment searched for by the crib attack"
+    )]
+    crib: Option<String>,
+
+    #[arg(
+        short = 's',
+        long,
+        value_name = "WINDOW",
+        num_args = 0..=1,
+        default_missing_value = "64",
+        value_parser = clap::value_parser!(u32).range(1..),
+        conflicts_with_all = ["attack", "top", "metric", "per_line", "stream"],
+        help = "split mixed-key ciphertext into segments using a sliding window of WINDOW bytes [default: 64]"
+    )]
+    segment: Option<u32>,
+
+    #[arg(
+        short = 'l',
+        long,
+        conflicts_with_all = ["attack", "top", "metric", "stream"],
+        help = "crack every line on its own, reusing the keys of recent lines when they fit"
+    )]
+    per_line: bool,
+
+    #[arg(
+        long,
+        value_name = "CONFIDENCE",
+        num_args = 0..=1,
+        default_missing_value = "0.5",
+        value_parser = parse_confidence,
+        conflicts_with_all = ["attack", "metric"],
+        help = "report the key as soon as its confidence reaches CONFIDENCE, before the end of the input [default: 0.5]"
+    )]
+    stream: Option<f64>,
+
+    #[arg(
+        long,
+        requires = "stream",
+        help = "keep verifying the streamed key and report when it changes (requires --stream)"
+    )]
+    verify: bool,
+
+    #[arg(
+        short = 'r',
+        long,
+        value_name = "DIR",
+        conflicts_with_all = ["top", "segment", "per_line", "stream", "decrypt"],
+        help = "crack every file below DIR in parallel and report a manifest of their keys"
+    )]
+    recursive: Option<std::path::PathBuf>,
+
+    #[arg(
+        long,
+        conflicts_with_all = ["attack", "segment", "per_line", "stream", "recursive"],
+        help = "search all 8192 affine keys a*x+b with frequency analysis"
+    )]
+    affine: bool,
+
+    #[arg(
+        long,
+        value_enum,
+        default_value_t = ccipher::AlphabetKind::Ascii128,
+        conflicts_with_all = ["segment", "per_line", "stream", "recursive", "affine"],
+        help = "alphabet of the cipher, which sets the keys that are tried"
+    )]
+    alphabet: ccipher::AlphabetKind,
+
+    #[arg(
+        long,
+        value_name = "MAX_PERIOD",
+        num_args = 0..=1,
+        value_parser = clap::value_parser!(u32).range(1..),
+        conflicts_with_all = ["attack", "top", "crib", "segment", "per_line", "stream", "recursive", "affine"],
+        help = format!(
+            "crack a Vigenere cipher with a repeating key of up to MAX_PERIOD shifts [default: {}]",
+            ccracker::DEFAULT_MAX_PERIOD
+        )
+    )]
+    vigenere: Option<Option<u32>>,
+
+    #[arg(
+        short = 'd',
+        long,
+        help = "decrypt the ciphertext with the best candidate key"
+    )]
+    decrypt: bool,
+
+    #[arg(
+        short = 'o',
+        long,
+        requires = "decrypt",
+        help = "output plaintext file (requires --decrypt)"
+    )]
+    output_file: Option<std::path::PathBuf>,
+}
+
+fn parse_confidence(value: &str) -> Result<f64, String> {
+    match value.parse::<f64>() {
+        Ok(confidence) if (0.0..=1.0).contains(&confidence) => Ok(confidence),
+        _ => Err(format!("{value} is not a number between 0 and 1")),
+    }
 }
 
 fn main() {
     let args = Args::parse();
-    let config = ccracker::Config::new(args.ciphertext_file, args.attack);
+    let config = ccracker::Config {
+        top: args.top.into(),
+        format: args.format,
+        metric: args.metric,
+        crib: args.crib,
+        segment_window: args.segment.map(|window| window as usize),
+        per_line: args.per_line,
+        stream_confidence: args.stream,
+        verify: args.verify,
+        recursive: args.recursive,
+        affine: args.affine,
+        alphabet: args.alphabet,
+        vigenere_max_period: args
+            .vigenere
+            .map(|period| period.map_or(ccracker::DEFAULT_MAX_PERIOD, |period| period as usize)),
+        decrypt: args.decrypt,
+        output_file: args.output_file,
+        ..ccracker::Config::new(args.ciphertext_file, args.attack)
+    };
 
     if let Err(e) = ccracker::run(&config) {
         eprintln!("error: {}", e);
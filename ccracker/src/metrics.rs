@@ -0,0 +1,404 @@
+//! Distance and similarity metrics between character distributions.
+//!
+//! Every metric compares a shift's distribution with the reference English distribution
+//! ([`crate::FREQUENCY_TABLE`]) as a reduction over two `[f32; 128]` arrays. The reductions
+//! keep [`ACCUMULATORS`] independent partial sums so the compiler can keep them in vector
+//! registers instead of serializing on a single floating-point accumulator.
+//!
+//! The L1 distance also has an integer form, [`l1_distances`], which scores raw histograms
+//! against fixed-point reference weights without any normalization or division.
+use crate::lanes::LANES;
+use crate::ranking::ScoreOrder;
+use clap::ValueEnum;
+use std::sync::LazyLock;
+
+/// Number of independent partial sums kept by the reductions.
+const ACCUMULATORS: usize = 8;
+
+/// Probability assigned to characters that never occur in the reference distribution, so
+/// the metrics that divide by or take the logarithm of it stay finite.
+const REFERENCE_FLOOR: f32 = 1e-6;
+
+/// Bits of precision of the fixed-point reference weights used by [`l1_distances`].
+const WEIGHT_BITS: i32 = 20;
+
+/// Largest histogram total that [`l1_distances`] scores without scaling the histogram down.
+/// The reference weights sum to less than `2^(WEIGHT_BITS + 1)`, so every distance stays
+/// below `2 * L1_MAX_TOTAL * 2^(WEIGHT_BITS + 1) = 2^63`.
+const L1_MAX_TOTAL: u64 = 1 << (61 - WEIGHT_BITS);
+
+/// Bits of precision of the fixed-point penalties returned by [`penalties`].
+const PENALTY_BITS: i32 = 16;
+
+/// Metric used by the frequency attack to compare a shift's character distribution with
+/// typical English text.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq, ValueEnum)]
+pub enum Metric {
+    /// Sum of absolute differences (lower is better).
+    #[default]
+    L1,
+    /// Pearson's chi-squared statistic against the reference frequencies (lower is better).
+    ChiSquared,
+    /// Kullback-Leibler divergence from the reference distribution (lower is better).
+    Kl,
+    /// Cosine similarity with the reference distribution (higher is better).
+    Cosine,
+}
+
+impl Metric {
+    /// Returns whether the metric's scores improve as they grow or shrink.
+    pub fn order(self) -> ScoreOrder {
+        match self {
+            Metric::L1 | Metric::ChiSquared | Metric::Kl => ScoreOrder::LowerIsBetter,
+            Metric::Cosine => ScoreOrder::HigherIsBetter,
+        }
+    }
+
+    /// Scores the character distribution of the ciphertext under every shift.
+    ///
+    /// `distribution` is the distribution of the ciphertext itself. The returned table is
+    /// indexed by shift. Shifting the text rotates its distribution, so the distribution
+    /// under shift `s` is read as a window of the doubled ciphertext distribution rather
+    /// than counted again, and terms that do not depend on the shift are computed once.
+    pub(crate) fn scores(self, distribution: &[f32; LANES]) -> [f32; LANES] {
+        let reference = &*REFERENCE;
+        let doubled: [f32; 2 * LANES] = std::array::from_fn(|i| distribution[i % LANES]);
+        let rotated = |shift: usize| -> &[f32; LANES] {
+            doubled[LANES - shift..2 * LANES - shift]
+                .try_into()
+                .expect("window is LANES values long")
+        };
+
+        match self {
+            Metric::L1 => std::array::from_fn(|shift| {
+                reduce(&reference.probability, rotated(shift), |p, q| (q - p).abs())
+            }),
+            // Multiplying by the precomputed 1 / p avoids a division per element.
+            Metric::ChiSquared => std::array::from_fn(|shift| {
+                reduce3(
+                    &reference.probability,
+                    &reference.inverse,
+                    rotated(shift),
+                    |p, inverse, q| (q - p) * (q - p) * inverse,
+                )
+            }),
+            Metric::Kl => {
+                let entropy = reduce(distribution, distribution, |q, _| {
+                    if q > 0.0 {
+                        q * q.ln()
+                    } else {
+                        0.0
+                    }
+                });
+                std::array::from_fn(|shift| {
+                    entropy - reduce(&reference.log, rotated(shift), |log_p, q| q * log_p)
+                })
+            }
+            Metric::Cosine => {
+                let norm = reduce(distribution, distribution, |q, _| q * q).sqrt() * reference.norm;
+                std::array::from_fn(|shift| {
+                    let dot = reduce(&reference.probability, rotated(shift), |p, q| p * q);
+                    if norm == 0.0 {
+                        0.0
+                    } else {
+                        dot / norm
+                    }
+                })
+            }
+        }
+    }
+}
+
+impl Metric {
+    /// Scores a single distribution against a reference distribution over the same symbols.
+    ///
+    /// This is the scalar form of [`Metric::scores`] for alphabets other than ASCII, whose
+    /// reference is derived from [`crate::FREQUENCY_TABLE`] by the caller.
+    pub(crate) fn score(self, reference: &[f32], distribution: &[f32]) -> f32 {
+        let pairs = reference.iter().zip(distribution);
+        match self {
+            Metric::L1 => pairs.map(|(p, q)| (q - p).abs()).sum(),
+            Metric::ChiSquared => pairs
+                .map(|(p, q)| (q - p) * (q - p) / p.max(REFERENCE_FLOOR))
+                .sum(),
+            Metric::Kl => pairs
+                .filter(|(_, &q)| q > 0.0)
+                .map(|(p, q)| q * (q.ln() - p.max(REFERENCE_FLOOR).ln()))
+                .sum(),
+            Metric::Cosine => {
+                let norm = |values: &[f32]| values.iter().map(|v| v * v).sum::<f32>().sqrt();
+                let norm = norm(reference) * norm(distribution);
+                let dot: f32 = pairs.map(|(p, q)| p * q).sum();
+                if norm == 0.0 {
+                    0.0
+                } else {
+                    dot / norm
+                }
+            }
+        }
+    }
+}
+
+/// The reference distribution along with the derived tables the metrics need.
+struct Reference {
+    probability: [f32; LANES],
+    /// `1 / p`, with `p` floored at [`REFERENCE_FLOOR`].
+    inverse: [f32; LANES],
+    /// `ln p`, with `p` floored at [`REFERENCE_FLOOR`].
+    log: [f32; LANES],
+    /// Euclidean norm of `probability`.
+    norm: f32,
+    /// `p` in fixed point with [`WEIGHT_BITS`] fractional bits.
+    weights: [u32; LANES],
+    /// Sum of `weights`, i.e. the fixed-point total probability.
+    weight_total: u64,
+    /// `-ln p` in fixed point with [`PENALTY_BITS`] fractional bits, with `p` floored at
+    /// [`REFERENCE_FLOOR`].
+    penalties: [u32; LANES],
+}
+
+static REFERENCE: LazyLock<Reference> = LazyLock::new(|| {
+    let mut probability = [0.0; LANES];
+    for (p, line) in probability.iter_mut().zip(crate::FREQUENCY_TABLE.lines()) {
+        *p = line.parse().expect("frequency table holds numbers");
+    }
+    let floored = probability.map(|p: f32| p.max(REFERENCE_FLOOR));
+    // Parsing decimal text and scaling by a power of two are both exact in f64, so the
+    // weights are the same on every platform.
+    let mut weights = [0; LANES];
+    for (weight, line) in weights.iter_mut().zip(crate::FREQUENCY_TABLE.lines()) {
+        let p: f64 = line.parse().expect("frequency table holds numbers");
+        *weight = (p * 2f64.powi(WEIGHT_BITS)).round() as u32;
+    }
+    Reference {
+        probability,
+        inverse: floored.map(|p| 1.0 / p),
+        log: floored.map(f32::ln),
+        norm: probability.iter().map(|p| p * p).sum::<f32>().sqrt(),
+        weights,
+        weight_total: weights.iter().map(|&weight| u64::from(weight)).sum(),
+        penalties: floored.map(|p| (-f64::from(p).ln() * 2f64.powi(PENALTY_BITS)).round() as u32),
+    }
+});
+
+/// Returns the fixed-point negative log-probability of each character in English text.
+///
+/// Summing the penalties of a text's characters gives its cross-entropy against the
+/// reference distribution, which ranks shifts like [`Metric::Kl`] does. Unlike a distance
+/// between normalized distributions the sum is linear in the histogram, so it can be
+/// updated byte by byte.
+pub(crate) fn penalties() -> &'static [u32; LANES] {
+    &REFERENCE.penalties
+}
+
+/// Returns the probability of each ASCII character in English text.
+pub(crate) fn probabilities() -> &'static [f32; LANES] {
+    &REFERENCE.probability
+}
+
+/// Returns the fixed-point reference weights used by [`l1_distances`] along with their sum.
+pub(crate) fn l1_weights() -> (&'static [u32; LANES], u64) {
+    (&REFERENCE.weights, REFERENCE.weight_total)
+}
+
+/// Computes the L1 distance between the reference distribution and the ciphertext's
+/// distribution under every shift, using integer arithmetic only.
+///
+/// `counts` is the histogram of the ciphertext's ASCII bytes. Comparing `counts[c] / n` with
+/// `weights[c] / W` is the same as comparing `counts[c] * W` with `weights[c] * n`, so each
+/// distance is returned multiplied by `n * W`, which is returned alongside the table. The
+/// histogram is first passed through [`l1_counts`], so `u64` accumulators never overflow and
+/// the results are bit-exact on every platform.
+pub(crate) fn l1_distances(counts: &[u64; LANES]) -> ([u64; LANES], u64) {
+    let reference = &*REFERENCE;
+    debug_assert!(reference.weight_total < 2 << WEIGHT_BITS);
+    let counts = l1_counts(counts);
+    let total: u64 = counts.iter().sum();
+
+    let expected = reference.weights.map(|weight| u64::from(weight) * total);
+    let observed: [u64; 2 * LANES] =
+        std::array::from_fn(|c| counts[c % LANES] * reference.weight_total);
+    let distances = std::array::from_fn(|shift| {
+        observed[LANES - shift..2 * LANES - shift]
+            .iter()
+            .zip(&expected)
+            .map(|(&observed, &expected)| observed.abs_diff(expected))
+            .sum()
+    });
+
+    (distances, total * reference.weight_total)
+}
+
+/// Halves a histogram until it holds at most [`L1_MAX_TOTAL`] bytes, the most the integer
+/// L1 distance can score without overflowing. Only inputs of terabytes are scaled, and their
+/// distribution changes by a negligible fraction.
+pub(crate) fn l1_counts(counts: &[u64; LANES]) -> [u64; LANES] {
+    let mut counts = *counts;
+    while counts
+        .iter()
+        .fold(0u64, |total, &count| total.saturating_add(count))
+        > L1_MAX_TOTAL
+    {
+        counts = counts.map(|count| count >> 1);
+    }
+    counts
+}
+
+/// Sums `f(a[i], b[i])` over both arrays.
+#[inline(always)]
+fn reduce(a: &[f32; LANES], b: &[f32; LANES], f: impl Fn(f32, f32) -> f32) -> f32 {
+    let mut sums = [0.0; ACCUMULATORS];
+    for (a, b) in a
+        .chunks_exact(ACCUMULATORS)
+        .zip(b.chunks_exact(ACCUMULATORS))
+    {
+        for lane in 0..ACCUMULATORS {
+            sums[lane] += f(a[lane], b[lane]);
+        }
+    }
+    sums.iter().sum()
+}
+
+/// Sums `f(a[i], b[i], c[i])` over all three arrays.
+#[inline(always)]
+fn reduce3(
+    a: &[f32; LANES],
+    b: &[f32; LANES],
+    c: &[f32; LANES],
+    f: impl Fn(f32, f32, f32) -> f32,
+) -> f32 {
+    let mut sums = [0.0; ACCUMULATORS];
+    let chunks = a
+        .chunks_exact(ACCUMULATORS)
+        .zip(b.chunks_exact(ACCUMULATORS))
+        .zip(c.chunks_exact(ACCUMULATORS));
+    for ((a, b), c) in chunks {
+        for lane in 0..ACCUMULATORS {
+            sums[lane] += f(a[lane], b[lane], c[lane]);
+        }
+    }
+    sums.iter().sum()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// The distribution of the ASCII bytes of `text`.
+    fn distribution(text: &[u8]) -> [f32; LANES] {
+        let mut counts = [0.0f32; LANES];
+        for &byte in text.iter().filter(|byte| byte.is_ascii()) {
+            counts[usize::from(byte)] += 1.0;
+        }
+        let total: f32 = counts.iter().sum();
+        counts.map(|count| if total == 0.0 { 0.0 } else { count / total })
+    }
+
+    /// Computes a metric of one shift the slow way, straight from its definition.
+    fn expected_score(metric: Metric, text: &[u8], shift: u8) -> f32 {
+        let mut plaintext = vec![0; text.len()];
+        ccipher::CaesarCipher::new(i32::from(shift)).apply_cipher_bytes(text, &mut plaintext);
+        let q = distribution(&plaintext);
+        let p = &REFERENCE.probability;
+        let floored = |p: f32| p.max(REFERENCE_FLOOR);
+        let pairs = p.iter().zip(q.iter());
+        match metric {
+            Metric::L1 => pairs.map(|(p, q)| (q - p).abs()).sum(),
+            Metric::ChiSquared => pairs.map(|(p, q)| (q - p).powi(2) / floored(*p)).sum(),
+            Metric::Kl => pairs
+                .filter(|(_, &q)| q > 0.0)
+                .map(|(p, q)| q * (q / floored(*p)).ln())
+                .sum(),
+            Metric::Cosine => {
+                let dot: f32 = pairs.map(|(p, q)| p * q).sum();
+                let norm = |v: &[f32; LANES]| v.iter().map(|x| x * x).sum::<f32>().sqrt();
+                dot / (norm(p) * norm(&q))
+            }
+        }
+    }
+
+    #[test]
+    fn scores_match_per_shift_definitions() {
+        let text = ccipher::CaesarCipher::new(23).apply_cipher("Four score and seven years ago!");
+        let observed = distribution(text.as_bytes());
+
+        for metric in Metric::value_variants() {
+            let scores = metric.scores(&observed);
+            for shift in 0..LANES as u8 {
+                let expected = expected_score(*metric, text.as_bytes(), shift);
+                let actual = scores[usize::from(shift)];
+                assert!(
+                    (actual - expected).abs() <= 1e-3 * expected.abs().max(1.0),
+                    "{metric:?} shift {shift}: {actual} != {expected}"
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn l1_distances_match_floating_point_l1() {
+        let text = ccipher::CaesarCipher::new(61).apply_cipher("A stitch in time saves nine.");
+        let mut counts = [0; LANES];
+        for &byte in text.as_bytes() {
+            counts[usize::from(byte)] += 1;
+        }
+        let (distances, scale) = l1_distances(&counts);
+        let scores = Metric::L1.scores(&distribution(text.as_bytes()));
+
+        assert_eq!(scale, text.len() as u64 * REFERENCE.weight_total);
+        for (distance, score) in distances.iter().zip(scores) {
+            let distance = *distance as f64 / scale as f64;
+            assert!(
+                (distance - f64::from(score)).abs() < 1e-4,
+                "{distance} != {score}"
+            );
+        }
+    }
+
+    #[test]
+    fn l1_distances_scale_down_histograms_too_large_to_score_exactly() {
+        let text = ccipher::CaesarCipher::new(61).apply_cipher("A stitch in time saves nine.");
+        let mut counts = [0u64; LANES];
+        for &byte in text.as_bytes() {
+            counts[usize::from(byte)] += 1;
+        }
+        let huge = counts.map(|count| count << 40);
+        assert!(huge.iter().sum::<u64>() > L1_MAX_TOTAL);
+
+        let (distances, scale) = l1_distances(&counts);
+        let (huge_distances, huge_scale) = l1_distances(&huge);
+        assert_eq!(
+            huge_distances.map(|distance| distance as f64 / huge_scale as f64),
+            distances.map(|distance| distance as f64 / scale as f64)
+        );
+    }
+
+    #[test]
+    fn l1_distances_are_zero_for_empty_histogram() {
+        assert_eq!(l1_distances(&[0; LANES]), ([0; LANES], 0));
+    }
+
+    #[test]
+    fn scores_are_finite_for_empty_distribution() {
+        for metric in Metric::value_variants() {
+            assert!(metric
+                .scores(&[0.0; LANES])
+                .iter()
+                .all(|score| score.is_finite()));
+        }
+    }
+
+    #[test]
+    fn every_metric_prefers_english() {
+        let text = b"It was a bright cold day in April, and the clocks were striking thirteen.";
+        let ciphertext =
+            ccipher::CaesarCipher::new(100).apply_cipher(std::str::from_utf8(text).unwrap());
+        let observed = distribution(ciphertext.as_bytes());
+
+        for metric in Metric::value_variants() {
+            let scores = metric.scores(&observed).map(f64::from);
+            let ranking = crate::Ranking::from_scores(&scores, 1, metric.order(), |_| true);
+            assert_eq!(ranking.best().map(|c| c.shift), Some(28), "{metric:?}");
+        }
+    }
+}
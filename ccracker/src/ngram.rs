@@ -0,0 +1,235 @@
+//! Bigram and trigram log-likelihood scoring of all 128 shifts.
+//!
+//! Unigram statistics need a few hundred bytes before the distribution of a shift looks
+//! like English. Pairs and triples of characters carry much more information per byte, so
+//! summing their log-probabilities separates the right shift from the others on inputs as
+//! short as a sentence.
+//!
+//! The tables are generated by `build.rs` from `datasets/english_corpus.txt`:
+//!
+//! * Bigrams over the full ASCII alphabet, stored by diagonal so that the scores of one
+//!   ciphertext pair under every shift form a contiguous 128-entry window (see
+//!   [`crate::lanes`] for the same trick applied to class tables). Scoring a pair is a
+//!   single vectorizable add of that window into the per-shift totals.
+//! * Trigrams over 28 classes: letters folded to lowercase, whitespace, and everything else.
+//!   Folding keeps the table small (about 86 KiB) while still rewarding English spellings.
+use crate::lanes::LANES;
+
+const ASCII_LEN: usize = LANES;
+
+include!(concat!(env!("OUT_DIR"), "/ngram_tables.rs"));
+
+/// Accumulates the n-gram log-probabilities of a ciphertext under every shift as it is fed
+/// chunk by chunk.
+///
+/// N-grams that span chunks are scored as if the input had arrived at once. N-grams
+/// containing non-ASCII bytes, which no shift changes, are skipped.
+#[derive(Clone, Debug)]
+pub struct NgramScanner {
+    scores: [f32; LANES],
+    ngrams: usize,
+    /// The last two bytes seen, most recent last.
+    previous: [Option<u8>; 2],
+}
+
+impl Default for NgramScanner {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl NgramScanner {
+    pub fn new() -> Self {
+        NgramScanner {
+            scores: [0.0; LANES],
+            ngrams: 0,
+            previous: [None, None],
+        }
+    }
+
+    /// Feeds the next chunk of ciphertext to the scanner.
+    pub fn update(&mut self, chunk: &[u8]) {
+        for &byte in chunk {
+            let byte = byte.is_ascii().then_some(byte);
+            if let (Some(second), Some(third)) = (self.previous[1], byte) {
+                self.add_bigram(second, third);
+                if let Some(first) = self.previous[0] {
+                    self.add_trigram(first, second, third);
+                }
+            }
+            self.previous = [self.previous[1], byte];
+        }
+    }
+
+    /// Returns the number of n-grams scored so far.
+    pub fn ngrams(&self) -> usize {
+        self.ngrams
+    }
+
+    /// Returns the summed log-probabilities of the input seen so far, indexed by shift, or
+    /// `None` if it holds no n-gram yet.
+    pub fn scores(&self) -> Option<&[f32; LANES]> {
+        (self.ngrams > 0).then_some(&self.scores)
+    }
+
+    fn add_bigram(&mut self, first: u8, second: u8) {
+        let diagonal = usize::from(second.wrapping_sub(first) & 0x7f);
+        let start = diagonal * 2 * ASCII_LEN + usize::from(first);
+        let window = &BIGRAM_DIAGONALS[start..start + LANES];
+        for (score, log_p) in self.scores.iter_mut().zip(window) {
+            *score += log_p;
+        }
+        self.ngrams += 1;
+    }
+
+    fn add_trigram(&mut self, first: u8, second: u8, third: u8) {
+        let [first, second, third] = [first, second, third].map(|byte| {
+            let start = usize::from(byte);
+            &CLASS[start..start + LANES]
+        });
+        for shift in 0..LANES {
+            let context = usize::from(first[shift]) * CLASSES + usize::from(second[shift]);
+            self.scores[shift] += TRIGRAMS[context * CLASSES + usize::from(third[shift])];
+        }
+        self.ngrams += 1;
+    }
+}
+
+/// Sums the n-gram log-probabilities of the ciphertext under every shift.
+///
+/// The returned table is indexed by shift. Returns `None` when the ciphertext holds no
+/// n-gram at all.
+pub(crate) fn ngram_scores(ciphertext: &[u8]) -> Option<[f32; LANES]> {
+    let mut scanner = NgramScanner::new();
+    scanner.update(ciphertext);
+    scanner.scores().copied()
+}
+
+/// Returns the mean n-gram log-probability of the ciphertext under a single shift.
+///
+/// This is the per-n-gram form of `ngram_scores(ciphertext)[shift]`, for callers that only
+/// need to check one or two candidate keys. Returns `None` when the ciphertext holds no
+/// n-gram at all.
+pub(crate) fn mean_ngram_score(ciphertext: &[u8], shift: u8) -> Option<f32> {
+    ngram_score(ciphertext, shift).map(|(score, ngrams)| score / ngrams as f32)
+}
+
+/// Returns `ngram_scores(ciphertext)[shift]` along with the number of n-grams scored,
+/// without scoring the other shifts. Returns `None` when the ciphertext holds no n-gram.
+pub(crate) fn ngram_score(ciphertext: &[u8], shift: u8) -> Option<(f32, usize)> {
+    let shift = usize::from(shift);
+    let mut score = 0.0f32;
+    let mut ngrams = 0usize;
+
+    for pair in ciphertext.windows(2) {
+        let (first, second) = (pair[0], pair[1]);
+        if first.is_ascii() && second.is_ascii() {
+            let diagonal = usize::from(second.wrapping_sub(first) & 0x7f);
+            score += BIGRAM_DIAGONALS[diagonal * 2 * ASCII_LEN + usize::from(first) + shift];
+            ngrams += 1;
+        }
+    }
+    for triple in ciphertext.windows(3) {
+        if triple.iter().all(u8::is_ascii) {
+            let class = |byte: u8| usize::from(CLASS[usize::from(byte) + shift]);
+            let context = class(triple[0]) * CLASSES + class(triple[1]);
+            score += TRIGRAMS[context * CLASSES + class(triple[2])];
+            ngrams += 1;
+        }
+    }
+
+    (ngrams > 0).then_some((score, ngrams))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Scores one shift the slow way, straight from the plaintext.
+    fn expected_score(ciphertext: &[u8], shift: u8) -> f32 {
+        let mut plaintext = vec![0; ciphertext.len()];
+        ccipher::CaesarCipher::new(i32::from(shift)).apply_cipher_bytes(ciphertext, &mut plaintext);
+        let bigram = |a: u8, b: u8| {
+            let diagonal = usize::from(b.wrapping_sub(a) & 0x7f);
+            BIGRAM_DIAGONALS[diagonal * 2 * ASCII_LEN + usize::from(a)]
+        };
+        let class = |byte: u8| usize::from(CLASS[usize::from(byte)]);
+        let bigrams: f32 = plaintext
+            .windows(2)
+            .map(|pair| bigram(pair[0], pair[1]))
+            .sum();
+        let trigrams: f32 = plaintext
+            .windows(3)
+            .map(|t| TRIGRAMS[(class(t[0]) * CLASSES + class(t[1])) * CLASSES + class(t[2])])
+            .sum();
+        bigrams + trigrams
+    }
+
+    #[test]
+    fn ngram_scores_match_per_shift_scores() {
+        let ciphertext = ccipher::CaesarCipher::new(45).apply_cipher("Meet me at the old mill.");
+        let scores = ngram_scores(ciphertext.as_bytes()).unwrap();
+
+        for shift in 0..LANES as u8 {
+            let expected = expected_score(ciphertext.as_bytes(), shift);
+            let actual = scores[usize::from(shift)];
+            assert!(
+                (actual - expected).abs() <= 1e-3 * expected.abs(),
+                "shift {shift}: {actual} != {expected}"
+            );
+        }
+    }
+
+    #[test]
+    fn mean_ngram_score_matches_ngram_scores() {
+        let ciphertext = ccipher::CaesarCipher::new(99).apply_cipher("a caf\u{e9} by the sea");
+        let scores = ngram_scores(ciphertext.as_bytes()).unwrap();
+        // 14 ASCII pairs and 12 ASCII triples.
+        let ngrams = 26.0;
+
+        for shift in 0..LANES as u8 {
+            let mean = mean_ngram_score(ciphertext.as_bytes(), shift).unwrap();
+            let expected = scores[usize::from(shift)] / ngrams;
+            assert!(
+                (mean - expected).abs() < 1e-4,
+                "shift {shift}: {mean} != {expected}"
+            );
+        }
+        assert_eq!(mean_ngram_score(b"x", 0), None);
+    }
+
+    #[test]
+    fn update_scores_ngrams_spanning_chunks() {
+        let ciphertext = ccipher::CaesarCipher::new(3).apply_cipher("split across \u{e9}chunks");
+        let mut scanner = NgramScanner::new();
+        for chunk in ciphertext.as_bytes().chunks(1) {
+            scanner.update(chunk);
+        }
+
+        assert_eq!(
+            scanner.scores(),
+            ngram_scores(ciphertext.as_bytes()).as_ref()
+        );
+        // 17 ASCII pairs and 15 ASCII triples.
+        assert_eq!(scanner.ngrams(), 32);
+    }
+
+    #[test]
+    fn ngram_scores_skip_non_ascii_bytes() {
+        assert_eq!(ngram_scores(b""), None);
+        assert_eq!(ngram_scores(b"a"), None);
+        assert_eq!(ngram_scores("\u{e9}a\u{e9}".as_bytes()), None);
+        assert_eq!(ngram_scores("ab\u{e9}".as_bytes()), ngram_scores(b"ab"));
+    }
+
+    #[test]
+    fn tables_hold_log_probabilities() {
+        assert!(BIGRAM_DIAGONALS.iter().all(|&p| p < 0.0 && p.is_finite()));
+        assert!(TRIGRAMS.iter().all(|&p| p < 0.0 && p.is_finite()));
+        // "th" is far more likely than "tq".
+        let bigram = |a: u8, b: u8| {
+            BIGRAM_DIAGONALS[usize::from(b.wrapping_sub(a) & 0x7f) * 2 * ASCII_LEN + usize::from(a)]
+        };
+        assert!(bigram(b't', b'h') > bigram(b't', b'q') + 3.0);
+    }
+}
@@ -0,0 +1,248 @@
+//! Line-by-line cracking of logs whose lines may each carry a different key.
+//!
+//! Consecutive lines usually share a key, so a [`LineCracker`] remembers the keys of recent
+//! lines. A new line is first scored under those keys alone with the mean n-gram
+//! log-probability; a key is accepted when the score is plausible for English. Only when
+//! no remembered key fits does the cracker fall back to scoring all 128 shifts.
+use crate::ngram;
+use crate::ranking::Format;
+use std::io::{self, BufRead, Write};
+
+/// Number of recent keys a [`LineCracker`] remembers.
+pub const KEY_CACHE_LEN: usize = 4;
+
+/// Mean n-gram log-probability above which a remembered key is accepted without a full
+/// search.
+///
+/// English lines of the bundled corpus score above -3.3 under their key 99% of the time,
+/// while no wrong key of a line of eight bytes or more scored above -4.5.
+const PLAUSIBLE_MEAN_SCORE: f32 = -4.0;
+
+/// Cracks lines one at a time, trying the keys of recent lines first.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::LineCracker;
+///
+/// let mut cracker = LineCracker::new();
+/// for line in ["Meet me at noon.", "Bring the maps."] {
+///     let ciphertext = ccipher::CaesarCipher::new(10).apply_cipher(line);
+///     assert_eq!(cracker.crack(ciphertext.as_bytes()), Some(118));
+/// }
+/// // The second line reused the key of the first.
+/// assert_eq!(cracker.cache_hits(), 1);
+/// ```
+#[derive(Clone, Debug, Default)]
+pub struct LineCracker {
+    /// Recently found keys, most recent first.
+    keys: [u8; KEY_CACHE_LEN],
+    len: usize,
+    hits: u64,
+}
+
+impl LineCracker {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Returns the shift that most likely decrypts `line`, or `None` if the line holds
+    /// fewer than two consecutive ASCII bytes.
+    pub fn crack(&mut self, line: &[u8]) -> Option<u8> {
+        for i in 0..self.len {
+            let key = self.keys[i];
+            if ngram::mean_ngram_score(line, key)? >= PLAUSIBLE_MEAN_SCORE {
+                self.hits += 1;
+                self.remember(key);
+                return Some(key);
+            }
+        }
+
+        let scores = ngram::ngram_scores(line)?;
+        let mut best = 0;
+        for (shift, &score) in scores.iter().enumerate() {
+            if score > scores[best] {
+                best = shift;
+            }
+        }
+        self.remember(best as u8);
+        Some(best as u8)
+    }
+
+    /// Returns how many lines were cracked with a remembered key.
+    pub fn cache_hits(&self) -> u64 {
+        self.hits
+    }
+
+    /// Moves `key` to the front of the cache, evicting the least recently used key if the
+    /// cache is full.
+    fn remember(&mut self, key: u8) {
+        let position = self.keys[..self.len]
+            .iter()
+            .position(|&cached| cached == key)
+            .unwrap_or_else(|| {
+                self.len = (self.len + 1).min(KEY_CACHE_LEN);
+                self.len - 1
+            });
+        self.keys.copy_within(..position, 1);
+        self.keys[0] = key;
+    }
+}
+
+/// Cracks every line of `input` and streams the results.
+///
+/// The key of each line is written to `keys` in `format` as soon as the line is cracked:
+/// `line N: candidate key: K` in text format, one JSON object per line, or a TSV row. When
+/// `plaintext` is given, each line is also decrypted under its key and written there with
+/// its original line ending; lines without a candidate key are copied unchanged. Only one
+/// line is held in memory at a time.
+///
+/// # Errors
+///
+/// Returns any error produced while reading the input or writing the results.
+pub fn crack_lines(
+    mut input: impl BufRead,
+    keys: &mut impl Write,
+    mut plaintext: Option<&mut dyn Write>,
+    format: Format,
+) -> io::Result<()> {
+    let mut cracker = LineCracker::new();
+    let mut line = Vec::new();
+    let mut decrypted = Vec::new();
+    if format == Format::Tsv {
+        writeln!(keys, "line\tkey")?;
+    }
+
+    for number in 1.. {
+        line.clear();
+        if input.read_until(b'\n', &mut line)? == 0 {
+            break;
+        }
+        let content_len = line.len() - line_ending_len(&line);
+        let key = cracker.crack(&line[..content_len]);
+        write_line_key(keys, number, key, format)?;
+
+        if let Some(out) = plaintext.as_mut() {
+            match key {
+                Some(key) => {
+                    decrypted.resize(content_len, 0);
+                    ccipher::CaesarCipher::new(i32::from(key))
+                        .apply_cipher_bytes(&line[..content_len], &mut decrypted);
+                    out.write_all(&decrypted)?;
+                    out.write_all(&line[content_len..])?;
+                }
+                None => out.write_all(&line)?,
+            }
+        }
+    }
+    Ok(())
+}
+
+/// Returns the length of the `\n` or `\r\n` ending of a line, if any.
+fn line_ending_len(line: &[u8]) -> usize {
+    match line {
+        [.., b'\r', b'\n'] => 2,
+        [.., b'\n'] => 1,
+        _ => 0,
+    }
+}
+
+fn write_line_key(
+    out: &mut impl Write,
+    number: u64,
+    key: Option<u8>,
+    format: Format,
+) -> io::Result<()> {
+    match (format, key) {
+        (Format::Text, Some(key)) => writeln!(out, "line {number}: candidate key: {key}"),
+        (Format::Text, None) => writeln!(out, "line {number}: unable to find candidate key"),
+        (Format::Json, Some(key)) => writeln!(out, "{{\"line\":{number},\"key\":{key}}}"),
+        (Format::Json, None) => writeln!(out, "{{\"line\":{number},\"key\":null}}"),
+        (Format::Tsv, Some(key)) => writeln!(out, "{number}\t{key}"),
+        (Format::Tsv, None) => writeln!(out, "{number}\t"),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const LINES: [(&str, i32); 6] = [
+        ("the server started without any errors", 12),
+        ("all workers are ready to accept new jobs", 12),
+        ("a client closed the connection early", 12),
+        ("the disk is almost full, please clean up", 80),
+        ("backups will run again tonight at midnight", 80),
+        ("the nightly report was sent to the whole team", 12),
+    ];
+
+    #[test]
+    fn crack_uses_cached_keys_for_lines_sharing_a_key() {
+        let mut cracker = LineCracker::new();
+        for (line, key) in LINES {
+            let ciphertext = ccipher::CaesarCipher::new(key).apply_cipher(line);
+            assert_eq!(
+                cracker.crack(ciphertext.as_bytes()),
+                Some((128 - key) as u8),
+                "{line}"
+            );
+        }
+
+        // Only the first line and the first line under the second key need a full search.
+        assert_eq!(cracker.cache_hits(), 4);
+    }
+
+    #[test]
+    fn remember_keeps_most_recent_keys_first() {
+        let mut cracker = LineCracker::new();
+        for key in [1, 2, 3, 2, 4, 5] {
+            cracker.remember(key);
+        }
+
+        assert_eq!(cracker.keys, [5, 4, 2, 3]);
+        assert_eq!(cracker.len, KEY_CACHE_LEN);
+    }
+
+    #[test]
+    fn crack_lines_streams_keys_and_plaintext() {
+        let mut input = Vec::new();
+        for (line, key) in LINES {
+            input.extend(ccipher::CaesarCipher::new(key).apply_cipher(line).bytes());
+            input.extend(b"\r\n");
+        }
+        input.extend(b"\n!");
+
+        let mut keys = Vec::new();
+        let mut plaintext = Vec::new();
+        crack_lines(&input[..], &mut keys, Some(&mut plaintext), Format::Tsv).unwrap();
+
+        let mut expected_plaintext = String::new();
+        let mut expected_keys = String::from("line\tkey\n");
+        for (number, (line, key)) in LINES.iter().enumerate() {
+            expected_plaintext.push_str(&format!("{line}\r\n"));
+            expected_keys.push_str(&format!("{}\t{}\n", number + 1, 128 - key));
+        }
+        expected_plaintext.push_str("\n!");
+        expected_keys.push_str("7\t\n8\t\n");
+        assert_eq!(String::from_utf8(plaintext).unwrap(), expected_plaintext);
+        assert_eq!(String::from_utf8(keys).unwrap(), expected_keys);
+    }
+
+    #[test]
+    fn write_line_key_renders_every_format() {
+        let render = |format, key| {
+            let mut out = Vec::new();
+            write_line_key(&mut out, 3, key, format).unwrap();
+            String::from_utf8(out).unwrap()
+        };
+
+        assert_eq!(render(Format::Text, Some(9)), "line 3: candidate key: 9\n");
+        assert_eq!(
+            render(Format::Text, None),
+            "line 3: unable to find candidate key\n"
+        );
+        assert_eq!(render(Format::Json, Some(9)), "{\"line\":3,\"key\":9}\n");
+        assert_eq!(render(Format::Json, None), "{\"line\":3,\"key\":null}\n");
+        assert_eq!(render(Format::Tsv, Some(9)), "3\t9\n");
+    }
+}
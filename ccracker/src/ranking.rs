@@ -0,0 +1,331 @@
+//! Ranked candidate keys and their machine-readable output formats.
+//!
+//! Both attacks score every one of the possible shifts. Rather than discarding all but the
+//! winner, a [`Ranking`] keeps the best `k` shifts together with their raw scores and a
+//! normalized confidence margin between the two best candidates.
+use clap::ValueEnum;
+use std::cmp::{Ordering, Reverse};
+use std::collections::BinaryHeap;
+use std::io::{self, Write};
+
+/// A candidate decryption key along with the raw score its attack assigned to it.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct Candidate {
+    /// The shift that decrypts the ciphertext.
+    pub shift: u8,
+    /// The raw attack score. Its meaning depends on the attack: a count of dictionary
+    /// matches (higher is better) or a distance between distributions (lower is better).
+    pub score: f64,
+}
+
+/// Describes whether an attack prefers high or low scores.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum ScoreOrder {
+    /// Larger scores indicate a more likely key (e.g. dictionary matches).
+    HigherIsBetter,
+    /// Smaller scores indicate a more likely key (e.g. distribution distances).
+    LowerIsBetter,
+}
+
+/// The top candidate keys found by an attack, ordered from most to least likely.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct Ranking {
+    /// At most `k` candidates, best first. Ties are broken in favor of the smaller shift.
+    pub candidates: Vec<Candidate>,
+    /// Normalized margin between the best and the runner-up score in the range `[0, 1]`.
+    ///
+    /// A value of `0` means the two best candidates are indistinguishable, `1` means the
+    /// runner-up scored nothing at all (or there is no runner-up).
+    pub confidence: f64,
+}
+
+/// Output format used when printing a [`Ranking`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq, ValueEnum)]
+pub enum Format {
+    /// Human readable `candidate key: N` lines.
+    #[default]
+    Text,
+    /// A single JSON object.
+    Json,
+    /// Tab separated values with a header row.
+    Tsv,
+}
+
+/// Heap entry ordered so that the "greatest" entry is the most likely key.
+struct Entry {
+    key: f64,
+    shift: u8,
+}
+
+impl Entry {
+    fn cmp_key(&self, other: &Self) -> Ordering {
+        self.key
+            .total_cmp(&other.key)
+            .then_with(|| other.shift.cmp(&self.shift))
+    }
+}
+
+impl PartialEq for Entry {
+    fn eq(&self, other: &Self) -> bool {
+        self.cmp_key(other) == Ordering::Equal
+    }
+}
+
+impl Eq for Entry {}
+
+impl PartialOrd for Entry {
+    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl Ord for Entry {
+    fn cmp(&self, other: &Self) -> Ordering {
+        self.cmp_key(other)
+    }
+}
+
+impl Ranking {
+    /// Builds a ranking of the `k` best shifts from a table of per-shift scores.
+    ///
+    /// The index of each score is its shift. Candidates are selected with a min-heap bounded
+    /// to `max(k, 2)` entries so the full score table is never sorted. Scores for which
+    /// `keep` returns `false` are never considered candidates.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use ccracker::{Ranking, ScoreOrder};
+    ///
+    /// let scores = [0.0, 4.0, 1.0, 3.0];
+    /// let ranking = Ranking::from_scores(&scores, 2, ScoreOrder::HigherIsBetter, |_| true);
+    /// assert_eq!(ranking.candidates[0].shift, 1);
+    /// assert_eq!(ranking.candidates[1].shift, 3);
+    /// assert_eq!(ranking.confidence, 0.25);
+    /// ```
+    pub fn from_scores(
+        scores: &[f64],
+        k: usize,
+        order: ScoreOrder,
+        keep: impl Fn(f64) -> bool,
+    ) -> Self {
+        let capacity = k.max(2);
+        let mut heap: BinaryHeap<Reverse<Entry>> = BinaryHeap::with_capacity(capacity + 1);
+        for (shift, &score) in scores.iter().enumerate() {
+            if !keep(score) {
+                continue;
+            }
+            let key = match order {
+                ScoreOrder::HigherIsBetter => score,
+                ScoreOrder::LowerIsBetter => -score,
+            };
+            heap.push(Reverse(Entry {
+                key,
+                shift: shift as u8,
+            }));
+            if heap.len() > capacity {
+                heap.pop();
+            }
+        }
+
+        // `into_sorted_vec` on reversed entries yields the best entry first.
+        let best: Vec<Candidate> = heap
+            .into_sorted_vec()
+            .into_iter()
+            .map(|Reverse(entry)| Candidate {
+                shift: entry.shift,
+                score: scores[usize::from(entry.shift)],
+            })
+            .collect();
+
+        let confidence = match best.as_slice() {
+            [] => 0.0,
+            [_] => 1.0,
+            [first, second, ..] => confidence_margin(first.score, second.score),
+        };
+
+        Ranking {
+            candidates: best.into_iter().take(k).collect(),
+            confidence,
+        }
+    }
+
+    /// Returns the most likely candidate, if any.
+    pub fn best(&self) -> Option<&Candidate> {
+        self.candidates.first()
+    }
+
+    /// Writes the ranking to `out` in the requested format.
+    ///
+    /// # Errors
+    ///
+    /// Returns any error produced by the underlying writer.
+    pub fn write(&self, out: &mut impl Write, format: Format) -> io::Result<()> {
+        match format {
+            Format::Text => {
+                match self.candidates.as_slice() {
+                    [] => writeln!(out, "unable to find candidate key")?,
+                    [only] => writeln!(out, "candidate key: {}", only.shift)?,
+                    candidates => {
+                        for candidate in candidates {
+                            writeln!(
+                                out,
+                                "candidate key: {} (score: {})",
+                                candidate.shift, candidate.score
+                            )?;
+                        }
+                        writeln!(out, "confidence: {:.3}", self.confidence)?;
+                    }
+                }
+                Ok(())
+            }
+            Format::Json => {
+                write!(out, "{{\"confidence\":{},\"candidates\":[", self.confidence)?;
+                for (i, candidate) in self.candidates.iter().enumerate() {
+                    if i > 0 {
+                        write!(out, ",")?;
+                    }
+                    write!(
+                        out,
+                        "{{\"key\":{},\"score\":{}}}",
+                        candidate.shift, candidate.score
+                    )?;
+                }
+                writeln!(out, "]}}")
+            }
+            Format::Tsv => {
+                writeln!(out, "rank\tkey\tscore\tconfidence")?;
+                for (i, candidate) in self.candidates.iter().enumerate() {
+                    writeln!(
+                        out,
+                        "{}\t{}\t{}\t{}",
+                        i + 1,
+                        candidate.shift,
+                        candidate.score,
+                        self.confidence
+                    )?;
+                }
+                Ok(())
+            }
+        }
+    }
+}
+
+/// Relative gap between the best and the runner-up score, independent of score orientation.
+pub(crate) fn confidence_margin(best: f64, runner_up: f64) -> f64 {
+    let scale = best.abs().max(runner_up.abs());
+    if scale == 0.0 {
+        0.0
+    } else {
+        (best - runner_up).abs() / scale
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn render(ranking: &Ranking, format: Format) -> String {
+        let mut out = Vec::new();
+        ranking.write(&mut out, format).unwrap();
+        String::from_utf8(out).unwrap()
+    }
+
+    #[test]
+    fn from_scores_returns_best_first_when_higher_is_better() {
+        let scores = [1.0, 5.0, 0.0, 3.0, 4.0];
+        let ranking = Ranking::from_scores(&scores, 3, ScoreOrder::HigherIsBetter, |_| true);
+
+        let shifts: Vec<u8> = ranking.candidates.iter().map(|c| c.shift).collect();
+        assert_eq!(shifts, vec![1, 4, 3]);
+        assert_eq!(ranking.candidates[0].score, 5.0);
+        assert!((ranking.confidence - 0.2).abs() < 1e-12);
+    }
+
+    #[test]
+    fn from_scores_returns_best_first_when_lower_is_better() {
+        let scores = [0.9, 0.2, 0.8, 0.1];
+        let ranking = Ranking::from_scores(&scores, 2, ScoreOrder::LowerIsBetter, |_| true);
+
+        let shifts: Vec<u8> = ranking.candidates.iter().map(|c| c.shift).collect();
+        assert_eq!(shifts, vec![3, 1]);
+        assert!((ranking.confidence - 0.5).abs() < 1e-12);
+    }
+
+    #[test]
+    fn from_scores_breaks_ties_in_favor_of_smaller_shift() {
+        let scores = [2.0, 7.0, 7.0, 7.0];
+        let ranking = Ranking::from_scores(&scores, 2, ScoreOrder::HigherIsBetter, |_| true);
+
+        assert_eq!(ranking.candidates[0].shift, 1);
+        assert_eq!(ranking.candidates[1].shift, 2);
+        assert_eq!(ranking.confidence, 0.0);
+    }
+
+    #[test]
+    fn from_scores_computes_confidence_from_runner_up_when_k_is_one() {
+        let scores = [4.0, 1.0];
+        let ranking = Ranking::from_scores(&scores, 1, ScoreOrder::HigherIsBetter, |_| true);
+
+        assert_eq!(ranking.candidates.len(), 1);
+        assert_eq!(ranking.confidence, 0.75);
+    }
+
+    #[test]
+    fn from_scores_skips_filtered_scores() {
+        let scores = [0.0, 3.0, 0.0];
+        let ranking =
+            Ranking::from_scores(&scores, 3, ScoreOrder::HigherIsBetter, |score| score > 0.0);
+
+        assert_eq!(
+            ranking.candidates,
+            vec![Candidate {
+                shift: 1,
+                score: 3.0
+            }]
+        );
+        assert_eq!(ranking.confidence, 1.0);
+    }
+
+    #[test]
+    fn write_text_matches_single_key_output() {
+        let ranking = Ranking {
+            candidates: vec![Candidate {
+                shift: 66,
+                score: 1.0,
+            }],
+            confidence: 1.0,
+        };
+        assert_eq!(render(&ranking, Format::Text), "candidate key: 66\n");
+        assert_eq!(
+            render(&Ranking::default(), Format::Text),
+            "unable to find candidate key\n"
+        );
+    }
+
+    #[test]
+    fn write_json_and_tsv_list_all_candidates() {
+        let ranking = Ranking {
+            candidates: vec![
+                Candidate {
+                    shift: 3,
+                    score: 4.0,
+                },
+                Candidate {
+                    shift: 9,
+                    score: 1.5,
+                },
+            ],
+            confidence: 0.625,
+        };
+
+        assert_eq!(
+            render(&ranking, Format::Json),
+            "{\"confidence\":0.625,\"candidates\":[{\"key\":3,\"score\":4},{\"key\":9,\"score\":1.5}]}\n"
+        );
+        assert_eq!(
+            render(&ranking, Format::Tsv),
+            "rank\tkey\tscore\tconfidence\n1\t3\t4\t0.625\n2\t9\t1.5\t0.625\n"
+        );
+    }
+}
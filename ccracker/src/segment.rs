@@ -0,0 +1,392 @@
+//! Segmentation of ciphertexts whose parts were encrypted under different keys.
+//!
+//! A window of the most recent bytes slides over the ciphertext. Scoring a shift by the
+//! summed English penalties of the window's characters (its cross-entropy, see
+//! [`crate::metrics`]) is linear in the window's histogram, so the scores of all 128 shifts
+//! are updated in place as bytes enter and leave the window: each update adds or subtracts
+//! one contiguous 128-entry window of a doubled penalty table, the same trick
+//! [`crate::lanes`] uses for class tables. When a different shift wins consistently, the
+//! change point is located exactly within the last window, so the whole input is segmented
+//! in a single linear pass.
+use crate::lanes::LANES;
+use crate::metrics;
+use crate::ranking::Format;
+use std::io::{self, Write};
+
+/// Window size, in bytes, used when none is given.
+pub const DEFAULT_WINDOW: usize = 64;
+
+/// A run of ciphertext encrypted under a single key.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct Segment {
+    /// Byte offset of the segment in the ciphertext.
+    pub offset: usize,
+    /// Length of the segment in bytes.
+    pub len: usize,
+    /// The shift that decrypts the segment.
+    pub shift: u8,
+}
+
+/// Scores of every shift over a multiset of ciphertext bytes.
+struct ShiftScores {
+    /// The penalty table twice in a row: the penalties of byte `b` under every shift are
+    /// `doubled[b..b + 128]`.
+    doubled: [u32; 2 * LANES],
+    scores: [u64; LANES],
+    ascii: usize,
+}
+
+impl ShiftScores {
+    fn new() -> Self {
+        let penalties = metrics::penalties();
+        ShiftScores {
+            doubled: std::array::from_fn(|i| penalties[i % LANES]),
+            scores: [0; LANES],
+            ascii: 0,
+        }
+    }
+
+    /// Returns the penalty of `byte` under `shift`. Non-ASCII bytes are never shifted and
+    /// cost nothing.
+    fn penalty(&self, byte: u8, shift: u8) -> i64 {
+        if byte.is_ascii() {
+            i64::from(self.doubled[usize::from(byte) + usize::from(shift)])
+        } else {
+            0
+        }
+    }
+
+    fn add(&mut self, byte: u8) {
+        if byte.is_ascii() {
+            let doubled = &self.doubled;
+            let penalties = &doubled[usize::from(byte)..usize::from(byte) + LANES];
+            for (score, &penalty) in self.scores.iter_mut().zip(penalties) {
+                *score += u64::from(penalty);
+            }
+            self.ascii += 1;
+        }
+    }
+
+    fn remove(&mut self, byte: u8) {
+        if byte.is_ascii() {
+            let doubled = &self.doubled;
+            let penalties = &doubled[usize::from(byte)..usize::from(byte) + LANES];
+            for (score, &penalty) in self.scores.iter_mut().zip(penalties) {
+                *score -= u64::from(penalty);
+            }
+            self.ascii -= 1;
+        }
+    }
+
+    /// Returns the shift with the lowest score, preferring the smaller shift on ties.
+    fn best(&self) -> u8 {
+        let mut best = 0;
+        for (shift, &score) in self.scores.iter().enumerate() {
+            if score < self.scores[best] {
+                best = shift;
+            }
+        }
+        best as u8
+    }
+
+    /// Returns the offset in `bytes` at which switching from shift `from` to shift `to`
+    /// minimizes the total penalty.
+    fn best_split(&self, bytes: &[u8], from: u8, to: u8) -> usize {
+        // The total is a constant plus the prefix sum of the penalty differences.
+        let (mut split, mut lowest, mut prefix) = (0, 0, 0);
+        for (i, &byte) in bytes.iter().enumerate() {
+            prefix += self.penalty(byte, from) - self.penalty(byte, to);
+            if prefix < lowest {
+                (split, lowest) = (i + 1, prefix);
+            }
+        }
+        split
+    }
+}
+
+/// Splits a ciphertext into runs encrypted under different keys and recovers each key.
+///
+/// The best shift of a `window`-byte sliding window is tracked byte by byte. Once another
+/// shift has won for a quarter of a window in a row, the change point is placed where it
+/// minimizes the combined penalty of the bytes before and after it. Finally the key of each
+/// segment is recomputed from all of its bytes and neighbours that agree are merged.
+///
+/// Segments cover the whole ciphertext in order. Shorter windows react to shorter
+/// segments but are more easily fooled by unusual text. A ciphertext without ASCII bytes has
+/// no key to recover and yields no segments.
+///
+/// # Panics
+///
+/// Panics if `window` is zero.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::{segment_ascii, Segment};
+///
+/// let first = ccipher::CaesarCipher::new(3).apply_cipher(
+///     "Four score and seven years ago our fathers brought forth on this continent a new \
+///      nation, conceived in liberty, and dedicated to the proposition that all men are \
+///      created equal. ",
+/// );
+/// let second = ccipher::CaesarCipher::new(50).apply_cipher(
+///     "It was the best of times, it was the worst of times, it was the age of wisdom, it \
+///      was the age of foolishness, it was the epoch of belief, it was the epoch of doubt.",
+/// );
+/// let segments = segment_ascii(format!("{first}{second}").as_bytes(), 64);
+///
+/// let keys: Vec<u8> = segments.iter().map(|segment| segment.shift).collect();
+/// assert_eq!(keys, vec![125, 78]);
+/// ```
+pub fn segment_ascii(ciphertext: &[u8], window: usize) -> Vec<Segment> {
+    assert!(window > 0, "window must not be empty");
+    if ciphertext.is_empty() {
+        return Vec::new();
+    }
+    let window = window.min(ciphertext.len());
+    let confirm = (window / 4).max(1);
+
+    let mut scores = ShiftScores::new();
+    let mut boundaries = vec![0];
+    let mut current = None;
+    let mut challenger = (0, 0);
+    for (end, &byte) in ciphertext.iter().enumerate() {
+        scores.add(byte);
+        if end >= window {
+            scores.remove(ciphertext[end - window]);
+        }
+        if end + 1 < window || scores.ascii == 0 {
+            continue;
+        }
+
+        let best = scores.best();
+        let Some(key) = current else {
+            current = Some(best);
+            continue;
+        };
+        if best == key {
+            challenger = (0, 0);
+            continue;
+        }
+        challenger = match challenger {
+            (shift, run) if shift == best && run > 0 => (best, run + 1),
+            _ => (best, 1),
+        };
+        if challenger.1 == confirm {
+            // The change happened within the windows seen since the challenger appeared.
+            let start = *boundaries.last().expect("boundaries start at zero");
+            let low = (end + 1).saturating_sub(window + confirm).max(start);
+            let split = low + scores.best_split(&ciphertext[low..=end], key, best);
+            if split > start {
+                boundaries.push(split);
+            }
+            current = Some(best);
+            challenger = (0, 0);
+        }
+    }
+    // No window held an ASCII byte, so every shift scored the same.
+    if current.is_none() {
+        return Vec::new();
+    }
+    if boundaries.last() != Some(&ciphertext.len()) {
+        boundaries.push(ciphertext.len());
+    }
+
+    // Rescore every segment as a whole, which is more reliable than any single window.
+    let mut segments: Vec<Segment> = Vec::with_capacity(boundaries.len() - 1);
+    for bounds in boundaries.windows(2) {
+        let mut segment_scores = ShiftScores::new();
+        for &byte in &ciphertext[bounds[0]..bounds[1]] {
+            segment_scores.add(byte);
+        }
+        let shift = segment_scores.best();
+        match segments.last_mut() {
+            Some(last) if last.shift == shift => last.len += bounds[1] - bounds[0],
+            _ => segments.push(Segment {
+                offset: bounds[0],
+                len: bounds[1] - bounds[0],
+                shift,
+            }),
+        }
+    }
+    segments
+}
+
+/// Writes segments to `out` in the requested format.
+///
+/// # Errors
+///
+/// Returns any error produced by the underlying writer.
+pub fn write_segments(
+    segments: &[Segment],
+    out: &mut impl Write,
+    format: Format,
+) -> io::Result<()> {
+    match format {
+        Format::Text => {
+            if segments.is_empty() {
+                writeln!(out, "unable to find candidate key")?;
+            }
+            for segment in segments {
+                writeln!(
+                    out,
+                    "offset: {}, length: {}, candidate key: {}",
+                    segment.offset, segment.len, segment.shift
+                )?;
+            }
+            Ok(())
+        }
+        Format::Json => {
+            write!(out, "{{\"segments\":[")?;
+            for (i, segment) in segments.iter().enumerate() {
+                if i > 0 {
+                    write!(out, ",")?;
+                }
+                write!(
+                    out,
+                    "{{\"offset\":{},\"length\":{},\"key\":{}}}",
+                    segment.offset, segment.len, segment.shift
+                )?;
+            }
+            writeln!(out, "]}}")
+        }
+        Format::Tsv => {
+            writeln!(out, "offset\tlength\tkey")?;
+            for segment in segments {
+                writeln!(
+                    out,
+                    "{}\t{}\t{}",
+                    segment.offset, segment.len, segment.shift
+                )?;
+            }
+            Ok(())
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const PARTS: [&str; 3] = [
+        "It is a truth universally acknowledged, that a single man in possession of a good \
+         fortune, must be in want of a wife. However little known the feelings or views of \
+         such a man may be on his first entering a neighbourhood, this truth is so well fixed \
+         in the minds of the surrounding families. ",
+        "Call me Ishmael. Some years ago, never mind how long precisely, having little or no \
+         money in my purse, and nothing particular to interest me on shore, I thought I would \
+         sail about a little and see the watery part of the world. It is a way I have of \
+         driving off the spleen. ",
+        "Alice was beginning to get very tired of sitting by her sister on the bank, and of \
+         having nothing to do: once or twice she had peeped into the book her sister was \
+         reading, but it had no pictures or conversations in it, and what is the use of a \
+         book without pictures?",
+    ];
+
+    fn encrypt_parts(keys: [i32; 3]) -> (Vec<u8>, Vec<usize>) {
+        let mut ciphertext = Vec::new();
+        let mut offsets = Vec::new();
+        for (part, key) in PARTS.iter().zip(keys) {
+            offsets.push(ciphertext.len());
+            ciphertext.extend(ccipher::CaesarCipher::new(key).apply_cipher(part).bytes());
+        }
+        (ciphertext, offsets)
+    }
+
+    #[test]
+    fn segment_ascii_finds_keys_and_change_points() {
+        let keys = [7, 90, 33];
+        let (ciphertext, offsets) = encrypt_parts(keys);
+        let segments = segment_ascii(&ciphertext, DEFAULT_WINDOW);
+
+        assert_eq!(segments.len(), 3, "{segments:?}");
+        for ((segment, key), offset) in segments.iter().zip(keys).zip(offsets) {
+            assert_eq!(segment.shift, (-key).rem_euclid(128) as u8);
+            assert!(segment.offset.abs_diff(offset) <= 4, "{segments:?}");
+        }
+        let covered: usize = segments.iter().map(|segment| segment.len).sum();
+        assert_eq!(covered, ciphertext.len());
+    }
+
+    #[test]
+    fn segment_ascii_returns_one_segment_for_single_key() {
+        let (ciphertext, _) = encrypt_parts([12, 12, 12]);
+        let segments = segment_ascii(&ciphertext, 32);
+
+        assert_eq!(
+            segments,
+            vec![Segment {
+                offset: 0,
+                len: ciphertext.len(),
+                shift: 116
+            }]
+        );
+    }
+
+    #[test]
+    fn segment_ascii_handles_short_and_empty_input() {
+        assert_eq!(segment_ascii(b"", DEFAULT_WINDOW), Vec::new());
+        let ciphertext = ccipher::CaesarCipher::new(1).apply_cipher("the cat sat on the mat");
+        let segments = segment_ascii(ciphertext.as_bytes(), DEFAULT_WINDOW);
+
+        assert_eq!(segments.len(), 1);
+        assert_eq!(segments[0].shift, 127);
+    }
+
+    #[test]
+    fn segment_ascii_finds_no_key_without_ascii_bytes() {
+        assert_eq!(
+            segment_ascii(&[0x80, 0xff, 0xc3], DEFAULT_WINDOW),
+            Vec::new()
+        );
+        assert_eq!(segment_ascii("日本語のテキスト".as_bytes(), 4), Vec::new());
+    }
+
+    #[test]
+    fn shift_scores_return_to_zero_after_removal() {
+        let mut scores = ShiftScores::new();
+        for &byte in "h\u{e9}llo".as_bytes() {
+            scores.add(byte);
+        }
+        for &byte in "h\u{e9}llo".as_bytes() {
+            scores.remove(byte);
+        }
+
+        assert_eq!(scores.scores, [0; LANES]);
+        assert_eq!(scores.ascii, 0);
+    }
+
+    #[test]
+    fn write_segments_renders_every_format() {
+        let segments = [
+            Segment {
+                offset: 0,
+                len: 10,
+                shift: 3,
+            },
+            Segment {
+                offset: 10,
+                len: 5,
+                shift: 70,
+            },
+        ];
+        let render = |format| {
+            let mut out = Vec::new();
+            write_segments(&segments, &mut out, format).unwrap();
+            String::from_utf8(out).unwrap()
+        };
+
+        assert_eq!(
+            render(Format::Text),
+            "offset: 0, length: 10, candidate key: 3\noffset: 10, length: 5, candidate key: 70\n"
+        );
+        assert_eq!(
+            render(Format::Json),
+            "{\"segments\":[{\"offset\":0,\"length\":10,\"key\":3},{\"offset\":10,\"length\":5,\"key\":70}]}\n"
+        );
+        assert_eq!(
+            render(Format::Tsv),
+            "offset\tlength\tkey\n0\t10\t3\n10\t5\t70\n"
+        );
+    }
+}
@@ -0,0 +1,317 @@
+//! Incremental cracking of ciphertext that arrives over time.
+//!
+//! The n-gram scores of all shifts are updated chunk by chunk with an [`NgramScanner`], and
+//! a key is reported as soon as the confidence margin of the ranking (see [`Ranking`])
+//! reaches a threshold, without waiting for the end of the input.
+use crate::ngram::NgramScanner;
+use crate::ranking::{Format, Ranking, ScoreOrder};
+use std::io::{self, BufRead, Write};
+
+/// Confidence margin at which a key is reported when none is given.
+pub const DEFAULT_STREAM_CONFIDENCE: f64 = 0.5;
+
+/// Number of n-grams that must be scored before any key is reported.
+///
+/// On snippets of the bundled corpus the best shift was always right once eight n-grams
+/// (about five bytes) had been seen, whatever its margin; twice that leaves some headroom.
+const MIN_NGRAMS: usize = 16;
+
+/// Ranks the shifts of a ciphertext fed chunk by chunk and decides on a key as soon as the
+/// ranking is confident enough.
+///
+/// # Examples
+///
+/// ```
+/// use ccracker::StreamCracker;
+///
+/// let ciphertext = ccipher::CaesarCipher::new(20).apply_cipher("Attack at dawn, not at dusk.");
+/// let mut cracker = StreamCracker::new(1, 0.5);
+/// for chunk in ciphertext.as_bytes().chunks(4) {
+///     cracker.update(chunk);
+///     if let Some(ranking) = cracker.decision() {
+///         assert_eq!(ranking.best().map(|c| c.shift), Some(108));
+///         break;
+///     }
+/// }
+/// ```
+#[derive(Clone, Debug)]
+pub struct StreamCracker {
+    scanner: NgramScanner,
+    k: usize,
+    confidence: f64,
+}
+
+impl StreamCracker {
+    /// Creates a cracker that ranks `k` keys and decides once the confidence margin of the
+    /// ranking reaches `confidence`.
+    pub fn new(k: usize, confidence: f64) -> Self {
+        StreamCracker {
+            scanner: NgramScanner::new(),
+            k,
+            confidence,
+        }
+    }
+
+    /// Feeds the next chunk of ciphertext to the cracker.
+    pub fn update(&mut self, chunk: &[u8]) {
+        self.scanner.update(chunk);
+    }
+
+    /// Returns the ranking of the input seen so far. It is empty until the input holds an
+    /// n-gram.
+    pub fn ranking(&self) -> Ranking {
+        match self.scanner.scores() {
+            Some(scores) => Ranking::from_scores(
+                &scores.map(f64::from),
+                self.k,
+                ScoreOrder::HigherIsBetter,
+                |_| true,
+            ),
+            None => Ranking::default(),
+        }
+    }
+
+    /// Returns the ranking of the input seen so far if it is confident enough to report.
+    pub fn decision(&self) -> Option<Ranking> {
+        if self.scanner.ngrams() < MIN_NGRAMS {
+            return None;
+        }
+        let ranking = self.ranking();
+        (ranking.confidence >= self.confidence).then_some(ranking)
+    }
+}
+
+/// Cracks a ciphertext as it is read and reports the key before the end of the input.
+///
+/// The ranking of the `k` best keys is written to `reports` in `format` as soon as its
+/// confidence margin reaches `confidence`. Without `verify` and `plaintext`, reading stops
+/// right there. With `verify`, the rest of the input is scored too and the ranking is
+/// reported again whenever a different key becomes the confident favorite. If no ranking
+/// was ever confident enough, the final ranking is reported at the end of the input.
+///
+/// When `plaintext` is given, the input is buffered until the key is decided; from then on
+/// it is decrypted with that key and written out chunk by chunk. Later changes of the best
+/// key are only reported.
+///
+/// Returns the best key of the last reported ranking, if any.
+///
+/// # Errors
+///
+/// Returns any error produced while reading the input or writing the results.
+pub fn crack_stream(
+    mut input: impl BufRead,
+    reports: &mut impl Write,
+    mut plaintext: Option<&mut dyn Write>,
+    k: usize,
+    confidence: f64,
+    verify: bool,
+    format: Format,
+) -> io::Result<Option<u8>> {
+    let mut cracker = StreamCracker::new(k, confidence);
+    let mut reported: Option<Ranking> = None;
+    // Input read before the key was decided, kept for decryption.
+    let mut pending = Vec::new();
+    let mut decrypted = Vec::new();
+
+    loop {
+        let chunk = input.fill_buf()?;
+        if chunk.is_empty() {
+            break;
+        }
+        cracker.update(chunk);
+
+        if let Some(out) = plaintext.as_mut() {
+            match reported.as_ref().and_then(best_shift) {
+                Some(shift) => {
+                    decrypted.resize(chunk.len(), 0);
+                    ccipher::CaesarCipher::new(i32::from(shift))
+                        .apply_cipher_bytes(chunk, &mut decrypted);
+                    out.write_all(&decrypted)?;
+                }
+                None => pending.extend_from_slice(chunk),
+            }
+        }
+        let len = chunk.len();
+        input.consume(len);
+
+        let decision = match cracker.decision() {
+            Some(ranking) => ranking,
+            None => continue,
+        };
+        let best = decision.best().map(|c| c.shift);
+        let first = reported.is_none();
+        if first || (verify && best != reported.as_ref().and_then(best_shift)) {
+            decision.write(reports, format)?;
+            reports.flush()?;
+            if let (true, Some(out), Some(shift)) = (first, plaintext.as_mut(), best) {
+                write_decrypted(out, &pending, shift)?;
+                pending = Vec::new();
+            }
+            reported = Some(decision);
+        }
+        if plaintext.is_none() && !verify {
+            break;
+        }
+    }
+
+    if reported.is_none() {
+        let ranking = cracker.ranking();
+        ranking.write(reports, format)?;
+        if let (Some(out), Some(best)) = (plaintext.as_mut(), ranking.best()) {
+            write_decrypted(out, &pending, best.shift)?;
+        }
+        reported = Some(ranking);
+    }
+    Ok(reported.as_ref().and_then(best_shift))
+}
+
+fn best_shift(ranking: &Ranking) -> Option<u8> {
+    ranking.best().map(|candidate| candidate.shift)
+}
+
+fn write_decrypted(out: &mut dyn Write, ciphertext: &[u8], shift: u8) -> io::Result<()> {
+    let mut plaintext = vec![0; ciphertext.len()];
+    ccipher::CaesarCipher::new(i32::from(shift)).apply_cipher_bytes(ciphertext, &mut plaintext);
+    out.write_all(&plaintext)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::collections::VecDeque;
+    use std::io::Read;
+
+    /// A reader that hands out one chunk per read, like a pipe fed by a slow producer.
+    struct Chunks {
+        chunks: VecDeque<Vec<u8>>,
+        consumed: usize,
+    }
+
+    impl Chunks {
+        fn new(data: &[u8], chunk_len: usize) -> Self {
+            Chunks {
+                chunks: data.chunks(chunk_len).map(<[u8]>::to_vec).collect(),
+                consumed: 0,
+            }
+        }
+    }
+
+    impl Read for Chunks {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            let len = self.fill_buf()?.len().min(buf.len());
+            buf[..len].copy_from_slice(&self.chunks[0][..len]);
+            self.consume(len);
+            Ok(len)
+        }
+    }
+
+    impl BufRead for Chunks {
+        fn fill_buf(&mut self) -> io::Result<&[u8]> {
+            Ok(self.chunks.front().map_or(&[], Vec::as_slice))
+        }
+
+        fn consume(&mut self, amt: usize) {
+            if let Some(chunk) = self.chunks.front_mut() {
+                chunk.drain(..amt);
+                if chunk.is_empty() {
+                    self.chunks.pop_front();
+                    self.consumed += 1;
+                }
+            }
+        }
+    }
+
+    const TEXT: &str = "It was the best of times, it was the worst of times, it was the age of \
+                        wisdom, it was the age of foolishness, it was the epoch of belief, it \
+                        was the epoch of incredulity, it was the season of Light.";
+
+    #[test]
+    fn crack_stream_reports_key_before_end_of_input() {
+        let ciphertext = ccipher::CaesarCipher::new(40).apply_cipher(TEXT);
+        let mut input = Chunks::new(ciphertext.as_bytes(), 8);
+        let mut reports = Vec::new();
+
+        let key = crack_stream(
+            &mut input,
+            &mut reports,
+            None,
+            1,
+            DEFAULT_STREAM_CONFIDENCE,
+            false,
+            Format::Text,
+        )
+        .unwrap();
+
+        assert_eq!(key, Some(88));
+        assert_eq!(reports, b"candidate key: 88\n");
+        assert!(input.consumed < 4, "read {} chunks", input.consumed);
+    }
+
+    #[test]
+    fn crack_stream_decrypts_buffered_and_later_input() {
+        let ciphertext = ccipher::CaesarCipher::new(101).apply_cipher(TEXT);
+        let mut reports = Vec::new();
+        let mut plaintext = Vec::new();
+
+        let key = crack_stream(
+            Chunks::new(ciphertext.as_bytes(), 5),
+            &mut reports,
+            Some(&mut plaintext),
+            1,
+            DEFAULT_STREAM_CONFIDENCE,
+            false,
+            Format::Text,
+        )
+        .unwrap();
+
+        assert_eq!(key, Some(27));
+        assert_eq!(plaintext, TEXT.as_bytes());
+    }
+
+    #[test]
+    fn crack_stream_reports_changed_key_when_verifying() {
+        let mut ciphertext = ccipher::CaesarCipher::new(3).apply_cipher("Meet me at the mill.");
+        ciphertext.push_str(&ccipher::CaesarCipher::new(9).apply_cipher(&TEXT.repeat(3)));
+        let mut reports = Vec::new();
+
+        let key = crack_stream(
+            Chunks::new(ciphertext.as_bytes(), 16),
+            &mut reports,
+            None,
+            1,
+            DEFAULT_STREAM_CONFIDENCE,
+            true,
+            Format::Tsv,
+        )
+        .unwrap();
+
+        assert_eq!(key, Some(119));
+        let reports = String::from_utf8(reports).unwrap();
+        let keys: Vec<&str> = reports
+            .lines()
+            .filter(|line| !line.starts_with("rank"))
+            .map(|line| line.split('\t').nth(1).unwrap())
+            .collect();
+        assert_eq!(keys, vec!["125", "119"]);
+    }
+
+    #[test]
+    fn crack_stream_reports_final_ranking_without_confident_decision() {
+        let mut reports = Vec::new();
+        let key = crack_stream(&b"x"[..], &mut reports, None, 1, 0.5, false, Format::Text).unwrap();
+
+        assert_eq!(key, None);
+        assert_eq!(reports, b"unable to find candidate key\n");
+    }
+
+    #[test]
+    fn decision_waits_for_enough_ngrams() {
+        let mut cracker = StreamCracker::new(1, 0.0);
+        cracker.update(b"abcdefgh");
+        assert_eq!(cracker.decision(), None);
+        assert!(cracker.ranking().best().is_some());
+
+        cracker.update(b"ijklmnop");
+        assert!(cracker.decision().is_some());
+    }
+}
@@ -0,0 +1,476 @@
+//! Cracking every file of a directory tree in parallel.
+//!
+//! Files are split into work units of at most [`UNIT_LEN`] bytes that are scheduled on a
+//! [`WorkStealingPool`]. Files of up to [`MAX_UNITS_PER_FILE`] units are examined in full;
+//! larger files are sampled with that many units spread evenly over the file, since a
+//! single key is settled long before megabytes of ciphertext have been scored. Every unit
+//! produces an additive table (exact word counts or n-gram scores per shift, or a byte
+//! histogram), and the tables of a file's units are summed before the file is ranked.
+use crate::ranking::Format;
+use crate::{ascii_dict_scores, ascii_histogram, histogram_freq_scores, ASCII_ALPHABET_LEN};
+use crate::{crib, ngram, Attack, DictScratch, Dictionary, Metric, Ranking, ScoreOrder};
+use ccipher_io::{FileEntry, WorkStealingPool};
+use std::fs::File;
+use std::io::{self, Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+
+/// Maximum number of bytes read by one work unit.
+pub const UNIT_LEN: u64 = 256 * 1024;
+/// Maximum number of work units a file is split into.
+pub const MAX_UNITS_PER_FILE: u64 = 16;
+
+type Table = [f64; ASCII_ALPHABET_LEN as usize];
+
+/// The result of cracking one file of a tree.
+#[derive(Clone, Debug, PartialEq)]
+pub struct FileReport {
+    /// Path of the file, starting with the root of the tree.
+    pub path: PathBuf,
+    /// The best candidate key of the file, if any.
+    pub ranking: Ranking,
+    /// Number of bytes of the file that were scored.
+    pub bytes_examined: u64,
+}
+
+/// A piece of a file scored by one task of the pool.
+struct Unit {
+    file: usize,
+    offset: u64,
+    len: u64,
+}
+
+/// Cracks many files with one attack, sharing the prepared dictionary between all workers.
+///
+/// # Examples
+///
+/// ```no_run
+/// use ccipher_io::WorkStealingPool;
+/// use ccracker::{Attack, Metric, TreeCracker};
+/// use std::path::Path;
+///
+/// let cracker = TreeCracker::new(Attack::Ngram, Metric::L1, None);
+/// let pool = WorkStealingPool::with_available_parallelism();
+/// for report in cracker.crack(Path::new("encrypted"), &pool)? {
+///     let report = report?;
+///     println!("{}: {:?}", report.path.display(), report.ranking.best());
+/// }
+/// # Ok::<(), std::io::Error>(())
+/// ```
+pub struct TreeCracker {
+    attack: Attack,
+    metric: Metric,
+    crib: Vec<u8>,
+    dictionary: Option<Dictionary>,
+}
+
+impl TreeCracker {
+    /// Prepares an attack for many files. The dictionary is only built for the dictionary
+    /// attack, and `crib` is only used by the crib attack.
+    pub fn new(attack: Attack, metric: Metric, crib: Option<&[u8]>) -> Self {
+        let dictionary = matches!(attack, Attack::Dictionary).then(Dictionary::popular_english);
+        TreeCracker {
+            attack,
+            metric,
+            crib: crib.unwrap_or_default().to_vec(),
+            dictionary,
+        }
+    }
+
+    /// Cracks every regular file below `root` on `pool` and reports the files in path order.
+    ///
+    /// # Errors
+    ///
+    /// Fails if the tree cannot be walked. A file that cannot be read is reported as an
+    /// error naming its path, and does not stop the other files from being cracked.
+    pub fn crack(
+        &self,
+        root: &Path,
+        pool: &WorkStealingPool,
+    ) -> io::Result<Vec<io::Result<FileReport>>> {
+        let files = ccipher_io::walk_files(root)?;
+        let units: Vec<Unit> = files.iter().enumerate().flat_map(split_file).collect();
+        let unit_files: Vec<usize> = units.iter().map(|unit| unit.file).collect();
+
+        let results = pool.map(
+            units,
+            || (DictScratch::new(), Vec::new()),
+            |(scratch, buffer), unit| -> io::Result<(Option<Table>, u64)> {
+                let sample = read_unit(&files[unit.file].path, &unit, buffer)?;
+                Ok((self.unit_table(sample, scratch), sample.len() as u64))
+            },
+        );
+
+        let mut reports: Vec<io::Result<(Option<Table>, u64)>> =
+            (0..files.len()).map(|_| Ok((None, 0))).collect();
+        for (file, result) in unit_files.into_iter().zip(results) {
+            let report = &mut reports[file];
+            match (report.as_mut(), result) {
+                (Ok((total, examined)), Ok((table, len))) => {
+                    *total = add_tables(total.take(), table);
+                    *examined += len;
+                }
+                (Ok(_), Err(e)) => *report = Err(e),
+                (Err(_), _) => {}
+            }
+        }
+
+        Ok(files
+            .into_iter()
+            .zip(reports)
+            .map(|(file, report)| match report {
+                Ok((table, bytes_examined)) => Ok(FileReport {
+                    ranking: table.map_or_else(Ranking::default, |table| self.rank(&table)),
+                    path: file.path,
+                    bytes_examined,
+                }),
+                Err(e) => Err(io::Error::new(
+                    e.kind(),
+                    format!("{}: {e}", file.path.display()),
+                )),
+            })
+            .collect())
+    }
+
+    /// Scores one unit, or returns `None` if the unit holds nothing the attack can score.
+    fn unit_table(&self, sample: &[u8], scratch: &mut DictScratch) -> Option<Table> {
+        match self.attack {
+            Attack::Dictionary => {
+                let dictionary = self.dictionary.as_ref().expect("built for the attack");
+                // Pruned shifts would count as zero and skew the sum, so every count is kept
+                // exact. Shifts whose bound is zero are still skipped.
+                let keep = ASCII_ALPHABET_LEN.into();
+                Some(ascii_dict_scores(sample, dictionary, keep, scratch).map(f64::from))
+            }
+            Attack::Frequency => {
+                let counts = ascii_histogram(sample);
+                counts
+                    .iter()
+                    .any(|&count| count > 0)
+                    .then(|| counts.map(|count| count as f64))
+            }
+            Attack::Ngram => ngram::ngram_scores(sample).map(|scores| scores.map(f64::from)),
+            Attack::Crib => {
+                crib::crib_scores(sample, &self.crib).map(|scores| scores.map(f64::from))
+            }
+        }
+    }
+
+    /// Ranks the best key of a file from the sum of its unit tables.
+    fn rank(&self, table: &Table) -> Ranking {
+        match self.attack {
+            Attack::Dictionary | Attack::Crib => {
+                Ranking::from_scores(table, 1, ScoreOrder::HigherIsBetter, |score| score > 0.0)
+            }
+            Attack::Frequency => {
+                let counts = table.map(|count| count as u64);
+                let scores = histogram_freq_scores(&counts, self.metric);
+                Ranking::from_scores(&scores, 1, self.metric.order(), |_| true)
+            }
+            Attack::Ngram => Ranking::from_scores(table, 1, ScoreOrder::HigherIsBetter, |_| true),
+        }
+    }
+}
+
+/// Splits a file into the units that are read from it.
+fn split_file((file, entry): (usize, &FileEntry)) -> Vec<Unit> {
+    let units = entry.len.div_ceil(UNIT_LEN).max(1);
+    if units <= MAX_UNITS_PER_FILE {
+        return (0..units)
+            .map(|i| Unit {
+                file,
+                offset: i * UNIT_LEN,
+                len: UNIT_LEN.min(entry.len - i * UNIT_LEN),
+            })
+            .collect();
+    }
+
+    // Spread the samples so that the first starts at the beginning of the file and the last
+    // ends at its end.
+    let last_offset = entry.len - UNIT_LEN;
+    (0..MAX_UNITS_PER_FILE)
+        .map(|i| Unit {
+            file,
+            offset: i * last_offset / (MAX_UNITS_PER_FILE - 1),
+            len: UNIT_LEN,
+        })
+        .collect()
+}
+
+/// Reads a unit into `buffer`. The file may have shrunk since it was listed, in which case
+/// fewer bytes are returned.
+fn read_unit<'a>(path: &Path, unit: &Unit, buffer: &'a mut Vec<u8>) -> io::Result<&'a [u8]> {
+    let mut file = File::open(path)?;
+    file.seek(SeekFrom::Start(unit.offset))?;
+    buffer.clear();
+    file.take(unit.len).read_to_end(buffer)?;
+    Ok(buffer)
+}
+
+fn add_tables(total: Option<Table>, table: Option<Table>) -> Option<Table> {
+    match (total, table) {
+        (Some(mut total), Some(table)) => {
+            for (sum, value) in total.iter_mut().zip(table) {
+                *sum += value;
+            }
+            Some(total)
+        }
+        (total, table) => total.or(table),
+    }
+}
+
+/// Writes a manifest of the cracked files to `out` in the requested format.
+///
+/// Each file is listed with its best candidate key, the score of that key and the number of
+/// bytes that were examined.
+///
+/// # Errors
+///
+/// Returns any error produced by the underlying writer.
+pub fn write_manifest(
+    reports: &[FileReport],
+    out: &mut impl Write,
+    format: Format,
+) -> io::Result<()> {
+    match format {
+        Format::Text => {
+            for report in reports {
+                let path = report.path.display();
+                match report.ranking.best() {
+                    Some(best) => writeln!(
+                        out,
+                        "path: {path}, candidate key: {}, score: {}, bytes examined: {}",
+                        best.shift, best.score, report.bytes_examined
+                    )?,
+                    None => writeln!(
+                        out,
+                        "path: {path}, unable to find candidate key, bytes examined: {}",
+                        report.bytes_examined
+                    )?,
+                }
+            }
+            Ok(())
+        }
+        Format::Json => {
+            write!(out, "{{\"files\":[")?;
+            for (i, report) in reports.iter().enumerate() {
+                if i > 0 {
+                    write!(out, ",")?;
+                }
+                write!(out, "{{\"path\":")?;
+                write_json_string(out, &report.path.to_string_lossy())?;
+                match report.ranking.best() {
+                    Some(best) => write!(out, ",\"key\":{},\"score\":{}", best.shift, best.score)?,
+                    None => write!(out, ",\"key\":null,\"score\":null")?,
+                }
+                write!(out, ",\"bytes_examined\":{}}}", report.bytes_examined)?;
+            }
+            writeln!(out, "]}}")
+        }
+        Format::Tsv => {
+            writeln!(out, "path\tkey\tscore\tbytes_examined")?;
+            for report in reports {
+                let path = report.path.display();
+                match report.ranking.best() {
+                    Some(best) => writeln!(
+                        out,
+                        "{path}\t{}\t{}\t{}",
+                        best.shift, best.score, report.bytes_examined
+                    )?,
+                    None => writeln!(out, "{path}\t\t\t{}", report.bytes_examined)?,
+                }
+            }
+            Ok(())
+        }
+    }
+}
+
+fn write_json_string(out: &mut impl Write, value: &str) -> io::Result<()> {
+    write!(out, "\"")?;
+    for c in value.chars() {
+        match c {
+            '"' => write!(out, "\\\"")?,
+            '\\' => write!(out, "\\\\")?,
+            c if c.is_control() => write!(out, "\\u{:04x}", u32::from(c))?,
+            c => write!(out, "{c}")?,
+        }
+    }
+    write!(out, "\"")
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::fs;
+    use testdir::testdir;
+
+    const MESSAGE: &str = "The ship left the harbor at dawn with forty men on board and enough \
+                           food for three months, and the captain kept a good course south.\n";
+
+    fn split(len: u64) -> Vec<(u64, u64)> {
+        let entry = FileEntry {
+            path: PathBuf::from("file"),
+            len,
+        };
+        split_file((0, &entry))
+            .into_iter()
+            .map(|unit| (unit.offset, unit.len))
+            .collect()
+    }
+
+    #[test]
+    fn split_file_covers_small_files_and_samples_large_ones() {
+        assert_eq!(split(0), vec![(0, 0)]);
+        assert_eq!(split(10), vec![(0, 10)]);
+        assert_eq!(split(UNIT_LEN + 1), vec![(0, UNIT_LEN), (UNIT_LEN, 1)]);
+        assert_eq!(split(MAX_UNITS_PER_FILE * UNIT_LEN).len(), 16);
+
+        let len = 100 * UNIT_LEN + 7;
+        let units = split(len);
+        assert_eq!(units.len() as u64, MAX_UNITS_PER_FILE);
+        assert_eq!(units[0], (0, UNIT_LEN));
+        assert_eq!(units[15], (len - UNIT_LEN, UNIT_LEN));
+        assert!(units
+            .windows(2)
+            .all(|pair| pair[0].0 + UNIT_LEN <= pair[1].0));
+    }
+
+    fn crack_keys(dir: &Path, attack: Attack) -> io::Result<Vec<(PathBuf, Option<u8>, u64)>> {
+        let cracker = TreeCracker::new(attack, Metric::L1, Some(b"harbor"));
+        let pool = WorkStealingPool::new(4);
+        let mut keys = Vec::new();
+        for report in cracker.crack(dir, &pool)? {
+            let report = report?;
+            let path = report.path.strip_prefix(dir).unwrap().to_path_buf();
+            let key = report.ranking.best().map(|c| c.shift);
+            keys.push((path, key, report.bytes_examined));
+        }
+        Ok(keys)
+    }
+
+    #[test]
+    fn crack_reports_every_file_with_its_key() -> io::Result<()> {
+        let dir = testdir!();
+        fs::create_dir_all(dir.join("logs/old"))?;
+        for (name, key) in [("a.txt", 3), ("logs/b.txt", 77), ("logs/old/c.txt", 120)] {
+            let ciphertext = ccipher::CaesarCipher::new(key).apply_cipher(&MESSAGE.repeat(2));
+            fs::write(dir.join(name), ciphertext)?;
+        }
+        fs::write(dir.join("empty.txt"), "")?;
+
+        let len = 2 * MESSAGE.len() as u64;
+        for attack in [
+            Attack::Dictionary,
+            Attack::Frequency,
+            Attack::Ngram,
+            Attack::Crib,
+        ] {
+            assert_eq!(
+                crack_keys(&dir, attack.clone())?,
+                vec![
+                    (PathBuf::from("a.txt"), Some(125), len),
+                    (PathBuf::from("empty.txt"), None, 0),
+                    (PathBuf::from("logs/b.txt"), Some(51), len),
+                    (PathBuf::from("logs/old/c.txt"), Some(8), len),
+                ],
+                "{attack:?}"
+            );
+        }
+        Ok(())
+    }
+
+    #[test]
+    fn crack_samples_large_files() -> io::Result<()> {
+        let dir = testdir!();
+        let repeats = |len: u64| (len / MESSAGE.len() as u64) as usize + 1;
+        let medium = MESSAGE.repeat(repeats(2 * UNIT_LEN));
+        let large = MESSAGE.repeat(repeats(MAX_UNITS_PER_FILE * UNIT_LEN));
+        fs::write(
+            dir.join("large"),
+            ccipher::CaesarCipher::new(9).apply_cipher(&large),
+        )?;
+        fs::write(
+            dir.join("medium"),
+            ccipher::CaesarCipher::new(1).apply_cipher(&medium),
+        )?;
+
+        assert_eq!(
+            crack_keys(&dir, Attack::Frequency)?,
+            vec![
+                (
+                    PathBuf::from("large"),
+                    Some(119),
+                    MAX_UNITS_PER_FILE * UNIT_LEN
+                ),
+                (PathBuf::from("medium"), Some(127), medium.len() as u64),
+            ]
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn unit_tables_sum_to_the_key_that_wins_no_single_unit() {
+        let cracker = TreeCracker::new(Attack::Dictionary, Metric::L1, None);
+        let mut scratch = DictScratch::new();
+        let encrypt = |key: i32, repeats: usize| {
+            ccipher::CaesarCipher::new(key).apply_cipher(&MESSAGE.repeat(repeats))
+        };
+
+        // In every unit two other keys decrypt more words than key 5, which is third.
+        let mut total = None;
+        for decoys in [[20, 40], [60, 80], [100, 120]] {
+            let unit = encrypt(decoys[0], 3) + &encrypt(decoys[1], 3) + &encrypt(5, 2);
+            let table = cracker.unit_table(unit.as_bytes(), &mut scratch);
+            let ranking = cracker.rank(table.as_ref().unwrap());
+            assert_ne!(ranking.best().unwrap().shift, 123);
+            total = add_tables(total, table);
+        }
+        let ranking = cracker.rank(&total.unwrap());
+        assert_eq!(ranking.best().unwrap().shift, 123);
+    }
+
+    #[test]
+    fn crack_fails_on_missing_root() {
+        let dir = testdir!();
+        let cracker = TreeCracker::new(Attack::Ngram, Metric::L1, None);
+        let pool = WorkStealingPool::new(2);
+        assert!(cracker.crack(&dir.join("missing"), &pool).is_err());
+    }
+
+    #[test]
+    fn write_manifest_renders_every_format() {
+        let ranking = Ranking::from_scores(&[0.0, 5.0], 1, ScoreOrder::HigherIsBetter, |_| true);
+        let reports = [
+            FileReport {
+                path: PathBuf::from("dir/a \"b\".txt"),
+                ranking,
+                bytes_examined: 42,
+            },
+            FileReport {
+                path: PathBuf::from("dir/empty"),
+                ranking: Ranking::default(),
+                bytes_examined: 0,
+            },
+        ];
+        let render = |format| {
+            let mut out = Vec::new();
+            write_manifest(&reports, &mut out, format).unwrap();
+            String::from_utf8(out).unwrap()
+        };
+
+        assert_eq!(
+            render(Format::Text),
+            "path: dir/a \"b\".txt, candidate key: 1, score: 5, bytes examined: 42\n\
+             path: dir/empty, unable to find candidate key, bytes examined: 0\n"
+        );
+        assert_eq!(
+            render(Format::Json),
+            "{\"files\":[{\"path\":\"dir/a \\\"b\\\".txt\",\"key\":1,\"score\":5,\
+             \"bytes_examined\":42},{\"path\":\"dir/empty\",\"key\":null,\"score\":null,\
+             \"bytes_examined\":0}]}\n"
+        );
+        assert_eq!(
+            render(Format::Tsv),
+            "path\tkey\tscore\tbytes_examined\ndir/a \"b\".txt\t1\t5\t42\ndir/empty\t\t\t0\n"
+        );
+    }
+}
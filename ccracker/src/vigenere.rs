@@ -0,0 +1,296 @@
+//! Cracking the Vigenère cipher: a repeating key of Caesar shifts.
+//!
+//! The bytes encrypted with the same key position form a column, and every column on its
+//! own is a Caesar ciphertext. The key length (the period) is estimated first, with the
+//! index of coincidence: the probability that two symbols drawn from a column are equal. It
+//! stays close to that of English when the columns are the true ones and drops towards that
+//! of random text when they mix several shifts. The candidate periods are scored in parallel
+//! on a [`WorkStealingPool`], each from strided histograms of its columns counted in a single
+//! pass. Every column of the chosen period is then cracked by the frequency attack on its
+//! histogram, so a crack costs one pass per candidate period instead of a search over keys.
+use crate::alphabet::rank_alphabet_histogram;
+use crate::{Format, Metric};
+use ccipher::Alphabet;
+use ccipher_io::WorkStealingPool;
+use std::io::{self, Write};
+
+/// Largest key length tried by default.
+pub const DEFAULT_MAX_PERIOD: usize = 32;
+
+/// Fraction of the best index of coincidence a period needs to be chosen. Multiples of the
+/// true period score about as high as the period itself, so the smallest period that comes
+/// close to the best, and that none of its multiples beats by more than the same margin, is
+/// chosen.
+const PERIOD_TOLERANCE: f64 = 0.9;
+
+/// Fewest symbols of the alphabet a column needs for its index of coincidence to tell a
+/// single shift from a mix of shifts. Shorter columns score little better than noise, which
+/// favours long periods on short texts.
+const MIN_COLUMN_LEN: usize = 20;
+
+/// A recovered Vigenère key along with the evidence for its length.
+#[derive(Clone, Debug, PartialEq)]
+pub struct VigenereKey {
+    /// The decryption shift of each key position, as applied by [`ccipher::VigenereCipher`].
+    pub shifts: Vec<u8>,
+    /// The mean index of coincidence of the columns of every candidate period, starting at
+    /// period 1.
+    pub coincidence: Vec<f64>,
+}
+
+impl VigenereKey {
+    /// Returns the length of the key.
+    pub fn period(&self) -> usize {
+        self.shifts.len()
+    }
+
+    /// Writes the key to `out` in the requested format: a `candidate key` line of
+    /// comma-separated shifts, a JSON object, or one TSV row per key position.
+    ///
+    /// # Errors
+    ///
+    /// Returns any error produced by the underlying writer.
+    pub fn write(&self, out: &mut impl Write, format: Format) -> io::Result<()> {
+        let shifts: Vec<String> = self.shifts.iter().map(u8::to_string).collect();
+        let coincidence = self.coincidence[self.period() - 1];
+        match format {
+            Format::Text => writeln!(
+                out,
+                "candidate key: {} (period: {})",
+                shifts.join(","),
+                self.period()
+            ),
+            Format::Json => writeln!(
+                out,
+                "{{\"period\":{},\"key\":[{}],\"coincidence\":{}}}",
+                self.period(),
+                shifts.join(","),
+                coincidence
+            ),
+            Format::Tsv => {
+                writeln!(out, "position\tkey")?;
+                for (position, shift) in shifts.iter().enumerate() {
+                    writeln!(out, "{}\t{}", position + 1, shift)?;
+                }
+                Ok(())
+            }
+        }
+    }
+}
+
+/// Recovers the key of a Vigenère ciphertext over alphabet `A`, trying key lengths of up to
+/// `max_period` in parallel on `pool` and cracking each key position with `metric`.
+///
+/// Bytes outside the alphabet do not advance the key, as in [`ccipher::VigenereCipher`].
+/// Every column needs [`MIN_COLUMN_LEN`] bytes of the alphabet, so longer periods are not
+/// tried; texts too short for period 2 are cracked as a single Caesar column. Returns `None`
+/// when no period can be tried or the text holds fewer than two bytes of the alphabet.
+///
+/// # Examples
+///
+/// ```
+/// use ccipher::{Latin26, VigenereCipher};
+/// use ccipher_io::WorkStealingPool;
+/// use ccracker::{crack_vigenere, Metric};
+///
+/// let plaintext = "The index of coincidence of each column stays close to that of English \
+///                  text when the key length is right, and the columns then fall to the \
+///                  frequency attack one after the other. Longer keys need longer texts, \
+///                  since every column must hold enough letters for its distribution to \
+///                  look like English before the frequency attack can identify its shift.";
+/// let cipher = VigenereCipher::with_alphabet(&[2, 15, 7], Latin26);
+/// let ciphertext = cipher.apply_cipher(plaintext);
+/// let pool = WorkStealingPool::new(2);
+/// let key = crack_vigenere::<Latin26>(ciphertext.as_bytes(), 8, Metric::L1, &pool).unwrap();
+///
+/// assert_eq!(key.shifts, cipher.inverse().shifts());
+/// ```
+pub fn crack_vigenere<A: Alphabet>(
+    ciphertext: &[u8],
+    max_period: usize,
+    metric: Metric,
+    pool: &WorkStealingPool,
+) -> Option<VigenereKey> {
+    let symbols: Vec<u8> = ciphertext
+        .iter()
+        .filter_map(|&byte| A::index(byte))
+        .collect();
+    let max_period = max_period.min((symbols.len() / MIN_COLUMN_LEN).max(1));
+    if max_period == 0 || symbols.len() < 2 {
+        return None;
+    }
+
+    let periods: Vec<usize> = (1..=max_period).collect();
+    let histograms = pool.map(
+        periods,
+        || (),
+        |_, period| strided_histograms(&symbols, period, usize::from(A::LEN)),
+    );
+    let coincidence: Vec<f64> = histograms
+        .iter()
+        .map(|columns| mean_coincidence(columns))
+        .collect();
+    let best = coincidence.iter().copied().fold(0.0, f64::max);
+    // The best period always qualifies, since none of its multiples beats it.
+    let period = (1..=max_period).find(|&period| {
+        let value = coincidence[period - 1];
+        value >= best * PERIOD_TOLERANCE
+            && (2 * period..=max_period)
+                .step_by(period)
+                .all(|multiple| value >= coincidence[multiple - 1] * PERIOD_TOLERANCE)
+    })?;
+
+    let shifts = histograms[period - 1]
+        .iter()
+        .map(|column| {
+            let ranking = rank_alphabet_histogram::<A>(column, 1, metric);
+            ranking.best().map_or(0, |candidate| candidate.shift)
+        })
+        .collect();
+    Some(VigenereKey {
+        shifts,
+        coincidence,
+    })
+}
+
+/// Counts the symbols of every column of `period`: column `i` holds the symbols at positions
+/// `i`, `i + period`, `i + 2·period` and so on.
+fn strided_histograms(symbols: &[u8], period: usize, len: usize) -> Vec<Vec<u32>> {
+    let mut columns = vec![vec![0; len]; period];
+    for chunk in symbols.chunks(period) {
+        for (column, &symbol) in columns.iter_mut().zip(chunk) {
+            column[usize::from(symbol)] += 1;
+        }
+    }
+    columns
+}
+
+/// Returns the mean over the columns of the probability that two symbols drawn without
+/// replacement from the column are equal.
+fn mean_coincidence(columns: &[Vec<u32>]) -> f64 {
+    let sum: f64 = columns
+        .iter()
+        .map(|column| {
+            let n: u64 = column.iter().map(|&count| u64::from(count)).sum();
+            let pairs: u64 = column
+                .iter()
+                .map(|&count| u64::from(count) * u64::from(count.saturating_sub(1)))
+                .sum();
+            match n {
+                0 | 1 => 0.0,
+                _ => pairs as f64 / (n * (n - 1)) as f64,
+            }
+        })
+        .sum();
+    sum / columns.len() as f64
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ccipher::{Ascii128, Latin26, VigenereCipher};
+
+    const CORPUS: &str = include_str!("../datasets/english_corpus.txt");
+
+    #[test]
+    fn vigenere_keys_are_recovered_for_both_alphabets() {
+        let pool = WorkStealingPool::new(3);
+        for shifts in [&[11, 4, 12, 14, 13][..], &[7], &[1, 20, 3, 25, 9, 17, 2]] {
+            let cipher = VigenereCipher::with_alphabet(shifts, Latin26);
+            let ciphertext = cipher.apply_cipher(CORPUS);
+            let key = crack_vigenere::<Latin26>(ciphertext.as_bytes(), 20, Metric::L1, &pool);
+            assert_eq!(key.unwrap().shifts, cipher.inverse().shifts(), "{shifts:?}");
+        }
+
+        let cipher = VigenereCipher::new(&[100, 3, 77]);
+        let ciphertext = cipher.apply_cipher(CORPUS);
+        let key = crack_vigenere::<Ascii128>(ciphertext.as_bytes(), 20, Metric::ChiSquared, &pool);
+        assert_eq!(key.unwrap().shifts, cipher.inverse().shifts());
+    }
+
+    #[test]
+    fn the_true_period_beats_its_multiples_and_divisors() {
+        let cipher = VigenereCipher::with_alphabet(&[3, 14, 15, 9, 2, 6], Latin26);
+        let ciphertext = cipher.apply_cipher(CORPUS);
+        let key = crack_vigenere::<Latin26>(
+            ciphertext.as_bytes(),
+            24,
+            Metric::L1,
+            &WorkStealingPool::new(2),
+        )
+        .unwrap();
+        assert_eq!(key.period(), 6);
+        assert_eq!(key.coincidence.len(), 24);
+        // Periods that share a factor with the key mix fewer shifts than the others.
+        assert!(key.coincidence[5] > 1.25 * key.coincidence[2]);
+        assert!(key.coincidence[2] > key.coincidence[4]);
+        assert!(key.coincidence[11] > 0.9 * key.coincidence[5]);
+    }
+
+    #[test]
+    fn short_texts_are_not_split_into_noisy_columns() {
+        let pool = WorkStealingPool::new(2);
+        let cases: [(&str, &[i32]); 2] = [
+            (
+                "The quick brown fox jumps over the lazy dog near the bank",
+                &[7],
+            ),
+            (
+                "Meet me at the old mill after the sun has set and bring the lamp for the dark",
+                &[3, 1, 4],
+            ),
+        ];
+        for (plaintext, shifts) in cases {
+            let cipher = VigenereCipher::new(shifts);
+            let ciphertext = cipher.apply_cipher(plaintext);
+            let key = crack_vigenere::<Ascii128>(
+                ciphertext.as_bytes(),
+                DEFAULT_MAX_PERIOD,
+                Metric::L1,
+                &pool,
+            )
+            .unwrap();
+            assert_eq!(key.shifts, cipher.inverse().shifts(), "{shifts:?}");
+        }
+    }
+
+    #[test]
+    fn strided_histograms_split_symbols_by_position() {
+        let columns = strided_histograms(&[0, 1, 2, 0, 1], 2, 3);
+        assert_eq!(columns, vec![vec![1, 1, 1], vec![1, 1, 0]]);
+        assert_eq!(mean_coincidence(&[vec![2, 0], vec![1, 1]]), 0.5);
+    }
+
+    #[test]
+    fn inputs_without_two_alphabet_bytes_have_no_key() {
+        let pool = WorkStealingPool::new(1);
+        assert_eq!(
+            crack_vigenere::<Latin26>(b"1 2 3 a", 8, Metric::L1, &pool),
+            None
+        );
+        assert_eq!(crack_vigenere::<Latin26>(b"", 8, Metric::L1, &pool), None);
+    }
+
+    #[test]
+    fn write_reports_the_key_in_every_format() {
+        let key = VigenereKey {
+            shifts: vec![15, 22, 14],
+            coincidence: vec![0.04, 0.045, 0.0625],
+        };
+        let render = |format| {
+            let mut out = Vec::new();
+            key.write(&mut out, format).unwrap();
+            String::from_utf8(out).unwrap()
+        };
+
+        assert_eq!(
+            render(Format::Text),
+            "candidate key: 15,22,14 (period: 3)\n"
+        );
+        assert_eq!(
+            render(Format::Json),
+            "{\"period\":3,\"key\":[15,22,14],\"coincidence\":0.0625}\n"
+        );
+        assert_eq!(render(Format::Tsv), "position\tkey\n1\t15\n2\t22\n3\t14\n");
+    }
+}